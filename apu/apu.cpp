@@ -0,0 +1,712 @@
+#include <cstring>
+#include "apu.h"
+#include "../state/state.h"
+
+static const double CPU_CLOCK_RATE = 1789773.0;
+
+static const unsigned char length_table[32] = {
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const unsigned char duty_table[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1}
+};
+
+static const unsigned char triangle_table[32] = {
+    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+// Noise and DMC periods in CPU cycles
+static const unsigned short int noise_table[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+static const unsigned short int dmc_table[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+};
+
+// Full scale of the mixer output in 16-bit samples, leaving some headroom
+static const double OUTPUT_SCALE = 30000.0;
+
+APU::APU(Mapper *mapper) : blip(CPU_CLOCK_RATE, SAMPLE_RATE, 4096) {
+    APU::mapper = mapper;
+    sound = true;
+    // The DAC's non-linear mixing as in the 2A03 datasheet approximations
+    pulse_levels[0] = 0;
+    for (int n = 1; n < 31; n++) pulse_levels[n] = (int) (95.52 / (8128.0 / n + 100) * OUTPUT_SCALE);
+    tnd_levels[0] = 0;
+    for (int n = 1; n < 203; n++) tnd_levels[n] = (int) (163.67 / (24329.0 / n + 100) * OUTPUT_SCALE);
+    reset();
+}
+
+// Counts a timer down by ticks, reloading it to length - 1 after it reaches 0, and returns
+// how many times it was reloaded.
+static unsigned long long int advance_timer(unsigned short int &timer, unsigned int length, unsigned long long int ticks) {
+    if (ticks <= timer) {
+        timer -= ticks;
+        return 0;
+    }
+    ticks -= timer + 1;
+    timer = length - 1 - ticks % length;
+    return 1 + ticks / length;
+}
+
+void APU::reset() {
+    std::memset(pulse, 0, sizeof(pulse));
+    std::memset(&triangle, 0, sizeof(triangle));
+    std::memset(&noise, 0, sizeof(noise));
+    std::memset(&dmc, 0, sizeof(dmc));
+    noise.shift = 1;
+    noise.period = noise_table[0];
+    dmc.period = dmc_table[0];
+    dmc.bits_remaining = 8;
+    dmc.silence = true;
+    cycle = 0;
+    frame_start = 0;
+    five_step = false;
+    irq_inhibit = false;
+    frame_irq = false;
+    frame_cycle = 0;
+    stall_cycles = 0;
+    amplitude = 0;
+    sound_off_cycle = ~0ULL;
+    blip.clear();
+    update_event_cycle();
+}
+
+// Jumps over the cycles in which nothing audible happens, then runs the cycle that has the
+// next event, until cpu_cycle is reached. Gives the same samples as calling tick() for
+// every cycle.
+void APU::catch_up(unsigned long long int cpu_cycle) {
+    // A register write since the last call may have changed the output: that change
+    // belongs to the first cycle
+    if (cycle < cpu_cycle) tick();
+    while (cycle < cpu_cycle) {
+        unsigned long long int quiet = quiet_cycles(cpu_cycle - cycle - 1);
+        if (quiet > 0) skip(quiet);
+        tick();
+    }
+    update_event_cycle();
+}
+
+// Earliest CPU cycle at which catching up may raise the IRQ line or make the DMC halt the
+// CPU for a fetch. Only valid until the next register access.
+unsigned long long int APU::next_event_cycle() {
+    return event_cycle;
+}
+
+// $4015 is the only readable register: length counter and DMC activity plus both IRQ flags.
+// Reading it acknowledges the frame counter IRQ.
+unsigned char APU::read_register(unsigned short int address) {
+    if (address != 0x4015) return 0;
+    unsigned char value = 0;
+    if (pulse[0].length > 0) value = value | 0x01;
+    if (pulse[1].length > 0) value = value | 0x02;
+    if (triangle.length > 0) value = value | 0x04;
+    if (noise.length > 0) value = value | 0x08;
+    if (dmc.bytes_remaining > 0) value = value | 0x10;
+    if (frame_irq) value = value | 0x40;
+    if (dmc.irq) value = value | 0x80;
+    frame_irq = false;
+    update_event_cycle();
+    return value;
+}
+
+void APU::write_register(unsigned short int address, unsigned char value) {
+    switch (address) {
+        case 0x4000:
+        case 0x4004: {
+            Pulse &channel = pulse[(address - 0x4000) / 4];
+            channel.duty = value >> 6;
+            channel.envelope.loop = value & 0x20;
+            channel.envelope.constant = value & 0x10;
+            channel.envelope.period = value & 0x0F;
+            break;
+        }
+        case 0x4001:
+        case 0x4005: {
+            Pulse &channel = pulse[(address - 0x4000) / 4];
+            channel.sweep_enabled = value & 0x80;
+            channel.sweep_period = (value >> 4) & 0x07;
+            channel.sweep_negate = value & 0x08;
+            channel.sweep_shift = value & 0x07;
+            channel.sweep_reload = true;
+            break;
+        }
+        case 0x4002:
+        case 0x4006: {
+            Pulse &channel = pulse[(address - 0x4000) / 4];
+            channel.period = (channel.period & 0x0700) | value;
+            break;
+        }
+        case 0x4003:
+        case 0x4007: {
+            Pulse &channel = pulse[(address - 0x4000) / 4];
+            channel.period = (channel.period & 0x00FF) | ((value & 0x07) << 8);
+            if (channel.enabled) channel.length = length_table[value >> 3];
+            channel.step = 0;
+            channel.envelope.start = true;
+            break;
+        }
+        case 0x4008:
+            triangle.control = value & 0x80;
+            triangle.linear_period = value & 0x7F;
+            break;
+        case 0x400A:
+            triangle.period = (triangle.period & 0x0700) | value;
+            break;
+        case 0x400B:
+            triangle.period = (triangle.period & 0x00FF) | ((value & 0x07) << 8);
+            if (triangle.enabled) triangle.length = length_table[value >> 3];
+            triangle.linear_reload = true;
+            break;
+        case 0x400C:
+            noise.envelope.loop = value & 0x20;
+            noise.envelope.constant = value & 0x10;
+            noise.envelope.period = value & 0x0F;
+            break;
+        case 0x400E:
+            noise.mode = value & 0x80;
+            noise.period = noise_table[value & 0x0F];
+            break;
+        case 0x400F:
+            if (noise.enabled) noise.length = length_table[value >> 3];
+            noise.envelope.start = true;
+            break;
+        case 0x4010:
+            dmc.irq_enabled = value & 0x80;
+            if (!dmc.irq_enabled) dmc.irq = false;
+            dmc.loop = value & 0x40;
+            dmc.period = dmc_table[value & 0x0F];
+            break;
+        case 0x4011:
+            dmc.output = value & 0x7F;
+            break;
+        case 0x4012:
+            dmc.sample_address = 0xC000 + value * 64;
+            break;
+        case 0x4013:
+            dmc.sample_length = value * 16 + 1;
+            break;
+        case 0x4015:
+            pulse[0].enabled = value & 0x01;
+            pulse[1].enabled = value & 0x02;
+            triangle.enabled = value & 0x04;
+            noise.enabled = value & 0x08;
+            if (!pulse[0].enabled) pulse[0].length = 0;
+            if (!pulse[1].enabled) pulse[1].length = 0;
+            if (!triangle.enabled) triangle.length = 0;
+            if (!noise.enabled) noise.length = 0;
+            if (!(value & 0x10)) dmc.bytes_remaining = 0;
+            else if (dmc.bytes_remaining == 0) {
+                dmc.address = dmc.sample_address;
+                dmc.bytes_remaining = dmc.sample_length;
+                fetch_dmc_sample();
+            }
+            dmc.irq = false;
+            break;
+        case 0x4017:
+            // The sequencer restarts right away rather than 3 or 4 cycles later
+            five_step = value & 0x80;
+            irq_inhibit = value & 0x40;
+            if (irq_inhibit) frame_irq = false;
+            frame_cycle = 0;
+            if (five_step) {
+                clock_quarter_frame();
+                clock_half_frame();
+            }
+            break;
+    }
+    update_event_cycle();
+}
+
+bool APU::irq_line() {
+    return frame_irq or dmc.irq;
+}
+
+unsigned int APU::take_stall_cycles() {
+    unsigned int cycles = stall_cycles;
+    stall_cycles = 0;
+    return cycles;
+}
+
+void APU::end_frame(unsigned long long int cpu_cycle) {
+    catch_up(cpu_cycle);
+    if (sound) blip.end_frame(cycle - frame_start);
+    frame_start = cycle;
+}
+
+void APU::set_sample_rate(int sample_rate) {
+    blip.set_rates(CPU_CLOCK_RATE, sample_rate);
+    blip.clear();
+}
+
+int APU::get_sample_rate() {
+    return blip.get_sample_rate();
+}
+
+// Once cycles have passed without sound the synthesis restarts from silence, with the next
+// cycle's output as its first step.
+void APU::set_sound(bool enabled) {
+    if (enabled and !sound and cycle != sound_off_cycle) clear_samples();
+    if (!enabled and sound) sound_off_cycle = cycle;
+    sound = enabled;
+}
+
+bool APU::get_sound() {
+    return sound;
+}
+
+void APU::clear_samples() {
+    blip.clear();
+    frame_start = cycle;
+    amplitude = 0;
+}
+
+static void save_envelope(StateWriter &state, const Envelope &envelope) {
+    state.write_bool(envelope.start);
+    state.write_bool(envelope.loop);
+    state.write_bool(envelope.constant);
+    state.write_u8(envelope.period);
+    state.write_u8(envelope.divider);
+    state.write_u8(envelope.decay);
+}
+
+static void load_envelope(StateReader &state, Envelope &envelope) {
+    envelope.start = state.read_bool();
+    envelope.loop = state.read_bool();
+    envelope.constant = state.read_bool();
+    envelope.period = state.read_u8();
+    envelope.divider = state.read_u8();
+    envelope.decay = state.read_u8();
+}
+
+void APU::save_state(StateWriter &state) {
+    state.begin_section("APU ");
+    for (const Pulse &channel : pulse) {
+        state.write_bool(channel.enabled);
+        state.write_u8(channel.duty);
+        state.write_u8(channel.step);
+        state.write_u16(channel.period);
+        state.write_u16(channel.timer);
+        state.write_u8(channel.length);
+        save_envelope(state, channel.envelope);
+        state.write_bool(channel.sweep_enabled);
+        state.write_bool(channel.sweep_negate);
+        state.write_bool(channel.sweep_reload);
+        state.write_u8(channel.sweep_period);
+        state.write_u8(channel.sweep_shift);
+        state.write_u8(channel.sweep_divider);
+    }
+    state.write_bool(triangle.enabled);
+    state.write_bool(triangle.control);
+    state.write_bool(triangle.linear_reload);
+    state.write_u8(triangle.linear_period);
+    state.write_u8(triangle.linear_counter);
+    state.write_u8(triangle.step);
+    state.write_u16(triangle.period);
+    state.write_u16(triangle.timer);
+    state.write_u8(triangle.length);
+    state.write_bool(noise.enabled);
+    state.write_bool(noise.mode);
+    state.write_u16(noise.period);
+    state.write_u16(noise.timer);
+    state.write_u16(noise.shift);
+    state.write_u8(noise.length);
+    save_envelope(state, noise.envelope);
+    state.write_bool(dmc.irq_enabled);
+    state.write_bool(dmc.loop);
+    state.write_bool(dmc.irq);
+    state.write_u16(dmc.period);
+    state.write_u16(dmc.timer);
+    state.write_u8(dmc.output);
+    state.write_u16(dmc.sample_address);
+    state.write_u16(dmc.sample_length);
+    state.write_u16(dmc.address);
+    state.write_u16(dmc.bytes_remaining);
+    state.write_u8(dmc.buffer);
+    state.write_bool(dmc.buffer_full);
+    state.write_u8(dmc.shift);
+    state.write_u8(dmc.bits_remaining);
+    state.write_bool(dmc.silence);
+    state.write_u64(cycle);
+    state.write_bool(five_step);
+    state.write_bool(irq_inhibit);
+    state.write_bool(frame_irq);
+    state.write_u32(frame_cycle);
+    state.write_u32(stall_cycles);
+    state.end_section();
+}
+
+void APU::load_state(StateReader &state) {
+    state.begin_section("APU ");
+    for (Pulse &channel : pulse) {
+        channel.enabled = state.read_bool();
+        channel.duty = state.read_u8();
+        channel.step = state.read_u8();
+        channel.period = state.read_u16();
+        channel.timer = state.read_u16();
+        channel.length = state.read_u8();
+        load_envelope(state, channel.envelope);
+        channel.sweep_enabled = state.read_bool();
+        channel.sweep_negate = state.read_bool();
+        channel.sweep_reload = state.read_bool();
+        channel.sweep_period = state.read_u8();
+        channel.sweep_shift = state.read_u8();
+        channel.sweep_divider = state.read_u8();
+    }
+    triangle.enabled = state.read_bool();
+    triangle.control = state.read_bool();
+    triangle.linear_reload = state.read_bool();
+    triangle.linear_period = state.read_u8();
+    triangle.linear_counter = state.read_u8();
+    triangle.step = state.read_u8();
+    triangle.period = state.read_u16();
+    triangle.timer = state.read_u16();
+    triangle.length = state.read_u8();
+    noise.enabled = state.read_bool();
+    noise.mode = state.read_bool();
+    noise.period = state.read_u16();
+    noise.timer = state.read_u16();
+    noise.shift = state.read_u16();
+    noise.length = state.read_u8();
+    load_envelope(state, noise.envelope);
+    dmc.irq_enabled = state.read_bool();
+    dmc.loop = state.read_bool();
+    dmc.irq = state.read_bool();
+    dmc.period = state.read_u16();
+    dmc.timer = state.read_u16();
+    dmc.output = state.read_u8();
+    dmc.sample_address = state.read_u16();
+    dmc.sample_length = state.read_u16();
+    dmc.address = state.read_u16();
+    dmc.bytes_remaining = state.read_u16();
+    dmc.buffer = state.read_u8();
+    dmc.buffer_full = state.read_bool();
+    dmc.shift = state.read_u8();
+    dmc.bits_remaining = state.read_u8();
+    dmc.silence = state.read_bool();
+    cycle = state.read_u64();
+    five_step = state.read_bool();
+    irq_inhibit = state.read_bool();
+    frame_irq = state.read_bool();
+    frame_cycle = state.read_u32();
+    stall_cycles = state.read_u32();
+    state.end_section();
+    frame_start = cycle;
+    update_event_cycle();
+}
+
+int APU::samples_available() {
+    return blip.samples_available();
+}
+
+int APU::read_samples(short int *output, int count) {
+    return blip.read_samples(output, count);
+}
+
+unsigned long long int APU::get_cycle() {
+    return cycle;
+}
+
+// One CPU cycle. The pulse timers count APU cycles, every other CPU cycle; the other
+// timers' periods are in CPU cycles. Only a change of the mixed output reaches the blip
+// buffer.
+void APU::tick() {
+    clock_frame_counter();
+
+    if (triangle.timer == 0) {
+        triangle.timer = triangle.period;
+        // Periods below 2 are ultrasonic; the real triangle then sits near the middle
+        if (triangle.length > 0 and triangle.linear_counter > 0 and triangle.period >= 2) {
+            triangle.step = (triangle.step + 1) & 31;
+        }
+    }
+    else triangle.timer--;
+
+    if (cycle & 1) {
+        for (int n = 0; n < 2; n++) {
+            if (pulse[n].timer == 0) {
+                pulse[n].timer = pulse[n].period;
+                pulse[n].step = (pulse[n].step + 1) & 7;
+            }
+            else pulse[n].timer--;
+        }
+    }
+
+    if (noise.timer == 0) {
+        noise.timer = noise.period - 1;
+        unsigned short int feedback = (noise.shift ^ (noise.shift >> (noise.mode ? 6 : 1))) & 0x01;
+        noise.shift = (noise.shift >> 1) | (feedback << 14);
+    }
+    else noise.timer--;
+
+    if (dmc.timer == 0) {
+        dmc.timer = dmc.period - 1;
+        clock_dmc();
+    }
+    else dmc.timer--;
+
+    if (sound) {
+        int output = mix();
+        if (output != amplitude) {
+            blip.add_delta(cycle - frame_start, output - amplitude);
+            amplitude = output;
+        }
+    }
+    cycle++;
+}
+
+// How many of the next cycles, up to limit, can be skipped because no timer of an audible
+// channel expires, the DMC needs no new byte and the frame counter does nothing. Silent
+// channels are left to skip(); without sound every channel is.
+unsigned long long int APU::quiet_cycles(unsigned long long int limit) {
+    unsigned long long int quiet = limit;
+    unsigned int frame_event = next_frame_step() - frame_cycle - 1;
+    if (frame_event < quiet) quiet = frame_event;
+    if (!dmc_idle()) {
+        // Every bit a playing DMC clocks out is heard; otherwise only reloading the shift
+        // register, and the fetch it triggers, needs a tick
+        unsigned long long int dmc_event = dmc.timer;
+        if (!sound or dmc.silence) dmc_event += (unsigned long long int) (dmc.bits_remaining - 1) * dmc.period;
+        if (dmc_event < quiet) quiet = dmc_event;
+    }
+    if (!sound) return quiet;
+    for (int n = 0; n < 2; n++) {
+        if (pulse_silent(pulse[n], n == 0)) continue;
+        // Pulse timers only count on odd cycles
+        unsigned long long int expiry = (cycle & 1 ? 0 : 1) + 2ULL * pulse[n].timer;
+        if (expiry < quiet) quiet = expiry;
+    }
+    if (triangle.length > 0 and triangle.linear_counter > 0 and triangle.period >= 2 and triangle.timer < quiet) {
+        quiet = triangle.timer;
+    }
+    if (noise.length > 0 and envelope_volume(noise.envelope) > 0 and noise.timer < quiet) quiet = noise.timer;
+    return quiet;
+}
+
+// Runs cycles in which only silent channels' timers expire, without ticking each one.
+// Nothing the frame counter does falls in them, so whether the triangle steps and
+// whether the DMC plays stays the same throughout.
+void APU::skip(unsigned long long int cycles) {
+    unsigned long long int pulse_ticks = (cycle + cycles) / 2 - cycle / 2;
+    unsigned long long int expiries;
+    for (int n = 0; n < 2; n++) {
+        expiries = advance_timer(pulse[n].timer, pulse[n].period + 1, pulse_ticks);
+        pulse[n].step = (pulse[n].step + expiries) & 7;
+    }
+    expiries = advance_timer(triangle.timer, triangle.period + 1, cycles);
+    if (triangle.length > 0 and triangle.linear_counter > 0 and triangle.period >= 2) {
+        triangle.step = (triangle.step + expiries) & 31;
+    }
+    expiries = advance_timer(noise.timer, noise.period, cycles);
+    if (noise.mode) expiries = expiries % 93;
+    else expiries = expiries % 32767;
+    for (unsigned long long int n = 0; n < expiries; n++) {
+        unsigned short int feedback = (noise.shift ^ (noise.shift >> (noise.mode ? 6 : 1))) & 0x01;
+        noise.shift = (noise.shift >> 1) | (feedback << 14);
+    }
+    expiries = advance_timer(dmc.timer, dmc.period, cycles);
+    if (dmc_idle()) {
+        // An idle DMC just counts its output bits down, shifting out zeroes
+        dmc.bits_remaining = (dmc.bits_remaining + 7 - expiries % 8) % 8 + 1;
+        dmc.shift = expiries >= 8 ? 0 : dmc.shift >> expiries;
+    }
+    else {
+        // Fewer bits than are left in the shift register, see quiet_cycles()
+        for (unsigned long long int n = 0; n < expiries; n++) shift_dmc_bit();
+    }
+    frame_cycle += cycles;
+    cycle += cycles;
+}
+
+// True when the pulse stays silent whatever its sequencer step is, until a register
+// write or a frame counter clock.
+bool APU::pulse_silent(const Pulse &channel, bool ones_complement) {
+    if (channel.length == 0 or channel.period < 8 or sweep_target(channel, ones_complement) > 0x07FF) return true;
+    return envelope_volume(channel.envelope) == 0;
+}
+
+bool APU::dmc_idle() {
+    return dmc.silence and !dmc.buffer_full and dmc.bytes_remaining == 0;
+}
+
+// The next frame_cycle value at which the sequencer does something.
+unsigned int APU::next_frame_step() {
+    static const unsigned int four_step[5] = {7457, 14913, 22371, 29829, 29830};
+    static const unsigned int five_step_positions[5] = {7457, 14913, 22371, 37281, 37282};
+    const unsigned int *positions = five_step ? five_step_positions : four_step;
+    for (int n = 0; n < 5; n++) {
+        if (positions[n] > frame_cycle) return positions[n];
+    }
+    return positions[4];
+}
+
+void APU::update_event_cycle() {
+    event_cycle = ~0ULL;
+    if (!five_step and !irq_inhibit) {
+        // The flag is set at frame_cycle 29829 and again at 29830
+        unsigned int irq_step = frame_cycle < 29829 ? 29829 : 29830;
+        event_cycle = cycle + (irq_step - frame_cycle);
+    }
+    if (dmc.buffer_full) {
+        // The buffer is emptied, and refilled, when the shift register runs out of bits
+        unsigned long long int fetch = cycle + dmc.timer + (unsigned long long int) (dmc.bits_remaining - 1) * dmc.period + 1;
+        if (fetch < event_cycle) event_cycle = fetch;
+    }
+}
+
+// NTSC sequencer positions in CPU cycles. The 4-step sequence raises the IRQ at its end
+// unless inhibited; the 5-step one never does.
+void APU::clock_frame_counter() {
+    frame_cycle++;
+    switch (frame_cycle) {
+        case 7457:
+        case 22371:
+            clock_quarter_frame();
+            break;
+        case 14913:
+            clock_quarter_frame();
+            clock_half_frame();
+            break;
+        case 29829:
+            if (five_step) break;
+            clock_quarter_frame();
+            clock_half_frame();
+            if (!irq_inhibit) frame_irq = true;
+            break;
+        case 29830:
+            if (five_step) break;
+            if (!irq_inhibit) frame_irq = true;
+            frame_cycle = 0;
+            break;
+        case 37281:
+            clock_quarter_frame();
+            clock_half_frame();
+            break;
+        case 37282:
+            frame_cycle = 0;
+            break;
+    }
+}
+
+// Envelopes and the triangle's linear counter.
+void APU::clock_quarter_frame() {
+    clock_envelope(pulse[0].envelope);
+    clock_envelope(pulse[1].envelope);
+    clock_envelope(noise.envelope);
+    if (triangle.linear_reload) triangle.linear_counter = triangle.linear_period;
+    else if (triangle.linear_counter > 0) triangle.linear_counter--;
+    if (!triangle.control) triangle.linear_reload = false;
+}
+
+// Length counters and sweeps. The envelope loop flag doubles as the length counter halt.
+void APU::clock_half_frame() {
+    for (int n = 0; n < 2; n++) {
+        if (pulse[n].length > 0 and !pulse[n].envelope.loop) pulse[n].length--;
+    }
+    if (triangle.length > 0 and !triangle.control) triangle.length--;
+    if (noise.length > 0 and !noise.envelope.loop) noise.length--;
+    // Pulse 1 negates with one's complement, pulse 2 with two's complement
+    clock_sweep(pulse[0], true);
+    clock_sweep(pulse[1], false);
+}
+
+void APU::clock_envelope(Envelope &envelope) {
+    if (envelope.start) {
+        envelope.start = false;
+        envelope.decay = 15;
+        envelope.divider = envelope.period;
+    }
+    else if (envelope.divider == 0) {
+        envelope.divider = envelope.period;
+        if (envelope.decay > 0) envelope.decay--;
+        else if (envelope.loop) envelope.decay = 15;
+    }
+    else envelope.divider--;
+}
+
+void APU::clock_sweep(Pulse &channel, bool ones_complement) {
+    unsigned short int target = sweep_target(channel, ones_complement);
+    bool muted = channel.period < 8 or target > 0x07FF;
+    if (channel.sweep_divider == 0 and channel.sweep_enabled and channel.sweep_shift > 0 and !muted) {
+        channel.period = target;
+    }
+    if (channel.sweep_divider == 0 or channel.sweep_reload) {
+        channel.sweep_divider = channel.sweep_period;
+        channel.sweep_reload = false;
+    }
+    else channel.sweep_divider--;
+}
+
+unsigned short int APU::sweep_target(const Pulse &channel, bool ones_complement) {
+    unsigned short int change = channel.period >> channel.sweep_shift;
+    if (!channel.sweep_negate) return channel.period + change;
+    if (change + (ones_complement ? 1 : 0) > channel.period) return 0;
+    return channel.period - change - (ones_complement ? 1 : 0);
+}
+
+// The sweep unit mutes the channel even when it is not enabled.
+unsigned char APU::pulse_output(const Pulse &channel, bool ones_complement) {
+    if (channel.length == 0 or channel.period < 8 or sweep_target(channel, ones_complement) > 0x07FF) return 0;
+    if (!duty_table[channel.duty][channel.step]) return 0;
+    return envelope_volume(channel.envelope);
+}
+
+unsigned char APU::envelope_volume(const Envelope &envelope) {
+    return envelope.constant ? envelope.period : envelope.decay;
+}
+
+// One output bit of the delta modulation channel, and a new byte every 8.
+void APU::clock_dmc() {
+    shift_dmc_bit();
+    if (dmc.bits_remaining == 0) {
+        dmc.bits_remaining = 8;
+        dmc.silence = !dmc.buffer_full;
+        if (dmc.buffer_full) {
+            dmc.shift = dmc.buffer;
+            dmc.buffer_full = false;
+            fetch_dmc_sample();
+        }
+    }
+}
+
+void APU::shift_dmc_bit() {
+    if (!dmc.silence) {
+        if (dmc.shift & 0x01) {
+            if (dmc.output <= 125) dmc.output += 2;
+        }
+        else if (dmc.output >= 2) dmc.output -= 2;
+    }
+    dmc.shift = dmc.shift >> 1;
+    dmc.bits_remaining--;
+}
+
+// Fills the sample buffer from CPU memory, halting the CPU for 4 cycles.
+void APU::fetch_dmc_sample() {
+    if (dmc.buffer_full or dmc.bytes_remaining == 0) return;
+    stall_cycles += 4;
+    dmc.buffer = mapper->cpu_mem(dmc.address);
+    dmc.buffer_full = true;
+    dmc.address = dmc.address == 0xFFFF ? 0x8000 : dmc.address + 1;
+    dmc.bytes_remaining--;
+    if (dmc.bytes_remaining == 0) {
+        if (dmc.loop) {
+            dmc.address = dmc.sample_address;
+            dmc.bytes_remaining = dmc.sample_length;
+        }
+        else if (dmc.irq_enabled) dmc.irq = true;
+    }
+}
+
+int APU::mix() {
+    unsigned char pulse_sum = pulse_output(pulse[0], true) + pulse_output(pulse[1], false);
+    unsigned char triangle_level = triangle_table[triangle.step];
+    unsigned char noise_level = (noise.length > 0 and !(noise.shift & 0x01)) ? envelope_volume(noise.envelope) : 0;
+    return pulse_levels[pulse_sum] + tnd_levels[3 * triangle_level + 2 * noise_level + dmc.output];
+}
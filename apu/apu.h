@@ -0,0 +1,155 @@
+#ifndef APU_H
+#define APU_H
+
+#include "../mappers/mappers.h"
+#include "blip_buffer.h"
+
+class StateWriter;
+class StateReader;
+
+// Volume envelope shared by the pulse and noise channels.
+struct Envelope {
+    bool start;
+    bool loop;
+    bool constant;
+    unsigned char period;
+    unsigned char divider;
+    unsigned char decay;
+};
+
+struct Pulse {
+    bool enabled;
+    unsigned char duty;
+    unsigned char step;
+    unsigned short int period;
+    unsigned short int timer;
+    unsigned char length;
+    Envelope envelope;
+    bool sweep_enabled;
+    bool sweep_negate;
+    bool sweep_reload;
+    unsigned char sweep_period;
+    unsigned char sweep_shift;
+    unsigned char sweep_divider;
+};
+
+struct Triangle {
+    bool enabled;
+    bool control;
+    bool linear_reload;
+    unsigned char linear_period;
+    unsigned char linear_counter;
+    unsigned char step;
+    unsigned short int period;
+    unsigned short int timer;
+    unsigned char length;
+};
+
+struct Noise {
+    bool enabled;
+    bool mode;
+    unsigned short int period;
+    unsigned short int timer;
+    unsigned short int shift;
+    unsigned char length;
+    Envelope envelope;
+};
+
+struct DMC {
+    bool irq_enabled;
+    bool loop;
+    bool irq;
+    unsigned short int period;
+    unsigned short int timer;
+    unsigned char output;
+    unsigned short int sample_address;
+    unsigned short int sample_length;
+    unsigned short int address;
+    unsigned short int bytes_remaining;
+    unsigned char buffer;
+    bool buffer_full;
+    unsigned char shift;
+    unsigned char bits_remaining;
+    bool silence;
+};
+
+// The 2A03 sound hardware: two pulse channels, triangle, noise and the delta modulation
+// channel, mixed through the non-linear DAC into a band-limited buffer. Like the PPU it
+// can run behind the CPU: it is caught up before every register access and whenever
+// next_event_cycle() is reached. Samples come out at SAMPLE_RATE unless told otherwise;
+// AudioOutput brings them to the host's rate.
+class APU {
+    public:
+        static const int SAMPLE_RATE = 64000;
+        APU(Mapper *mapper);
+        void reset();
+        void tick();
+        void catch_up(unsigned long long int cpu_cycle);
+        unsigned long long int next_event_cycle();
+        unsigned char read_register(unsigned short int address);
+        void write_register(unsigned short int address, unsigned char value);
+        // True while the frame counter or the DMC asserts the IRQ line.
+        bool irq_line();
+        // CPU cycles the DMC stole for sample fetches since the last call.
+        unsigned int take_stall_cycles();
+        // Makes the sound up to cpu_cycle available to read_samples().
+        void end_frame(unsigned long long int cpu_cycle);
+        void set_sample_rate(int sample_rate);
+        int get_sample_rate();
+        // Without sound the channels are still clocked, for $4015, the IRQs and the DMC's
+        // fetches, but nothing is mixed or synthesized. Switching it back on at the cycle it
+        // was switched off, as after loading a state saved then, carries on seamlessly.
+        void set_sound(bool enabled);
+        bool get_sound();
+        // Drops the samples not yet read; the synthesis restarts from silence.
+        void clear_samples();
+        int samples_available();
+        int read_samples(short int *output, int count);
+        unsigned long long int get_cycle();
+        // Samples not yet read are not part of a save state. They stay readable across a
+        // load, and the synthesis goes on from the level it had reached, so reloading the
+        // state of the same moment, as run-ahead does, leaves the sound seamless.
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
+
+    private:
+        Mapper *mapper;
+        BlipBuffer blip;
+        Pulse pulse[2];
+        Triangle triangle;
+        Noise noise;
+        DMC dmc;
+        unsigned long long int cycle;
+        unsigned long long int frame_start;
+        bool five_step;
+        bool irq_inhibit;
+        bool frame_irq;
+        unsigned int frame_cycle;
+        unsigned int stall_cycles;
+        bool sound;
+        unsigned long long int sound_off_cycle;
+        int amplitude;
+        unsigned long long int event_cycle;
+        int pulse_levels[31];
+        int tnd_levels[203];
+        unsigned long long int quiet_cycles(unsigned long long int limit);
+        void skip(unsigned long long int cycles);
+        bool pulse_silent(const Pulse &channel, bool ones_complement);
+        bool dmc_idle();
+        unsigned int next_frame_step();
+        void update_event_cycle();
+        void clock_frame_counter();
+        void clock_quarter_frame();
+        void clock_half_frame();
+        void clock_envelope(Envelope &envelope);
+        void clock_sweep(Pulse &channel, bool ones_complement);
+        unsigned short int sweep_target(const Pulse &channel, bool ones_complement);
+        unsigned char pulse_output(const Pulse &channel, bool ones_complement);
+        unsigned char envelope_volume(const Envelope &envelope);
+        void clock_dmc();
+        void shift_dmc_bit();
+        void fetch_dmc_sample();
+        int mix();
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include <cmath>
+#include <cstring>
+#include "blip_buffer.h"
+
+short int BlipBuffer::kernel[BlipBuffer::PHASES][BlipBuffer::WIDTH];
+
+BlipBuffer::BlipBuffer(double clock_rate, int sample_rate, int capacity) {
+    BlipBuffer::capacity = capacity;
+    // Built by the first buffer made, once even if several threads make one at a time
+    static bool kernel_built = (build_kernel(), true);
+    (void) kernel_built;
+    set_rates(clock_rate, sample_rate);
+    clear();
+}
+
+void BlipBuffer::set_rates(double clock_rate, int sample_rate) {
+    BlipBuffer::sample_rate = sample_rate;
+    factor = (unsigned long long int) (sample_rate / clock_rate * 4294967296.0);
+}
+
+int BlipBuffer::get_sample_rate() {
+    return sample_rate;
+}
+
+void BlipBuffer::clear() {
+    buffer.resize(capacity + WIDTH);
+    std::memset(buffer.data(), 0, buffer.size() * sizeof(int));
+    offset = 0;
+    integrator = 0;
+}
+
+// Each phase is a Blackman windowed sinc cut off at 90% of the Nyquist frequency, shifted
+// by a fraction of a sample and scaled so its taps add up to exactly one step.
+void BlipBuffer::build_kernel() {
+    const double cutoff = 0.9;
+    for (int phase = 0; phase < PHASES; phase++) {
+        double taps[WIDTH];
+        double sum = 0;
+        for (int n = 0; n < WIDTH; n++) {
+            double x = n + 1 - (double) phase / PHASES;
+            double t = x - WIDTH / 2;
+            double sinc = t == 0 ? 1 : std::sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+            double window = 0.42 - 0.5 * std::cos(2 * M_PI * x / WIDTH) + 0.08 * std::cos(4 * M_PI * x / WIDTH);
+            taps[n] = sinc * window;
+            sum += taps[n];
+        }
+        int total = 0;
+        for (int n = 0; n < WIDTH; n++) {
+            kernel[phase][n] = (short int) std::lround(taps[n] / sum * (1 << KERNEL_BITS));
+            total += kernel[phase][n];
+        }
+        // Rounding error goes to the centre tap so that a step always integrates to delta
+        kernel[phase][WIDTH / 2 - 1] += (1 << KERNEL_BITS) - total;
+    }
+}
+
+void BlipBuffer::add_delta(unsigned int time, int delta) {
+    unsigned long long int position = offset + time * factor;
+    unsigned int index = position >> TIME_BITS;
+    int phase = (position >> (TIME_BITS - PHASE_BITS)) & (PHASES - 1);
+    // Nobody read the samples in time: make room rather than drop the step
+    if (index + WIDTH > buffer.size()) buffer.resize(index + WIDTH, 0);
+    const short int *taps = kernel[phase];
+    int *output = &buffer[index];
+    for (int n = 0; n < WIDTH; n++) output[n] += delta * taps[n];
+}
+
+void BlipBuffer::end_frame(unsigned int time) {
+    offset += time * factor;
+    unsigned int index = offset >> TIME_BITS;
+    if (index + WIDTH > buffer.size()) buffer.resize(index + WIDTH, 0);
+}
+
+int BlipBuffer::samples_available() {
+    return offset >> TIME_BITS;
+}
+
+int BlipBuffer::read_samples(short int *output, int count) {
+    int available = samples_available();
+    if (count > available) count = available;
+    for (int i = 0; i < count; i++) {
+        integrator += buffer[i];
+        long long int sample = integrator >> KERNEL_BITS;
+        if (sample > 32767) sample = 32767;
+        else if (sample < -32768) sample = -32768;
+        output[i] = sample;
+    }
+    // The impulses of steps near the end reach into samples not read yet
+    std::memmove(buffer.data(), buffer.data() + count, (buffer.size() - count) * sizeof(int));
+    std::memset(buffer.data() + buffer.size() - count, 0, count * sizeof(int));
+    offset -= (unsigned long long int) count << TIME_BITS;
+    return count;
+}
@@ -0,0 +1,44 @@
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <vector>
+
+// Band-limited synthesis of a signal that only changes in steps. Each change of amplitude
+// is added once, at its clock time, as a windowed sinc impulse spread over the output
+// samples around it; reading integrates the impulses back into steps. The cost depends on
+// how often the amplitude changes, not on the clock rate.
+class BlipBuffer {
+    public:
+        BlipBuffer(double clock_rate, int sample_rate, int capacity);
+        void set_rates(double clock_rate, int sample_rate);
+        int get_sample_rate();
+        // Drops everything buffered and restarts the frame at time 0.
+        void clear();
+        // Adds a step of delta at time clocks into the current frame.
+        void add_delta(unsigned int time, int delta);
+        // Ends the current frame after time clocks; its samples can then be read.
+        void end_frame(unsigned int time);
+        int samples_available();
+        // Reads up to count 16-bit samples and returns how many were read.
+        int read_samples(short int *output, int count);
+
+    private:
+        // Taps of the impulse and sub-sample positions it is tabulated for
+        static const int WIDTH = 16;
+        static const int PHASE_BITS = 5;
+        static const int PHASES = 1 << PHASE_BITS;
+        static const int TIME_BITS = 32;
+        static const int KERNEL_BITS = 15;
+        // Shared by every buffer, as it only depends on the constants above
+        static short int kernel[PHASES][WIDTH];
+        std::vector<int> buffer;
+        int capacity;
+        int sample_rate;
+        // Output samples per clock, and the start of the current frame, in 32.32 fixed point
+        unsigned long long int factor;
+        unsigned long long int offset;
+        long long int integrator;
+        static void build_kernel();
+};
+
+#endif
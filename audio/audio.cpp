@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "audio.h"
+
+// Corner frequencies of the NES's output filters
+static const double LOW_PASS_FREQUENCY = 14000.0;
+static const double HIGH_PASS_FREQUENCIES[2] = {90.0, 440.0};
+
+AudioOutput::AudioOutput(int input_rate, int output_rate) {
+#if defined(__x86_64__) || defined(__i386__)
+    simd_supported = __builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma");
+#else
+    simd_supported = false;
+#endif
+    simd = simd_supported;
+    speed = 1;
+    set_rates(input_rate, output_rate);
+}
+
+void AudioOutput::set_rates(int input_rate, int output_rate) {
+    AudioOutput::input_rate = input_rate;
+    AudioOutput::output_rate = output_rate;
+    update_step();
+    for (int n = 0; n < 2; n++) {
+        double rc = 1 / (2 * M_PI * HIGH_PASS_FREQUENCIES[n]);
+        high_pass[n] = rc / (rc + 1.0 / output_rate);
+    }
+    build_kernel();
+    clear();
+}
+
+int AudioOutput::get_input_rate() {
+    return input_rate;
+}
+
+int AudioOutput::get_output_rate() {
+    return output_rate;
+}
+
+void AudioOutput::set_speed(double speed) {
+    AudioOutput::speed = speed;
+    update_step();
+}
+
+double AudioOutput::get_speed() {
+    return speed;
+}
+
+void AudioOutput::update_step() {
+    step = (unsigned long long int) ((double) input_rate / output_rate / speed * 4294967296.0);
+}
+
+void AudioOutput::set_simd(bool enabled) {
+    simd = enabled and simd_supported;
+}
+
+bool AudioOutput::get_simd() {
+    return simd;
+}
+
+void AudioOutput::clear() {
+    // Starts as if silence came before, so the first samples have a full filter behind them
+    if (history.size() < TAPS) history.resize(TAPS);
+    std::fill(history.begin(), history.begin() + TAPS, 0.0f);
+    history_size = TAPS;
+    position = 0;
+    for (int n = 0; n < 2; n++) {
+        high_pass_input[n] = 0;
+        high_pass_output[n] = 0;
+    }
+}
+
+// Each phase is a Blackman windowed sinc cut off at 90% of the lower rate's Nyquist
+// frequency, shifted by a fraction of an input sample, then run through the one-pole
+// 14 kHz low-pass at the input rate and scaled to unity gain. Filtering the kernel is the
+// same as filtering the input, since both are linear. Tap n multiplies the input sample
+// TAPS - 1 - n before the newest, so the low-pass runs from the last tap back to the first
+// to follow increasing delay.
+void AudioOutput::build_kernel() {
+    double cutoff = 0.45 * (input_rate < output_rate ? input_rate : output_rate) / input_rate;
+    double low_pass = 1 - std::exp(-2 * M_PI * LOW_PASS_FREQUENCY / input_rate);
+    for (int phase = 0; phase < PHASES; phase++) {
+        double taps[TAPS];
+        double sum = 0;
+        double state = 0;
+        for (int n = TAPS - 1; n >= 0; n--) {
+            double x = n + 1 - (double) phase / PHASES;
+            double t = x - TAPS / 2;
+            double sinc = t == 0 ? 1 : std::sin(2 * M_PI * cutoff * t) / (2 * M_PI * cutoff * t);
+            double window = 0.42 - 0.5 * std::cos(2 * M_PI * x / TAPS) + 0.08 * std::cos(4 * M_PI * x / TAPS);
+            state += low_pass * (sinc * window - state);
+            taps[n] = state;
+            sum += taps[n];
+        }
+        for (int n = 0; n < TAPS; n++) kernel[phase][n] = taps[n] / sum;
+    }
+}
+
+int AudioOutput::convert(const short int *input, int count, short int *output, int capacity) {
+    // The buffer only grows when a call brings more input than any before it
+    if (history_size + count > history.size()) history.resize(history_size + count);
+    for (int n = 0; n < count; n++) history[history_size + n] = input[n];
+    history_size += count;
+    int written = 0;
+    while (written < capacity) {
+        unsigned long long int index = position >> TIME_BITS;
+        if (index + TAPS > history_size) break;
+        int phase = (position >> (TIME_BITS - PHASE_BITS)) & (PHASES - 1);
+#if defined(__x86_64__) || defined(__i386__)
+        float value = simd ? filter_avx2(&history[index], kernel[phase]) : filter(&history[index], kernel[phase]);
+#else
+        float value = filter(&history[index], kernel[phase]);
+#endif
+        for (int n = 0; n < 2; n++) {
+            float filtered = high_pass[n] * (high_pass_output[n] + value - high_pass_input[n]);
+            high_pass_input[n] = value;
+            high_pass_output[n] = filtered;
+            value = filtered;
+        }
+        if (value > 32767) value = 32767;
+        else if (value < -32768) value = -32768;
+        output[written++] = (short int) std::lrint(value);
+        position += step;
+    }
+    // Input before the next output sample's first tap is no longer needed
+    unsigned long long int consumed = position >> TIME_BITS;
+    if (consumed > history_size) consumed = history_size;
+    std::memmove(history.data(), history.data() + consumed, (history_size - consumed) * sizeof(float));
+    history_size -= consumed;
+    position -= consumed << TIME_BITS;
+    return written;
+}
+
+float AudioOutput::filter(const float *input, const float *taps) {
+    float sum = 0;
+    for (int n = 0; n < TAPS; n++) sum += input[n] * taps[n];
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Two accumulators of 8 lanes, so consecutive multiply-adds do not wait on each other.
+__attribute__((target("avx2,fma")))
+float AudioOutput::filter_avx2(const float *input, const float *taps) {
+    __m256 sums[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+    for (int n = 0; n < TAPS; n += 16) {
+        sums[0] = _mm256_fmadd_ps(_mm256_loadu_ps(&input[n]), _mm256_load_ps(&taps[n]), sums[0]);
+        sums[1] = _mm256_fmadd_ps(_mm256_loadu_ps(&input[n + 8]), _mm256_load_ps(&taps[n + 8]), sums[1]);
+    }
+    __m256 sum = _mm256_add_ps(sums[0], sums[1]);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+    return _mm_cvtss_f32(half);
+}
+#endif
@@ -0,0 +1,59 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <vector>
+
+// Brings the APU's samples to the host's output rate, through the filters the NES has
+// between the 2A03 and the audio jack: two high-pass filters at 90 Hz and 440 Hz and a
+// low-pass filter at 14 kHz. The low-pass is folded into the polyphase FIR that does the
+// rate conversion, so it costs nothing extra; the high-passes run on the output samples.
+// Input is taken a whole frame at a time and output goes to a buffer owned by the caller.
+class AudioOutput {
+    public:
+        AudioOutput(int input_rate, int output_rate = 48000);
+        void set_rates(int input_rate, int output_rate);
+        int get_input_rate();
+        int get_output_rate();
+        // Makes speed times as many output samples from the same input, without changing
+        // the filters. Rate control uses it to keep an audio buffer from draining or filling.
+        void set_speed(double speed);
+        double get_speed();
+        // The AVX2 kernels are used whenever the CPU has them; this can turn them off.
+        void set_simd(bool enabled);
+        bool get_simd();
+        // Drops buffered input and the filters' state.
+        void clear();
+        // Takes count input samples and writes up to capacity output samples, returning how
+        // many were written. Input that could not be converted yet, for lack of room or of
+        // the samples after it, is kept for the next call.
+        int convert(const short int *input, int count, short int *output, int capacity);
+
+    private:
+        // Taps of the filter, in input samples, and sub-sample positions it is tabulated for
+        static const int TAPS = 64;
+        static const int PHASE_BITS = 6;
+        static const int PHASES = 1 << PHASE_BITS;
+        static const int TIME_BITS = 32;
+        alignas(32) float kernel[PHASES][TAPS];
+        int input_rate;
+        int output_rate;
+        double speed;
+        bool simd;
+        bool simd_supported;
+        // The first history_size samples are the input not consumed yet; position is the
+        // next output sample's among them, in 32.32 fixed point
+        std::vector<float> history;
+        unsigned int history_size;
+        unsigned long long int position;
+        unsigned long long int step;
+        // High-pass filters: coefficient, previous input and previous output of each
+        float high_pass[2];
+        float high_pass_input[2];
+        float high_pass_output[2];
+        void update_step();
+        void build_kernel();
+        float filter(const float *input, const float *taps);
+        float filter_avx2(const float *input, const float *taps);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include <cstring>
+#include "audio_stream.h"
+
+AudioStream::AudioStream(int input_rate, int output_rate, unsigned int target) :
+        output(input_rate, output_rate), ring(target * 4) {
+    AudioStream::target = target;
+    rate_control = true;
+    drift = 0;
+    fill = 0;
+    speed = 1;
+    underruns = 0;
+    missing_samples = 0;
+    dropped_samples = 0;
+}
+
+AudioOutput &AudioStream::get_output() {
+    return output;
+}
+
+void AudioStream::set_rate_control(bool enabled) {
+    rate_control = enabled;
+    if (!enabled) output.set_speed(1);
+    drift = 0;
+    speed = output.get_speed();
+}
+
+bool AudioStream::get_rate_control() {
+    return rate_control;
+}
+
+void AudioStream::write(const short int *input, int count) {
+    unsigned int level = ring.size();
+    fill.store(level, std::memory_order_relaxed);
+    if (rate_control) {
+        double error = ((double) target - level) / target;
+        if (error > 1) error = 1;
+        else if (error < -1) error = -1;
+        // The integral takes out the steady clock difference, which would otherwise keep
+        // the fill off target by as much as it takes to offset it
+        drift += error * MAX_SPEED_CHANGE / 256;
+        if (drift > MAX_SPEED_CHANGE) drift = MAX_SPEED_CHANGE;
+        else if (drift < -MAX_SPEED_CHANGE) drift = -MAX_SPEED_CHANGE;
+        double change = MAX_SPEED_CHANGE * error + drift;
+        if (change > MAX_SPEED_CHANGE) change = MAX_SPEED_CHANGE;
+        else if (change < -MAX_SPEED_CHANGE) change = -MAX_SPEED_CHANGE;
+        output.set_speed(1 + change);
+        speed.store(output.get_speed(), std::memory_order_relaxed);
+    }
+    // Room for the input at the fastest speed; anything that still does not fit stays in
+    // the resampler until the next write
+    unsigned int needed = (double) count * output.get_output_rate() / output.get_input_rate() * (1 + MAX_SPEED_CHANGE) + 2;
+    if (converted.size() < needed) converted.resize(needed);
+    int written = output.convert(input, count, converted.data(), converted.size());
+    unsigned int pushed = ring.push(converted.data(), written);
+    if (pushed < (unsigned int) written) dropped_samples.fetch_add(written - pushed, std::memory_order_relaxed);
+}
+
+void AudioStream::read(short int *output, int count) {
+    unsigned int popped = ring.pop(output, count);
+    if (popped < (unsigned int) count) {
+        std::memset(output + popped, 0, (count - popped) * sizeof(short int));
+        underruns.fetch_add(1, std::memory_order_relaxed);
+        missing_samples.fetch_add(count - popped, std::memory_order_relaxed);
+    }
+}
+
+AudioStreamStats AudioStream::get_stats() {
+    AudioStreamStats stats;
+    stats.fill = fill.load(std::memory_order_relaxed);
+    stats.target = target;
+    stats.capacity = ring.get_capacity();
+    stats.speed = speed.load(std::memory_order_relaxed);
+    stats.underruns = underruns.load(std::memory_order_relaxed);
+    stats.missing_samples = missing_samples.load(std::memory_order_relaxed);
+    stats.dropped_samples = dropped_samples.load(std::memory_order_relaxed);
+    return stats;
+}
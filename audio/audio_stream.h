@@ -0,0 +1,62 @@
+#ifndef AUDIO_STREAM_H
+#define AUDIO_STREAM_H
+
+#include <atomic>
+#include <vector>
+#include "audio.h"
+#include "../util/spsc_ring.h"
+
+// What the audio buffer looked like the last time samples were written to it, and what
+// went wrong since the stream was created.
+struct AudioStreamStats {
+    unsigned int fill;
+    unsigned int target;
+    unsigned int capacity;
+    // Speed the resampler was last set to by rate control
+    double speed;
+    // Reads that found fewer samples than asked for, and the silence put in their place
+    unsigned long long int underruns;
+    unsigned long long int missing_samples;
+    // Samples thrown away because the buffer was full
+    unsigned long long int dropped_samples;
+};
+
+// Carries sound from the emulation thread to the host's audio callback without locks. The
+// emulation thread writes each frame's APU samples, which are resampled into a lock-free
+// ring; the callback reads them out. Both threads run at their own clock, which never
+// quite agree, so rate control speeds the resampler up or down by at most MAX_SPEED_CHANGE,
+// in proportion to how far the ring is from its target fill plus a slow integral of it.
+// The latency then stays near the target without underruns and without holding the
+// emulation back.
+class AudioStream {
+    public:
+        static constexpr double MAX_SPEED_CHANGE = 0.005;
+        // target is the fill, in output samples, that rate control aims for; the ring holds
+        // four times as much.
+        AudioStream(int input_rate, int output_rate, unsigned int target);
+        AudioOutput &get_output();
+        void set_rate_control(bool enabled);
+        bool get_rate_control();
+        // Emulation thread only.
+        void write(const short int *input, int count);
+        // Audio thread only. Always fills count samples, with silence if there are too few.
+        void read(short int *output, int count);
+        // Either thread.
+        AudioStreamStats get_stats();
+
+    private:
+        AudioOutput output;
+        SPSCRing<short int> ring;
+        unsigned int target;
+        bool rate_control;
+        double drift;
+        std::vector<short int> converted;
+        // Written by one thread and read by any
+        std::atomic<unsigned int> fill;
+        std::atomic<double> speed;
+        std::atomic<unsigned long long int> underruns;
+        std::atomic<unsigned long long int> missing_samples;
+        std::atomic<unsigned long long int> dropped_samples;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdexcept>
+#include <string>
+#include "wav_writer.h"
+
+// Header fields are little endian whatever the host is.
+static void put_word(unsigned char *bytes, unsigned short int value) {
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+}
+
+static void put_dword(unsigned char *bytes, unsigned int value) {
+    put_word(bytes, value);
+    put_word(bytes + 2, value >> 16);
+}
+
+WavWriter::WavWriter(const char *path, int sample_rate, int channels) {
+    WavWriter::sample_rate = sample_rate;
+    WavWriter::channels = channels;
+    data_size = 0;
+    file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file) throw std::runtime_error(std::string("\n") + path + " cannot be written!");
+    write_header();
+}
+
+WavWriter::~WavWriter() {
+    close();
+}
+
+void WavWriter::write(const short int *samples, int count) {
+    unsigned char bytes[4096];
+    while (count > 0) {
+        int chunk = count < 2048 ? count : 2048;
+        for (int i = 0; i < chunk; i++) put_word(&bytes[i * 2], samples[i]);
+        file.write((const char *) bytes, chunk * 2);
+        data_size += chunk * 2;
+        samples += chunk;
+        count -= chunk;
+    }
+}
+
+void WavWriter::close() {
+    if (!file.is_open()) return;
+    file.seekp(0);
+    write_header();
+    file.close();
+}
+
+void WavWriter::write_header() {
+    unsigned char header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '};
+    put_dword(&header[4], 36 + data_size);
+    put_dword(&header[16], 16);
+    // PCM
+    put_word(&header[20], 1);
+    put_word(&header[22], channels);
+    put_dword(&header[24], sample_rate);
+    put_dword(&header[28], sample_rate * channels * 2);
+    put_word(&header[32], channels * 2);
+    put_word(&header[34], 16);
+    header[36] = 'd';
+    header[37] = 'a';
+    header[38] = 't';
+    header[39] = 'a';
+    put_dword(&header[40], data_size);
+    file.write((const char *) header, 44);
+}
@@ -0,0 +1,23 @@
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <fstream>
+
+// Writes 16-bit PCM samples to a WAV file as they come. The sizes in the header are
+// filled in by close(), or by the destructor.
+class WavWriter {
+    public:
+        WavWriter(const char *path, int sample_rate, int channels = 1);
+        ~WavWriter();
+        void write(const short int *samples, int count);
+        void close();
+
+    private:
+        std::ofstream file;
+        int sample_rate;
+        int channels;
+        unsigned int data_size;
+        void write_header();
+};
+
+#endif
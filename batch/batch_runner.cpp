@@ -0,0 +1,89 @@
+#include <chrono>
+#include "batch_runner.h"
+
+BatchRunner::BatchRunner(Mapper *cartridge, int instances, int threads, bool pin_threads) : pool(threads, pin_threads) {
+    for (int n = 0; n < instances; n++) {
+        Mapper *copy = cartridge->copy();
+        Emulator *emulator = new Emulator(copy);
+        emulator->get_apu().set_sound(false);
+        emulator->reset();
+        cartridges.push_back(copy);
+        emulators.push_back(emulator);
+    }
+    tasks.resize(instances);
+    reset_stats();
+}
+
+BatchRunner::~BatchRunner() {
+    for (Emulator *emulator : emulators) delete emulator;
+    for (Mapper *cartridge : cartridges) delete cartridge;
+}
+
+int BatchRunner::get_instances() {
+    return emulators.size();
+}
+
+int BatchRunner::get_threads() {
+    return pool.get_threads();
+}
+
+Emulator &BatchRunner::get_instance(int instance) {
+    return *emulators[instance];
+}
+
+void BatchRunner::capture_start(int instance) {
+    start.capture(*emulators[instance]);
+}
+
+void BatchRunner::clear_start() {
+    start.clear();
+}
+
+void BatchRunner::reset() {
+    for (Emulator *emulator : emulators) start.restore(*emulator);
+}
+
+void BatchRunner::reset_instance(int instance) {
+    start.restore(*emulators[instance]);
+}
+
+void BatchRunner::run_frames(int frames, bool render) {
+    run([frames, render](Emulator *emulator) {
+        for (int i = 0; i < frames; i++) emulator->run_frame(render);
+    });
+}
+
+void BatchRunner::run_cycles(unsigned long long int cycles) {
+    run([cycles](Emulator *emulator) {
+        emulator->run_cycles(cycles);
+    });
+}
+
+BatchStats BatchRunner::get_stats() {
+    BatchStats stats;
+    stats.frames = frames;
+    stats.seconds = seconds;
+    stats.fps = seconds > 0 ? frames / seconds : 0;
+    stats.steals = pool.get_steals() - stats_steals;
+    return stats;
+}
+
+void BatchRunner::reset_stats() {
+    frames = 0;
+    seconds = 0;
+    stats_steals = pool.get_steals();
+}
+
+// Runs work on every instance, one task each, and counts the frames the PPUs went through.
+void BatchRunner::run(const std::function<void(Emulator *)> &work) {
+    std::vector<unsigned long long int> start_frames(emulators.size());
+    for (unsigned int n = 0; n < emulators.size(); n++) {
+        Emulator *emulator = emulators[n];
+        start_frames[n] = emulator->get_ppu().get_frame();
+        tasks[n] = [&work, emulator]() { work(emulator); };
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pool.run(tasks);
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (unsigned int n = 0; n < emulators.size(); n++) frames += emulators[n]->get_ppu().get_frame() - start_frames[n];
+}
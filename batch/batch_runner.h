@@ -0,0 +1,58 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <functional>
+#include <vector>
+#include "episode_start.h"
+#include "thread_pool.h"
+#include "../emulator/emulator.h"
+
+// Frames run by a batch runner and how long that took, since its stats were last reset.
+struct BatchStats {
+    unsigned long long int frames;
+    double seconds;
+    // Frames per second over all instances together
+    double fps;
+    unsigned long long int steals;
+};
+
+// Owns a number of emulators running the same game and steps them all together on a
+// work-stealing thread pool, one task per instance. Each instance has a copy of the
+// cartridge, so instances share nothing and come out exactly as they would run alone.
+// Sound is off unless turned on through get_instance().
+class BatchRunner {
+    public:
+        // cartridge is only copied and stays the caller's. threads of 0 means one per
+        // hardware thread.
+        BatchRunner(Mapper *cartridge, int instances, int threads = 0, bool pin_threads = true);
+        ~BatchRunner();
+        int get_instances();
+        int get_threads();
+        Emulator &get_instance(int instance);
+        // The state of instance becomes the one reset() and reset_instance() go back to,
+        // instead of powering on. Capture it after the boot, or at whatever frame and
+        // inputs episodes should start from.
+        void capture_start(int instance = 0);
+        void clear_start();
+        void reset();
+        void reset_instance(int instance);
+        // Runs frames frames on every instance.
+        void run_frames(int frames, bool render = false);
+        // Runs at least cycles CPU cycles on every instance, headless.
+        void run_cycles(unsigned long long int cycles);
+        BatchStats get_stats();
+        void reset_stats();
+
+    private:
+        std::vector<Mapper *> cartridges;
+        std::vector<Emulator *> emulators;
+        ThreadPool pool;
+        std::vector<std::function<void()>> tasks;
+        EpisodeStart start;
+        unsigned long long int frames;
+        double seconds;
+        unsigned long long int stats_steals;
+        void run(const std::function<void(Emulator *)> &work);
+};
+
+#endif
@@ -0,0 +1,23 @@
+#include "episode_start.h"
+
+EpisodeStart::EpisodeStart() {
+    size = 0;
+}
+
+void EpisodeStart::capture(Emulator &emulator) {
+    state.resize(emulator.get_state_size());
+    size = emulator.save_state(state.data(), state.size());
+}
+
+bool EpisodeStart::is_captured() {
+    return size > 0;
+}
+
+void EpisodeStart::clear() {
+    size = 0;
+}
+
+void EpisodeStart::restore(Emulator &emulator) {
+    if (size > 0) emulator.load_state(state.data(), size);
+    else emulator.reset();
+}
@@ -0,0 +1,25 @@
+#ifndef EPISODE_START_H
+#define EPISODE_START_H
+
+#include <vector>
+#include "../emulator/emulator.h"
+
+// The state episodes start from, so that starting one is a state load instead of a power
+// on and the game's boot and title screens. The buffer is allocated once, on capture.
+class EpisodeStart {
+    public:
+        EpisodeStart();
+        // Keeps the current state of emulator, wherever the frames and inputs that led
+        // there left it.
+        void capture(Emulator &emulator);
+        bool is_captured();
+        void clear();
+        // Puts emulator in the captured state, or powers it on when there is none.
+        void restore(Emulator &emulator);
+
+    private:
+        std::vector<unsigned char> state;
+        unsigned int size;
+};
+
+#endif
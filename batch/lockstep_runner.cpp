@@ -0,0 +1,629 @@
+#include <chrono>
+#include <cstring>
+#include "lockstep_runner.h"
+
+enum LockstepOperation {
+    OP_NONE,
+    OP_LDA, OP_LDX, OP_LDY, OP_STA, OP_STX, OP_STY,
+    OP_ADC, OP_SBC, OP_AND, OP_ORA, OP_EOR, OP_CMP, OP_CPX, OP_CPY, OP_BIT,
+    OP_INC, OP_DEC, OP_ASL, OP_LSR, OP_ROL, OP_ROR,
+    OP_ASL_AC, OP_LSR_AC, OP_ROL_AC, OP_ROR_AC,
+    OP_TAX, OP_TAY, OP_TXA, OP_TYA, OP_TSX, OP_TXS, OP_INX, OP_INY, OP_DEX, OP_DEY,
+    OP_CLC, OP_SEC, OP_CLD, OP_CLV, OP_SEI, OP_NOP,
+    OP_BPL, OP_BMI, OP_BVC, OP_BVS, OP_BCC, OP_BCS, OP_BNE, OP_BEQ,
+    OP_JMP, OP_JSR, OP_RTS, OP_PHA, OP_PLA
+};
+
+enum LockstepMode {
+    MODE_IMPLIED,
+    MODE_IMMEDIATE,
+    MODE_ZERO_PAGE,
+    MODE_ZERO_PAGE_X,
+    MODE_ZERO_PAGE_Y,
+    MODE_ABSOLUTE,
+    MODE_ABSOLUTE_X,
+    MODE_ABSOLUTE_Y,
+    MODE_RELATIVE
+};
+
+// An opcode that can run on all lanes at once. Cycles and addressing are as in the
+// scalar instructions, page_penalty marking the indexed reads that take one more cycle
+// when the index carries into the high byte.
+struct LockstepOpcode {
+    unsigned char opcode;
+    unsigned char operation;
+    unsigned char mode;
+    unsigned char cycles;
+    bool page_penalty;
+};
+
+// Only opcodes whose memory accesses can go straight to the cartridge are here; PHP, PLP,
+// RTI, CLI and BRK change or push the interrupt flag and stay scalar.
+static const LockstepOpcode lockstep_opcodes[] = {
+    {0xA9, OP_LDA, MODE_IMMEDIATE, 2, false}, {0xA5, OP_LDA, MODE_ZERO_PAGE, 3, false},
+    {0xB5, OP_LDA, MODE_ZERO_PAGE_X, 4, false}, {0xAD, OP_LDA, MODE_ABSOLUTE, 4, false},
+    {0xBD, OP_LDA, MODE_ABSOLUTE_X, 4, true}, {0xB9, OP_LDA, MODE_ABSOLUTE_Y, 4, true},
+    {0xA2, OP_LDX, MODE_IMMEDIATE, 2, false}, {0xA6, OP_LDX, MODE_ZERO_PAGE, 3, false},
+    {0xB6, OP_LDX, MODE_ZERO_PAGE_Y, 4, false}, {0xAE, OP_LDX, MODE_ABSOLUTE, 4, false},
+    {0xBE, OP_LDX, MODE_ABSOLUTE_Y, 4, true},
+    {0xA0, OP_LDY, MODE_IMMEDIATE, 2, false}, {0xA4, OP_LDY, MODE_ZERO_PAGE, 3, false},
+    {0xB4, OP_LDY, MODE_ZERO_PAGE_X, 4, false}, {0xAC, OP_LDY, MODE_ABSOLUTE, 4, false},
+    {0xBC, OP_LDY, MODE_ABSOLUTE_X, 4, true},
+    {0x85, OP_STA, MODE_ZERO_PAGE, 3, false}, {0x95, OP_STA, MODE_ZERO_PAGE_X, 4, false},
+    {0x8D, OP_STA, MODE_ABSOLUTE, 4, false}, {0x9D, OP_STA, MODE_ABSOLUTE_X, 5, false},
+    {0x99, OP_STA, MODE_ABSOLUTE_Y, 5, false},
+    {0x86, OP_STX, MODE_ZERO_PAGE, 3, false}, {0x96, OP_STX, MODE_ZERO_PAGE_Y, 4, false},
+    {0x8E, OP_STX, MODE_ABSOLUTE, 4, false},
+    {0x84, OP_STY, MODE_ZERO_PAGE, 3, false}, {0x94, OP_STY, MODE_ZERO_PAGE_X, 4, false},
+    {0x8C, OP_STY, MODE_ABSOLUTE, 4, false},
+    {0x69, OP_ADC, MODE_IMMEDIATE, 2, false}, {0x65, OP_ADC, MODE_ZERO_PAGE, 3, false},
+    {0x75, OP_ADC, MODE_ZERO_PAGE_X, 4, false}, {0x6D, OP_ADC, MODE_ABSOLUTE, 4, false},
+    {0x7D, OP_ADC, MODE_ABSOLUTE_X, 4, true}, {0x79, OP_ADC, MODE_ABSOLUTE_Y, 4, true},
+    {0xE9, OP_SBC, MODE_IMMEDIATE, 2, false}, {0xEB, OP_SBC, MODE_IMMEDIATE, 2, false},
+    {0xE5, OP_SBC, MODE_ZERO_PAGE, 3, false}, {0xF5, OP_SBC, MODE_ZERO_PAGE_X, 4, false},
+    {0xED, OP_SBC, MODE_ABSOLUTE, 4, false}, {0xFD, OP_SBC, MODE_ABSOLUTE_X, 4, true},
+    {0xF9, OP_SBC, MODE_ABSOLUTE_Y, 4, true},
+    {0x29, OP_AND, MODE_IMMEDIATE, 2, false}, {0x25, OP_AND, MODE_ZERO_PAGE, 3, false},
+    {0x35, OP_AND, MODE_ZERO_PAGE_X, 4, false}, {0x2D, OP_AND, MODE_ABSOLUTE, 4, false},
+    {0x3D, OP_AND, MODE_ABSOLUTE_X, 4, true}, {0x39, OP_AND, MODE_ABSOLUTE_Y, 4, true},
+    {0x09, OP_ORA, MODE_IMMEDIATE, 2, false}, {0x05, OP_ORA, MODE_ZERO_PAGE, 3, false},
+    {0x15, OP_ORA, MODE_ZERO_PAGE_X, 4, false}, {0x0D, OP_ORA, MODE_ABSOLUTE, 4, false},
+    {0x1D, OP_ORA, MODE_ABSOLUTE_X, 4, true}, {0x19, OP_ORA, MODE_ABSOLUTE_Y, 4, true},
+    {0x49, OP_EOR, MODE_IMMEDIATE, 2, false}, {0x45, OP_EOR, MODE_ZERO_PAGE, 3, false},
+    {0x55, OP_EOR, MODE_ZERO_PAGE_X, 4, false}, {0x4D, OP_EOR, MODE_ABSOLUTE, 4, false},
+    {0x5D, OP_EOR, MODE_ABSOLUTE_X, 4, true}, {0x59, OP_EOR, MODE_ABSOLUTE_Y, 4, true},
+    {0xC9, OP_CMP, MODE_IMMEDIATE, 2, false}, {0xC5, OP_CMP, MODE_ZERO_PAGE, 3, false},
+    {0xD5, OP_CMP, MODE_ZERO_PAGE_X, 4, false}, {0xCD, OP_CMP, MODE_ABSOLUTE, 4, false},
+    {0xDD, OP_CMP, MODE_ABSOLUTE_X, 4, true}, {0xD9, OP_CMP, MODE_ABSOLUTE_Y, 4, true},
+    {0xE0, OP_CPX, MODE_IMMEDIATE, 2, false}, {0xE4, OP_CPX, MODE_ZERO_PAGE, 3, false},
+    {0xEC, OP_CPX, MODE_ABSOLUTE, 4, false},
+    {0xC0, OP_CPY, MODE_IMMEDIATE, 2, false}, {0xC4, OP_CPY, MODE_ZERO_PAGE, 3, false},
+    {0xCC, OP_CPY, MODE_ABSOLUTE, 4, false},
+    {0x24, OP_BIT, MODE_ZERO_PAGE, 3, false}, {0x2C, OP_BIT, MODE_ABSOLUTE, 4, false},
+    {0xE6, OP_INC, MODE_ZERO_PAGE, 5, false}, {0xF6, OP_INC, MODE_ZERO_PAGE_X, 6, false},
+    {0xEE, OP_INC, MODE_ABSOLUTE, 6, false}, {0xFE, OP_INC, MODE_ABSOLUTE_X, 7, false},
+    {0xC6, OP_DEC, MODE_ZERO_PAGE, 5, false}, {0xD6, OP_DEC, MODE_ZERO_PAGE_X, 6, false},
+    {0xCE, OP_DEC, MODE_ABSOLUTE, 6, false}, {0xDE, OP_DEC, MODE_ABSOLUTE_X, 7, false},
+    {0x0A, OP_ASL_AC, MODE_IMPLIED, 2, false}, {0x06, OP_ASL, MODE_ZERO_PAGE, 5, false},
+    {0x16, OP_ASL, MODE_ZERO_PAGE_X, 6, false}, {0x0E, OP_ASL, MODE_ABSOLUTE, 6, false},
+    {0x1E, OP_ASL, MODE_ABSOLUTE_X, 7, false},
+    {0x4A, OP_LSR_AC, MODE_IMPLIED, 2, false}, {0x46, OP_LSR, MODE_ZERO_PAGE, 5, false},
+    {0x56, OP_LSR, MODE_ZERO_PAGE_X, 6, false}, {0x4E, OP_LSR, MODE_ABSOLUTE, 6, false},
+    {0x5E, OP_LSR, MODE_ABSOLUTE_X, 7, false},
+    {0x2A, OP_ROL_AC, MODE_IMPLIED, 2, false}, {0x26, OP_ROL, MODE_ZERO_PAGE, 5, false},
+    {0x36, OP_ROL, MODE_ZERO_PAGE_X, 6, false}, {0x2E, OP_ROL, MODE_ABSOLUTE, 6, false},
+    {0x3E, OP_ROL, MODE_ABSOLUTE_X, 7, false},
+    {0x6A, OP_ROR_AC, MODE_IMPLIED, 2, false}, {0x66, OP_ROR, MODE_ZERO_PAGE, 5, false},
+    {0x76, OP_ROR, MODE_ZERO_PAGE_X, 6, false}, {0x6E, OP_ROR, MODE_ABSOLUTE, 6, false},
+    {0x7E, OP_ROR, MODE_ABSOLUTE_X, 7, false},
+    {0xAA, OP_TAX, MODE_IMPLIED, 2, false}, {0xA8, OP_TAY, MODE_IMPLIED, 2, false},
+    {0x8A, OP_TXA, MODE_IMPLIED, 2, false}, {0x98, OP_TYA, MODE_IMPLIED, 2, false},
+    {0xBA, OP_TSX, MODE_IMPLIED, 2, false}, {0x9A, OP_TXS, MODE_IMPLIED, 2, false},
+    {0xE8, OP_INX, MODE_IMPLIED, 2, false}, {0xC8, OP_INY, MODE_IMPLIED, 2, false},
+    {0xCA, OP_DEX, MODE_IMPLIED, 2, false}, {0x88, OP_DEY, MODE_IMPLIED, 2, false},
+    {0x18, OP_CLC, MODE_IMPLIED, 2, false}, {0x38, OP_SEC, MODE_IMPLIED, 2, false},
+    {0xD8, OP_CLD, MODE_IMPLIED, 2, false}, {0xB8, OP_CLV, MODE_IMPLIED, 2, false},
+    {0x78, OP_SEI, MODE_IMPLIED, 2, false}, {0xEA, OP_NOP, MODE_IMPLIED, 2, false},
+    {0x10, OP_BPL, MODE_RELATIVE, 2, false}, {0x30, OP_BMI, MODE_RELATIVE, 2, false},
+    {0x50, OP_BVC, MODE_RELATIVE, 2, false}, {0x70, OP_BVS, MODE_RELATIVE, 2, false},
+    {0x90, OP_BCC, MODE_RELATIVE, 2, false}, {0xB0, OP_BCS, MODE_RELATIVE, 2, false},
+    {0xD0, OP_BNE, MODE_RELATIVE, 2, false}, {0xF0, OP_BEQ, MODE_RELATIVE, 2, false},
+    {0x4C, OP_JMP, MODE_ABSOLUTE, 3, false}, {0x20, OP_JSR, MODE_ABSOLUTE, 6, false},
+    {0x60, OP_RTS, MODE_IMPLIED, 6, false}, {0x48, OP_PHA, MODE_IMPLIED, 3, false},
+    {0x68, OP_PLA, MODE_IMPLIED, 4, false}
+};
+
+// lockstep_opcodes by opcode; OP_NONE where there is no lockstep form
+static LockstepOpcode opcode_table[256];
+
+static bool build_opcode_table() {
+    for (int opcode = 0; opcode < 256; opcode++) {
+        opcode_table[opcode] = {(unsigned char) opcode, OP_NONE, MODE_IMPLIED, 0, false};
+    }
+    for (const LockstepOpcode &opcode : lockstep_opcodes) opcode_table[opcode.opcode] = opcode;
+    return true;
+}
+
+static int instruction_length(unsigned char mode) {
+    if (mode == MODE_IMPLIED) return 1;
+    if (mode == MODE_ABSOLUTE or mode == MODE_ABSOLUTE_X or mode == MODE_ABSOLUTE_Y) return 3;
+    return 2;
+}
+
+static bool reads_operand(unsigned char operation) {
+    return (operation >= OP_LDA and operation <= OP_LDY) or (operation >= OP_ADC and operation <= OP_ROR);
+}
+
+static bool stores_result(unsigned char operation) {
+    return (operation >= OP_STA and operation <= OP_STY) or (operation >= OP_INC and operation <= OP_ROR);
+}
+
+// What the CPU would read from the cartridge without the PPU or the APU being involved.
+static bool cartridge_readable(unsigned short int address) {
+    return address < 0x2000 or address >= 0x6000;
+}
+
+// RAM and work RAM; writes above $8000 are mapper registers the PPU has to hear about.
+static bool cartridge_writable(unsigned short int address) {
+    return address < 0x2000 or (address >= 0x6000 and address < 0x8000);
+}
+
+static const int LANES = LaneRegisters::LANES;
+
+__attribute__((always_inline))
+static inline void set_ZN(LaneRegisters &lanes, const unsigned char *values) {
+    for (int l = 0; l < LANES; l++) {
+        lanes.STATUS[l] = (lanes.STATUS[l] & 0x7D) | (values[l] & 0x80) | (values[l] == 0 ? 0x02 : 0);
+    }
+}
+
+__attribute__((always_inline))
+static inline void branch(LaneRegisters &lanes, unsigned char mask, bool set, unsigned char offset) {
+    int displacement = (signed char) offset;
+    for (int l = 0; l < LANES; l++) {
+        bool taken = ((lanes.STATUS[l] & mask) != 0) == set;
+        // As the scalar branches count it: only a forward carry into the next page
+        int cross = ((lanes.PC[l] + 2) & 0xFF) + displacement > 0xFF;
+        lanes.cycles[l] += 2 + (taken ? 1 + cross : 0);
+        lanes.PC[l] += 2 + (taken ? displacement : 0);
+    }
+}
+
+__attribute__((always_inline))
+static inline void add(LaneRegisters &lanes, unsigned char flip) {
+    for (int l = 0; l < LANES; l++) {
+        unsigned char value = lanes.operand[l] ^ flip;
+        unsigned int sum = lanes.A[l] + value + (lanes.STATUS[l] & 0x01);
+        unsigned char overflow = ~(lanes.A[l] ^ value) & (lanes.A[l] ^ sum) & 0x80;
+        lanes.STATUS[l] = (lanes.STATUS[l] & 0xBE) | (sum > 0xFF ? 0x01 : 0) | (overflow >> 1);
+        lanes.A[l] = sum;
+    }
+    set_ZN(lanes, lanes.A);
+}
+
+__attribute__((always_inline))
+static inline void compare(LaneRegisters &lanes, const unsigned char *registers) {
+    for (int l = 0; l < LANES; l++) {
+        lanes.STATUS[l] = (lanes.STATUS[l] & 0xFE) | (registers[l] >= lanes.operand[l] ? 0x01 : 0);
+        lanes.result[l] = registers[l] - lanes.operand[l];
+    }
+    set_ZN(lanes, lanes.result);
+}
+
+// Shifts values one bit left or right into the result, through the carry when rotating.
+__attribute__((always_inline))
+static inline void shift(LaneRegisters &lanes, const unsigned char *values, unsigned char *results, bool left, bool rotate) {
+    for (int l = 0; l < LANES; l++) {
+        unsigned char value = values[l];
+        unsigned char carry_in = rotate ? lanes.STATUS[l] & 0x01 : 0;
+        unsigned char carry_out = left ? value >> 7 : value & 0x01;
+        results[l] = left ? (value << 1) | carry_in : (value >> 1) | (carry_in << 7);
+        lanes.STATUS[l] = (lanes.STATUS[l] & 0xFE) | carry_out;
+    }
+    set_ZN(lanes, results);
+}
+
+__attribute__((always_inline))
+static inline void transfer(LaneRegisters &lanes, const unsigned char *from, unsigned char *to) {
+    for (int l = 0; l < LANES; l++) to[l] = from[l];
+    set_ZN(lanes, to);
+}
+
+__attribute__((always_inline))
+static inline void increment(LaneRegisters &lanes, unsigned char *registers, unsigned char amount) {
+    for (int l = 0; l < LANES; l++) registers[l] += amount;
+    set_ZN(lanes, registers);
+}
+
+// Runs one lockstep opcode on every lane, inactive ones included, whose registers are
+// loaded again before they are used. operand is the immediate byte, the branch offset or
+// the jump target; memory operands are in lanes.operand, and stores are left in
+// lanes.result for the caller to write.
+__attribute__((always_inline))
+static inline void execute_lanes(LaneRegisters &lanes, const LockstepOpcode &opcode, unsigned short int operand) {
+    switch (opcode.operation) {
+        case OP_LDA: transfer(lanes, lanes.operand, lanes.A); break;
+        case OP_LDX: transfer(lanes, lanes.operand, lanes.X); break;
+        case OP_LDY: transfer(lanes, lanes.operand, lanes.Y); break;
+        case OP_STA: for (int l = 0; l < LANES; l++) lanes.result[l] = lanes.A[l]; break;
+        case OP_STX: for (int l = 0; l < LANES; l++) lanes.result[l] = lanes.X[l]; break;
+        case OP_STY: for (int l = 0; l < LANES; l++) lanes.result[l] = lanes.Y[l]; break;
+        case OP_ADC: add(lanes, 0x00); break;
+        case OP_SBC: add(lanes, 0xFF); break;
+        case OP_AND:
+            for (int l = 0; l < LANES; l++) lanes.A[l] &= lanes.operand[l];
+            set_ZN(lanes, lanes.A);
+            break;
+        case OP_ORA:
+            for (int l = 0; l < LANES; l++) lanes.A[l] |= lanes.operand[l];
+            set_ZN(lanes, lanes.A);
+            break;
+        case OP_EOR:
+            for (int l = 0; l < LANES; l++) lanes.A[l] ^= lanes.operand[l];
+            set_ZN(lanes, lanes.A);
+            break;
+        case OP_CMP: compare(lanes, lanes.A); break;
+        case OP_CPX: compare(lanes, lanes.X); break;
+        case OP_CPY: compare(lanes, lanes.Y); break;
+        case OP_BIT:
+            for (int l = 0; l < LANES; l++) {
+                unsigned char value = lanes.operand[l];
+                lanes.STATUS[l] = (lanes.STATUS[l] & 0x3D) | (value & 0xC0) | ((value & lanes.A[l]) == 0 ? 0x02 : 0);
+            }
+            break;
+        case OP_INC:
+            for (int l = 0; l < LANES; l++) lanes.result[l] = lanes.operand[l] + 1;
+            set_ZN(lanes, lanes.result);
+            break;
+        case OP_DEC:
+            for (int l = 0; l < LANES; l++) lanes.result[l] = lanes.operand[l] - 1;
+            set_ZN(lanes, lanes.result);
+            break;
+        case OP_ASL: shift(lanes, lanes.operand, lanes.result, true, false); break;
+        case OP_LSR: shift(lanes, lanes.operand, lanes.result, false, false); break;
+        case OP_ROL: shift(lanes, lanes.operand, lanes.result, true, true); break;
+        case OP_ROR: shift(lanes, lanes.operand, lanes.result, false, true); break;
+        case OP_ASL_AC: shift(lanes, lanes.A, lanes.A, true, false); break;
+        case OP_LSR_AC: shift(lanes, lanes.A, lanes.A, false, false); break;
+        case OP_ROL_AC: shift(lanes, lanes.A, lanes.A, true, true); break;
+        case OP_ROR_AC: shift(lanes, lanes.A, lanes.A, false, true); break;
+        case OP_TAX: transfer(lanes, lanes.A, lanes.X); break;
+        case OP_TAY: transfer(lanes, lanes.A, lanes.Y); break;
+        case OP_TXA: transfer(lanes, lanes.X, lanes.A); break;
+        case OP_TYA: transfer(lanes, lanes.Y, lanes.A); break;
+        case OP_TSX: transfer(lanes, lanes.SP, lanes.X); break;
+        case OP_TXS: for (int l = 0; l < LANES; l++) lanes.SP[l] = lanes.X[l]; break;
+        case OP_INX: increment(lanes, lanes.X, 1); break;
+        case OP_INY: increment(lanes, lanes.Y, 1); break;
+        case OP_DEX: increment(lanes, lanes.X, 0xFF); break;
+        case OP_DEY: increment(lanes, lanes.Y, 0xFF); break;
+        case OP_CLC: for (int l = 0; l < LANES; l++) lanes.STATUS[l] &= 0xFE; break;
+        case OP_SEC: for (int l = 0; l < LANES; l++) lanes.STATUS[l] |= 0x01; break;
+        case OP_CLD: for (int l = 0; l < LANES; l++) lanes.STATUS[l] &= 0xF7; break;
+        case OP_CLV: for (int l = 0; l < LANES; l++) lanes.STATUS[l] &= 0xBF; break;
+        case OP_SEI: for (int l = 0; l < LANES; l++) lanes.STATUS[l] |= 0x04; break;
+        case OP_PLA: transfer(lanes, lanes.operand, lanes.A); break;
+        case OP_BPL: branch(lanes, 0x80, false, operand); return;
+        case OP_BMI: branch(lanes, 0x80, true, operand); return;
+        case OP_BVC: branch(lanes, 0x40, false, operand); return;
+        case OP_BVS: branch(lanes, 0x40, true, operand); return;
+        case OP_BCC: branch(lanes, 0x01, false, operand); return;
+        case OP_BCS: branch(lanes, 0x01, true, operand); return;
+        case OP_BNE: branch(lanes, 0x02, false, operand); return;
+        case OP_BEQ: branch(lanes, 0x02, true, operand); return;
+        case OP_JMP:
+        case OP_JSR:
+            for (int l = 0; l < LANES; l++) {
+                lanes.PC[l] = operand;
+                lanes.cycles[l] += opcode.cycles;
+            }
+            return;
+    }
+    int length = instruction_length(opcode.mode);
+    for (int l = 0; l < LANES; l++) {
+        lanes.PC[l] += length;
+        lanes.cycles[l] += opcode.cycles + lanes.extra_cycles[l];
+    }
+}
+
+// The same operations built three times on x86, once elsewhere; the compiler vectorizes
+// the lane loops with whatever each target allows.
+static void execute_baseline(LaneRegisters &lanes, const LockstepOpcode &opcode, unsigned short int operand) {
+    execute_lanes(lanes, opcode, operand);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void execute_avx2(LaneRegisters &lanes, const LockstepOpcode &opcode, unsigned short int operand) {
+    execute_lanes(lanes, opcode, operand);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static void execute_avx512(LaneRegisters &lanes, const LockstepOpcode &opcode, unsigned short int operand) {
+    execute_lanes(lanes, opcode, operand);
+}
+#endif
+
+LockstepRunner::LockstepRunner(Mapper *cartridge, int instances, int threads, bool pin_threads) : pool(threads, pin_threads) {
+    static bool table_built = build_opcode_table();
+    (void) table_built;
+    for (int first = 0; first < instances; first += LANES) {
+        Group *group = new Group();
+        group->size = instances - first < LANES ? instances - first : LANES;
+        for (int lane = 0; lane < group->size; lane++) {
+            group->cartridges[lane] = cartridge->copy();
+            group->emulators[lane] = new Emulator(group->cartridges[lane]);
+            group->emulators[lane]->get_apu().set_sound(false);
+            group->emulators[lane]->reset();
+        }
+        groups.push_back(group);
+    }
+    tasks.resize(groups.size());
+    set_simd(true);
+    reset_stats();
+}
+
+LockstepRunner::~LockstepRunner() {
+    for (Group *group : groups) {
+        for (int lane = 0; lane < group->size; lane++) {
+            delete group->emulators[lane];
+            delete group->cartridges[lane];
+        }
+        delete group;
+    }
+}
+
+int LockstepRunner::get_instances() {
+    int instances = 0;
+    for (Group *group : groups) instances += group->size;
+    return instances;
+}
+
+int LockstepRunner::get_threads() {
+    return pool.get_threads();
+}
+
+Emulator &LockstepRunner::get_instance(int instance) {
+    return *groups[instance / LANES]->emulators[instance % LANES];
+}
+
+void LockstepRunner::capture_start(int instance) {
+    start.capture(get_instance(instance));
+}
+
+void LockstepRunner::clear_start() {
+    start.clear();
+}
+
+void LockstepRunner::reset() {
+    for (Group *group : groups) {
+        for (int lane = 0; lane < group->size; lane++) start.restore(*group->emulators[lane]);
+    }
+}
+
+void LockstepRunner::reset_instance(int instance) {
+    start.restore(get_instance(instance));
+}
+
+void LockstepRunner::run_frames(int frames, bool render) {
+    if (frames <= 0) return;
+    for (unsigned int n = 0; n < groups.size(); n++) {
+        Group *group = groups[n];
+        tasks[n] = [this, group, frames, render]() { run_group(*group, frames, render); };
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pool.run(tasks);
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LockstepRunner::set_simd(bool enabled) {
+    simd = enabled;
+    execute = execute_baseline;
+    simd_name = "baseline";
+#if defined(__x86_64__) || defined(__i386__)
+    if (enabled and __builtin_cpu_supports("avx512bw") and __builtin_cpu_supports("avx512vl")) {
+        execute = execute_avx512;
+        simd_name = "AVX-512";
+    }
+    else if (enabled and __builtin_cpu_supports("avx2")) {
+        execute = execute_avx2;
+        simd_name = "AVX2";
+    }
+#endif
+}
+
+bool LockstepRunner::get_simd() {
+    return simd;
+}
+
+const char *LockstepRunner::get_simd_name() {
+    return simd_name;
+}
+
+LockstepStats LockstepRunner::get_stats() {
+    LockstepStats stats;
+    stats.lockstep_instructions = 0;
+    stats.lockstep_lane_instructions = 0;
+    stats.scalar_instructions = 0;
+    stats.frames = 0;
+    for (Group *group : groups) {
+        stats.lockstep_instructions += group->lockstep_instructions;
+        stats.lockstep_lane_instructions += group->lockstep_lane_instructions;
+        stats.scalar_instructions += group->scalar_instructions;
+        stats.frames += group->frames_run;
+    }
+    stats.seconds = seconds;
+    stats.fps = seconds > 0 ? stats.frames / seconds : 0;
+    return stats;
+}
+
+void LockstepRunner::reset_stats() {
+    for (Group *group : groups) {
+        group->lockstep_instructions = 0;
+        group->lockstep_lane_instructions = 0;
+        group->scalar_instructions = 0;
+        group->frames_run = 0;
+    }
+    seconds = 0;
+}
+
+// Runs every lane of the group until it has gone through frames frames. The registers live
+// in group.lanes while a lane runs and go back to its CPU for anything scalar.
+void LockstepRunner::run_group(Group &group, int frames, bool render) {
+    group.render = render;
+    group.active_count = 0;
+    for (int lane = 0; lane < group.size; lane++) {
+        Emulator *emulator = group.emulators[lane];
+        load_lane(group, lane);
+        emulator->begin_frame(render);
+        group.frames[lane] = emulator->get_ppu().get_frame();
+        group.frames_left[lane] = frames;
+        // Nothing is known about what is due until the first instruction has finished
+        group.event_cycles[lane] = 0;
+        group.active[group.active_count++] = lane;
+    }
+    while (group.active_count > 0) {
+        if (step_lockstep(group)) continue;
+        int active[LANES];
+        int count = group.active_count;
+        std::memcpy(active, group.active, count * sizeof(int));
+        for (int n = 0; n < count; n++) step_scalar(group, active[n]);
+    }
+}
+
+// Runs the next instruction on all active lanes at once if they all stand on the same one
+// and it has a lockstep form. Returns false, having changed nothing, otherwise.
+bool LockstepRunner::step_lockstep(Group &group) {
+    LaneRegisters &lanes = group.lanes;
+    int first = group.active[0];
+    unsigned short int pc = lanes.PC[first];
+    for (int n = 1; n < group.active_count; n++) {
+        if (lanes.PC[group.active[n]] != pc) return false;
+    }
+    if (!cartridge_readable(pc)) return false;
+    const LockstepOpcode &opcode = opcode_table[group.cartridges[first]->cpu_mem(pc)];
+    if (opcode.operation == OP_NONE) return false;
+    int length = instruction_length(opcode.mode);
+    unsigned char low = length > 1 ? group.cartridges[first]->cpu_mem(pc + 1) : 0;
+    unsigned char high = length > 2 ? group.cartridges[first]->cpu_mem(pc + 2) : 0;
+    // Each lane has its own cartridge, and banks may differ even where the PCs agree
+    for (int n = 1; n < group.active_count; n++) {
+        Mapper *cartridge = group.cartridges[group.active[n]];
+        if (cartridge->cpu_mem(pc) != opcode.opcode) return false;
+        if (length > 1 and cartridge->cpu_mem(pc + 1) != low) return false;
+        if (length > 2 and cartridge->cpu_mem(pc + 2) != high) return false;
+    }
+    unsigned short int word = low | (high << 8);
+    unsigned char operation = opcode.operation;
+    bool stack = operation == OP_JSR or operation == OP_RTS or operation == OP_PHA or operation == OP_PLA;
+    // JSR reads its target after pushing, which matters only for code on the stack page
+    if (stack and pc < 0x2000) return false;
+
+    bool reads = reads_operand(operation) and opcode.mode != MODE_IMMEDIATE;
+    bool stores = stores_result(operation);
+    unsigned short int addresses[LANES];
+    std::memset(lanes.extra_cycles, 0, sizeof(lanes.extra_cycles));
+    if (reads or stores) {
+        for (int n = 0; n < group.active_count; n++) {
+            int lane = group.active[n];
+            unsigned short int address = word;
+            unsigned char index = 0;
+            if (opcode.mode == MODE_ZERO_PAGE_X) address = (low + lanes.X[lane]) & 0xFF;
+            else if (opcode.mode == MODE_ZERO_PAGE_Y) address = (low + lanes.Y[lane]) & 0xFF;
+            else if (opcode.mode == MODE_ABSOLUTE_X) index = lanes.X[lane];
+            else if (opcode.mode == MODE_ABSOLUTE_Y) index = lanes.Y[lane];
+            address += index;
+            if (reads and !cartridge_readable(address)) return false;
+            if (stores and !cartridge_writable(address)) return false;
+            if (opcode.page_penalty and low + index > 0xFF) lanes.extra_cycles[lane] = 1;
+            addresses[lane] = address;
+        }
+    }
+
+    // Nothing has been changed until here
+    if (reads) {
+        for (int n = 0; n < group.active_count; n++) {
+            int lane = group.active[n];
+            lanes.operand[lane] = group.cartridges[lane]->cpu_mem(addresses[lane]);
+        }
+    }
+    else if (opcode.mode == MODE_IMMEDIATE) std::memset(lanes.operand, low, sizeof(lanes.operand));
+    if (stack) {
+        for (int n = 0; n < group.active_count; n++) {
+            int lane = group.active[n];
+            Mapper *cartridge = group.cartridges[lane];
+            unsigned char &sp = lanes.SP[lane];
+            if (operation == OP_JSR) {
+                unsigned short int return_address = lanes.PC[lane] + 2;
+                cartridge->cpu_mem_store(0x0100 + sp--, return_address >> 8);
+                cartridge->cpu_mem_store(0x0100 + sp--, return_address & 0xFF);
+            }
+            else if (operation == OP_RTS) {
+                unsigned char return_low = cartridge->cpu_mem(0x0100 + ++sp);
+                unsigned char return_high = cartridge->cpu_mem(0x0100 + ++sp);
+                // RTS resumes one past the address JSR pushed, which the shared length adds
+                lanes.PC[lane] = return_low | (return_high << 8);
+            }
+            else if (operation == OP_PHA) cartridge->cpu_mem_store(0x0100 + sp--, lanes.A[lane]);
+            else lanes.operand[lane] = cartridge->cpu_mem(0x0100 + ++sp);
+        }
+    }
+    execute(lanes, opcode, opcode.mode == MODE_RELATIVE or opcode.mode == MODE_IMMEDIATE ? low : word);
+    if (stores) {
+        for (int n = 0; n < group.active_count; n++) {
+            int lane = group.active[n];
+            group.cartridges[lane]->cpu_mem_store(addresses[lane], lanes.result[lane]);
+        }
+    }
+    group.lockstep_instructions++;
+    group.lockstep_lane_instructions += group.active_count;
+
+    int active[LANES];
+    int count = group.active_count;
+    std::memcpy(active, group.active, count * sizeof(int));
+    for (int n = 0; n < count; n++) {
+        int lane = active[n];
+        if (lanes.cycles[lane] < group.event_cycles[lane]) continue;
+        store_lane(group, lane);
+        group.emulators[lane]->finish_instruction();
+        load_lane(group, lane);
+        after_instruction(group, lane);
+    }
+    return true;
+}
+
+void LockstepRunner::step_scalar(Group &group, int lane) {
+    store_lane(group, lane);
+    group.emulators[lane]->step();
+    load_lane(group, lane);
+    group.scalar_instructions++;
+    after_instruction(group, lane);
+}
+
+// Follows an instruction that finished in the emulator, whose CPU holds the lane's
+// registers: notes when the next event is due, and ends the lane's frame if it is over.
+// A lane out of frames leaves the active ones.
+void LockstepRunner::after_instruction(Group &group, int lane) {
+    Emulator *emulator = group.emulators[lane];
+    group.event_cycles[lane] = emulator->next_event_cycle();
+    if (emulator->get_ppu().get_frame() == group.frames[lane]) return;
+    emulator->end_frame(group.render);
+    group.frames_run++;
+    if (--group.frames_left[lane] > 0) {
+        emulator->begin_frame(group.render);
+        group.frames[lane] = emulator->get_ppu().get_frame();
+        // Catching up at the end of the frame may leave a DMC stall or an interrupt behind
+        group.event_cycles[lane] = 0;
+        return;
+    }
+    int count = 0;
+    for (int n = 0; n < group.active_count; n++) {
+        if (group.active[n] != lane) group.active[count++] = group.active[n];
+    }
+    group.active_count = count;
+}
+
+void LockstepRunner::load_lane(Group &group, int lane) {
+    CPURegisters registers = group.emulators[lane]->get_cpu().get_registers();
+    LaneRegisters &lanes = group.lanes;
+    lanes.A[lane] = registers.A;
+    lanes.X[lane] = registers.X;
+    lanes.Y[lane] = registers.Y;
+    lanes.SP[lane] = registers.SP;
+    lanes.STATUS[lane] = registers.STATUS;
+    lanes.PC[lane] = registers.PC;
+    lanes.cycles[lane] = registers.cycles;
+}
+
+void LockstepRunner::store_lane(Group &group, int lane) {
+    LaneRegisters &lanes = group.lanes;
+    CPURegisters registers;
+    registers.A = lanes.A[lane];
+    registers.X = lanes.X[lane];
+    registers.Y = lanes.Y[lane];
+    registers.SP = lanes.SP[lane];
+    registers.STATUS = lanes.STATUS[lane];
+    registers.PC = lanes.PC[lane];
+    registers.cycles = lanes.cycles[lane];
+    group.emulators[lane]->get_cpu().set_registers(registers);
+}
@@ -0,0 +1,111 @@
+#ifndef LOCKSTEP_RUNNER_H
+#define LOCKSTEP_RUNNER_H
+
+#include <functional>
+#include <vector>
+#include "episode_start.h"
+#include "thread_pool.h"
+#include "../emulator/emulator.h"
+
+// How the instructions of a lockstep runner were run, and the frames they made, since its
+// stats were last reset.
+struct LockstepStats {
+    // Instructions decoded once for a whole group, and the lane instructions they stood for
+    unsigned long long int lockstep_instructions;
+    unsigned long long int lockstep_lane_instructions;
+    // Instructions one lane ran alone, because the lanes were apart or the opcode has no
+    // lockstep form
+    unsigned long long int scalar_instructions;
+    unsigned long long int frames;
+    double seconds;
+    // Frames per second over all instances together
+    double fps;
+};
+
+// The registers of a group's lanes, one array per register, so that an operation on all
+// lanes is one loop the compiler turns into vector instructions.
+struct LaneRegisters {
+    static const int LANES = 16;
+    alignas(64) unsigned char A[LANES];
+    alignas(64) unsigned char X[LANES];
+    alignas(64) unsigned char Y[LANES];
+    alignas(64) unsigned char SP[LANES];
+    alignas(64) unsigned char STATUS[LANES];
+    alignas(64) unsigned short int PC[LANES];
+    alignas(64) unsigned long long int cycles[LANES];
+    // Each lane's operand as read from memory, and the value to be stored back
+    alignas(64) unsigned char operand[LANES];
+    alignas(64) unsigned char result[LANES];
+    // Extra cycles of each lane for an indexed read that crossed a page
+    alignas(64) unsigned char extra_cycles[LANES];
+};
+
+struct LockstepOpcode;
+
+// Runs many instances of the same game in groups of LANES, the way BatchRunner does, but
+// with each group's CPU registers kept together in LaneRegisters. While the lanes of a
+// group stand on the same instruction, it is decoded once and run for all of them with
+// vector instructions, AVX-512 or AVX2 when the CPU has them; memory operands are still
+// read and written lane by lane. Lanes that have drifted apart, and instructions that touch
+// the PPU, the APU, the interrupt flag or anything but RAM and ROM, fall back to a scalar
+// step() of each lane. Every instance comes out exactly as it would running alone.
+class LockstepRunner {
+    public:
+        static const int LANES = LaneRegisters::LANES;
+        // cartridge is only copied and stays the caller's. threads of 0 means one per
+        // hardware thread; each group of LANES instances is one task.
+        LockstepRunner(Mapper *cartridge, int instances, int threads = 0, bool pin_threads = true);
+        ~LockstepRunner();
+        int get_instances();
+        int get_threads();
+        Emulator &get_instance(int instance);
+        // As in BatchRunner.
+        void capture_start(int instance = 0);
+        void clear_start();
+        void reset();
+        void reset_instance(int instance);
+        // Runs frames frames on every instance.
+        void run_frames(int frames, bool render = false);
+        // Without SIMD the lockstep operations are built for the baseline instruction set.
+        void set_simd(bool enabled);
+        bool get_simd();
+        // The instruction set the lockstep operations currently run with.
+        const char *get_simd_name();
+        LockstepStats get_stats();
+        void reset_stats();
+
+    private:
+        typedef void (*Execute)(LaneRegisters &lanes, const LockstepOpcode &opcode, unsigned short int operand);
+        struct Group {
+            LaneRegisters lanes;
+            int size;
+            Emulator *emulators[LANES];
+            Mapper *cartridges[LANES];
+            unsigned long long int event_cycles[LANES];
+            unsigned long long int frames[LANES];
+            int frames_left[LANES];
+            int active[LANES];
+            int active_count;
+            bool render;
+            unsigned long long int lockstep_instructions;
+            unsigned long long int lockstep_lane_instructions;
+            unsigned long long int scalar_instructions;
+            unsigned long long int frames_run;
+        };
+        std::vector<Group *> groups;
+        ThreadPool pool;
+        std::vector<std::function<void()>> tasks;
+        EpisodeStart start;
+        Execute execute;
+        const char *simd_name;
+        bool simd;
+        double seconds;
+        void run_group(Group &group, int frames, bool render);
+        bool step_lockstep(Group &group);
+        void step_scalar(Group &group, int lane);
+        void after_instruction(Group &group, int lane);
+        void load_lane(Group &group, int lane);
+        void store_lane(Group &group, int lane);
+};
+
+#endif
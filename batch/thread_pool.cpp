@@ -0,0 +1,102 @@
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int threads, bool pin_threads) {
+    if (threads <= 0) threads = std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    batch = 0;
+    stopping = false;
+    remaining = 0;
+    steals = 0;
+    for (int n = 0; n < threads; n++) workers.push_back(new Worker());
+    for (int n = 0; n < threads; n++) workers[n]->thread = std::thread(&ThreadPool::work, this, n, pin_threads);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    // All joined before any is deleted: a worker still running may look into the others
+    for (Worker *worker : workers) worker->thread.join();
+    for (Worker *worker : workers) delete worker;
+}
+
+int ThreadPool::get_threads() {
+    return workers.size();
+}
+
+void ThreadPool::run(const std::vector<std::function<void()>> &tasks) {
+    if (tasks.empty()) return;
+    // Set before any task is queued: a worker still looking over the last batch may take one
+    remaining = tasks.size();
+    for (unsigned int n = 0; n < tasks.size(); n++) {
+        Worker *worker = workers[n % workers.size()];
+        std::lock_guard<std::mutex> guard(worker->lock);
+        worker->tasks.push_back(&tasks[n]);
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    batch++;
+    wake.notify_all();
+    done.wait(guard, [this]() { return remaining == 0; });
+}
+
+unsigned long long int ThreadPool::get_steals() {
+    return steals;
+}
+
+void ThreadPool::work(int index, bool pin) {
+#ifdef __linux__
+    if (pin) {
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(index % std::thread::hardware_concurrency(), &cores);
+        pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+    }
+#endif
+    unsigned long long int seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]() { return stopping or batch != seen; });
+            if (stopping) return;
+            seen = batch;
+        }
+        // A worker that finds nothing left goes back to sleep; the others finish the batch
+        for (const std::function<void()> *task = take_task(index); task != nullptr; task = take_task(index)) {
+            (*task)();
+            if (--remaining == 0) {
+                std::lock_guard<std::mutex> guard(lock);
+                done.notify_all();
+            }
+        }
+    }
+}
+
+// The newest task of the worker's own deque, or else the oldest of another's.
+const std::function<void()> *ThreadPool::take_task(int index) {
+    {
+        Worker *own = workers[index];
+        std::lock_guard<std::mutex> guard(own->lock);
+        if (!own->tasks.empty()) {
+            const std::function<void()> *task = own->tasks.back();
+            own->tasks.pop_back();
+            return task;
+        }
+    }
+    for (unsigned int n = 1; n < workers.size(); n++) {
+        Worker *victim = workers[(index + n) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if (!victim->tasks.empty()) {
+            const std::function<void()> *task = victim->tasks.front();
+            victim->tasks.pop_front();
+            steals++;
+            return task;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run batches of tasks. Each worker has its own deque:
+// a batch is dealt out round-robin, a worker takes from the back of its own deque and,
+// once that is empty, steals from the front of the others'. Tasks that run long on one
+// worker are then made up for by the others instead of leaving them idle. Workers can be
+// pinned to one core each so the emulators they run keep their caches.
+class ThreadPool {
+    public:
+        // threads of 0 means one per hardware thread.
+        ThreadPool(int threads = 0, bool pin_threads = true);
+        ~ThreadPool();
+        int get_threads();
+        // Runs every task once and returns when all are done. Only one batch at a time.
+        void run(const std::vector<std::function<void()>> &tasks);
+        // Tasks taken from another worker's deque since the pool started.
+        unsigned long long int get_steals();
+
+    private:
+        struct Worker {
+            std::mutex lock;
+            std::deque<const std::function<void()> *> tasks;
+            std::thread thread;
+        };
+        std::vector<Worker *> workers;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+        unsigned long long int batch;
+        bool stopping;
+        std::atomic<unsigned int> remaining;
+        std::atomic<unsigned long long int> steals;
+        void work(int index, bool pin);
+        const std::function<void()> *take_task(int index);
+};
+
+#endif
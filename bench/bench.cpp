@@ -0,0 +1,56 @@
+#include <cstring>
+#include <iostream>
+#include "bench.h"
+#include "../emulator/emulator.h"
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<unsigned char> state_after(Emulator &emulator, int frames) {
+    for (int i = 0; i < frames; i++) emulator.run_frame(false);
+    std::vector<unsigned char> state(emulator.get_state_size());
+    emulator.save_state(state.data(), state.size());
+    return state;
+}
+
+struct Benchmark {
+    const char *name;
+    int (*run)(int argc, char **argv);
+    const char *usage;
+};
+
+static const Benchmark benchmarks[] = {
+    {"ppu-sync", bench_ppu_sync, "[frames] [rom.nes]  lockstep vs lazy PPU and APU synchronization"},
+    {"headless", bench_headless, "[frames] [rom.nes]  rendered vs frame-skip vs headless frames"},
+    {"deferred", bench_deferred, "[frames] [rom.nes]  synchronous vs worker thread rendering"},
+    {"apu", bench_apu, "[seconds] [sample rate]  cycle-by-cycle vs lazy APU cost per emulated second"},
+    {"video", bench_video, "[frames] [repeats] [rom.nes]  scalar vs AVX2 palette conversion"},
+    {"audio", bench_audio, "[frames] [repeats] [rom.nes]  sound on vs off, scalar vs AVX2 resampling"},
+    {"audio-stream", bench_audio_stream, "[seconds] [clock skew %] [rom.nes]  audio buffer with and without rate control"},
+    {"nsf", bench_nsf, "[seconds] [threads] [file.nsf]  NSF tracks rendered serially vs in parallel"},
+    {"batch", bench_batch, "[instances] [frames] [threads] [rom.nes]  batch runner scaling from 1 thread up"},
+    {"lockstep", bench_lockstep, "[instances] [frames] [threads] [rom.nes]  scalar batch runner vs SIMD lockstep runner"},
+    {"state", bench_state, "[frames] [rom.nes] [file]  save state size, save and load cost, replay after a load"},
+    {"rewind", bench_rewind, "[frames] [memory cap MB] [rom.nes]  rewind buffer cost, compression and history held"},
+    {"run-ahead", bench_run_ahead, "[frames] [max frames ahead] [rom.nes]  per-frame cost of run-ahead against the frame budget"},
+    {"clone", bench_clone, "[clones] [width] [rom.nes]  pooled vs fresh emulator clones, beam search branching rate"},
+    {"episode", bench_episode, "[instances] [boot frames] [episodes] [rom.nes]  cold vs start snapshot episode resets"},
+    {"startup", bench_startup, "[instances] [rom.nes]  CPU and whole emulator instance creation rate"},
+    {"input", bench_input, "[frames] [paced seconds] [rom.nes]  scripted input through the event queue, press-to-read latency"},
+    {"movie", bench_movie, "[frames] [runs] [hash interval] [rom.nes]  input movie recording cost, streaming playback, desync detection"},
+    {"netplay", bench_netplay, "[frames] [latency ms] [jitter ms] [loss %] [input delay] [rom.nes]  two-player rollback over loopback UDP, rollback depth and resimulation time"},
+};
+
+int main(int argc, char **argv) {
+    if (argc >= 2) {
+        for (const Benchmark &benchmark : benchmarks) {
+            if (std::strcmp(argv[1], benchmark.name) == 0) return benchmark.run(argc - 2, argv + 2);
+        }
+    }
+    std::cerr << "usage: " << argv[0] << " <benchmark> [args]" << std::endl;
+    for (const Benchmark &benchmark : benchmarks) {
+        std::cerr << "  " << benchmark.name << " " << benchmark.usage << std::endl;
+    }
+    return 1;
+}
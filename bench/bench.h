@@ -0,0 +1,36 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <vector>
+#include "../util/hash.h"
+
+class Emulator;
+
+// Seconds elapsed since start.
+double seconds_since(std::chrono::steady_clock::time_point start);
+
+// Runs frames headless frames, then returns the state the emulator is in.
+std::vector<unsigned char> state_after(Emulator &emulator, int frames);
+
+int bench_ppu_sync(int argc, char **argv);
+int bench_headless(int argc, char **argv);
+int bench_deferred(int argc, char **argv);
+int bench_apu(int argc, char **argv);
+int bench_video(int argc, char **argv);
+int bench_audio(int argc, char **argv);
+int bench_audio_stream(int argc, char **argv);
+int bench_nsf(int argc, char **argv);
+int bench_batch(int argc, char **argv);
+int bench_lockstep(int argc, char **argv);
+int bench_state(int argc, char **argv);
+int bench_rewind(int argc, char **argv);
+int bench_run_ahead(int argc, char **argv);
+int bench_clone(int argc, char **argv);
+int bench_episode(int argc, char **argv);
+int bench_startup(int argc, char **argv);
+int bench_input(int argc, char **argv);
+int bench_movie(int argc, char **argv);
+int bench_netplay(int argc, char **argv);
+
+#endif
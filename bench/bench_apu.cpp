@@ -0,0 +1,124 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../apu/apu.h"
+
+namespace {
+
+const unsigned long long int CYCLES_PER_FRAME = 29781;
+
+// Brings the APU to cycle, either one cycle at a time or with lazy catch-up.
+void advance(APU &apu, unsigned long long int cycle, bool lockstep) {
+    if (lockstep) {
+        while (apu.get_cycle() < cycle) apu.tick();
+    }
+    else apu.catch_up(cycle);
+}
+
+// Register writes of a little tune, one call per frame: a pulse arpeggio, a swept pulse
+// lead, a triangle bass line, noise hits and a looping DMC sample played from PRG-ROM.
+void play_frame(APU &apu, unsigned long long int frame_cycle, int frame, bool lockstep) {
+    static const unsigned short int notes[8] = {0x1AB, 0x153, 0x11C, 0x0FD, 0x0D5, 0x0BE, 0x0A9, 0x08E};
+    struct Write {
+        unsigned short int address;
+        unsigned char value;
+    };
+    std::vector<Write> writes;
+    if (frame == 0) {
+        writes.push_back({0x4015, 0x0F});
+        writes.push_back({0x4017, 0x00});
+        writes.push_back({0x4000, 0xBF});
+        writes.push_back({0x4004, 0x86});
+        writes.push_back({0x4008, 0xFF});
+        writes.push_back({0x400C, 0x34});
+        writes.push_back({0x4010, 0x4E});
+        writes.push_back({0x4012, 0x00});
+        writes.push_back({0x4013, 0x10});
+    }
+    unsigned short int arpeggio = notes[(frame / 2) % 8];
+    writes.push_back({0x4002, (unsigned char) arpeggio});
+    if (frame % 2 == 0) writes.push_back({0x4003, (unsigned char) (0x08 | (arpeggio >> 8))});
+    if (frame % 16 == 0) {
+        unsigned short int lead = notes[(frame / 16) % 8] * 2;
+        writes.push_back({0x4001, 0x9A});
+        writes.push_back({0x4006, (unsigned char) lead});
+        writes.push_back({0x4007, (unsigned char) (0x58 | (lead >> 8))});
+    }
+    if (frame % 8 == 0) {
+        unsigned short int bass = notes[(frame / 32) % 4] * 2;
+        writes.push_back({0x400A, (unsigned char) bass});
+        writes.push_back({0x400B, (unsigned char) (0x18 | (bass >> 8))});
+    }
+    if (frame % 8 == 4) {
+        writes.push_back({0x400E, (unsigned char) (0x04 + frame % 3)});
+        writes.push_back({0x400F, 0x18});
+    }
+    if (frame % 60 == 30) writes.push_back({0x4015, 0x1F});
+
+    // Spread over the frame like a sound driver running from the NMI and the main loop
+    for (unsigned int i = 0; i < writes.size(); i++) {
+        unsigned long long int cycle = frame_cycle + 100 + i * 12;
+        advance(apu, cycle, lockstep);
+        apu.write_register(writes[i].address, writes[i].value);
+    }
+    if (frame % 4 == 0) {
+        advance(apu, frame_cycle + 20000, lockstep);
+        apu.read_register(0x4015);
+    }
+}
+
+struct ApuRun {
+    double seconds;
+    unsigned long long int hash;
+    unsigned long long int sample_count;
+};
+
+ApuRun run_apu(int frames, int sample_rate, bool lockstep) {
+    Mapper *mapper = synthetic_rom();
+    APU *apu = new APU(mapper);
+    apu->set_sample_rate(sample_rate);
+    std::vector<short int> samples(sample_rate);
+    ApuRun run;
+    run.hash = hash_bytes(nullptr, 0);
+    run.sample_count = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        unsigned long long int frame_cycle = frame * CYCLES_PER_FRAME;
+        play_frame(*apu, frame_cycle, frame, lockstep);
+        advance(*apu, frame_cycle + CYCLES_PER_FRAME, lockstep);
+        apu->end_frame(frame_cycle + CYCLES_PER_FRAME);
+        int count = apu->read_samples(samples.data(), samples.size());
+        run.hash = hash_bytes(samples.data(), count * sizeof(short int), run.hash);
+        run.sample_count += count;
+    }
+    run.seconds = seconds_since(start);
+    delete apu;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Runs the APU alone on a scripted tune, clocked cycle by cycle and with lazy catch-up,
+// and reports the cost of each per emulated second.
+int bench_apu(int argc, char **argv) {
+    double emulated_seconds = argc >= 1 ? std::atof(argv[0]) : 60;
+    int sample_rate = argc >= 2 ? std::atoi(argv[1]) : APU::SAMPLE_RATE;
+    int frames = (int) (emulated_seconds * 60);
+
+    ApuRun lockstep = run_apu(frames, sample_rate, true);
+    ApuRun lazy = run_apu(frames, sample_rate, false);
+
+    double emulated = (double) frames * CYCLES_PER_FRAME / 1789773.0;
+    std::cout << "emulated: " << emulated << " s, " << lazy.sample_count << " samples at " << sample_rate << " Hz" << std::endl;
+    std::cout << "lockstep: " << lockstep.seconds / emulated * 1000 << " ms per emulated second" << std::endl;
+    std::cout << "lazy:     " << lazy.seconds / emulated * 1000 << " ms per emulated second (" << emulated / lazy.seconds
+              << "x real time)" << std::endl;
+    std::cout << "speedup:  " << lockstep.seconds / lazy.seconds << "x" << std::endl;
+    std::cout << "samples:  " << (lockstep.hash == lazy.hash ? "identical" : "DIFFERENT") << " (hash " << std::hex
+              << lazy.hash << std::dec << ")" << std::endl;
+    return lockstep.hash == lazy.hash ? 0 : 1;
+}
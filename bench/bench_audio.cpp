@@ -0,0 +1,190 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../audio/audio.h"
+#include "../audio/audio_stream.h"
+#include "../emulator/emulator.h"
+
+namespace {
+
+struct SoundRun {
+    double seconds;
+    unsigned long long int frame_hash;
+    // APU samples of each frame, at APU::SAMPLE_RATE
+    std::vector<std::vector<short int>> samples;
+};
+
+SoundRun run_sound(const char *rom, int frames, bool sound) {
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    emulator->get_apu().set_sound(sound);
+    SoundRun run;
+    run.frame_hash = hash_bytes(nullptr, 0);
+    run.samples.resize(frames);
+    std::vector<short int> samples(APU::SAMPLE_RATE);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        emulator->run_frame();
+        int count = emulator->get_apu().read_samples(samples.data(), samples.size());
+        run.samples[f].assign(samples.data(), samples.data() + count);
+        run.frame_hash = hash_bytes(emulator->get_ppu().get_frame_buffer(), 256 * 240 * 2, run.frame_hash);
+    }
+    run.seconds = seconds_since(start);
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+// Converts every frame's samples repeats times, starting from silence each time, and
+// returns the seconds taken, leaving the last repeat's output in output.
+double time_conversion(AudioOutput &audio, const std::vector<std::vector<short int>> &frames, int repeats,
+                       std::vector<short int> &output) {
+    std::vector<short int> buffer(audio.get_output_rate() / 10);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        audio.clear();
+        output.clear();
+        for (const std::vector<short int> &frame : frames) {
+            int count = audio.convert(frame.data(), frame.size(), buffer.data(), buffer.size());
+            output.insert(output.end(), buffer.data(), buffer.data() + count);
+        }
+    }
+    return seconds_since(start);
+}
+
+struct StreamRun {
+    unsigned int min_fill;
+    unsigned int max_fill;
+    double mean_fill;
+    AudioStreamStats stats;
+};
+
+// Plays the emulator in real time into an audio stream drained by a thread that stands in
+// for the host's audio callback, whose clock runs skew faster than the emulator's.
+StreamRun run_stream(const char *rom, double seconds, double skew, bool rate_control) {
+    const int output_rate = 48000;
+    const int chunk = 256;
+    const unsigned int target = 1024;
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    AudioStream stream(emulator->get_apu().get_sample_rate(), output_rate, target);
+    stream.set_rate_control(rate_control);
+    std::atomic<bool> playing(false);
+    std::atomic<bool> stopping(false);
+
+    std::thread callback([&]() {
+        std::vector<short int> buffer(chunk);
+        while (!playing and !stopping) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::chrono::duration<double> period(chunk / (output_rate * (1 + skew)));
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        while (!stopping) {
+            stream.read(buffer.data(), chunk);
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    StreamRun run;
+    run.min_fill = ~0U;
+    run.max_fill = 0;
+    run.mean_fill = 0;
+    unsigned int measured = 0;
+    std::vector<short int> samples(APU::SAMPLE_RATE);
+    // NTSC frame rate
+    std::chrono::duration<double> frame_period(29780.5 / 1789773.0);
+    int frames = (int) (seconds / frame_period.count());
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        emulator->run_frame();
+        int count = emulator->get_apu().read_samples(samples.data(), samples.size());
+        stream.write(samples.data(), count);
+        unsigned int fill = stream.get_stats().fill;
+        // The callback starts once the target latency is buffered, as a host device would
+        if (!playing and fill >= target) playing = true;
+        else if (playing) {
+            if (fill < run.min_fill) run.min_fill = fill;
+            if (fill > run.max_fill) run.max_fill = fill;
+            run.mean_fill += fill;
+            measured++;
+        }
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_period);
+        std::this_thread::sleep_until(next);
+    }
+    stopping = true;
+    callback.join();
+    run.mean_fill = measured > 0 ? run.mean_fill / measured : 0;
+    run.stats = stream.get_stats();
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Runs the emulator with and without sound, then brings the APU samples to host rates
+// with the scalar and the AVX2 filter kernels. Float sums in a different order may round
+// differently, so the two outputs are compared with a tolerance of one step.
+int bench_audio(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    int repeats = argc >= 2 ? std::atoi(argv[1]) : 5;
+    const char *rom = argc >= 3 ? argv[2] : nullptr;
+
+    SoundRun with_sound = run_sound(rom, frames, true);
+    SoundRun without_sound = run_sound(rom, frames, false);
+    bool same_frames = with_sound.frame_hash == without_sound.frame_hash;
+    std::cout << "sound on:  " << frames / with_sound.seconds << " fps" << std::endl;
+    std::cout << "sound off: " << frames / without_sound.seconds << " fps, " << with_sound.seconds / without_sound.seconds
+              << "x, frames " << (same_frames ? "identical" : "DIFFERENT") << std::endl;
+
+    AudioOutput audio(APU::SAMPLE_RATE);
+    if (!audio.get_simd()) std::cout << "AVX2 not available, both runs use the scalar loop" << std::endl;
+    bool simd = audio.get_simd();
+    bool close = true;
+    const int rates[] = {48000, 44100, 22050};
+    for (int rate : rates) {
+        audio.set_rates(APU::SAMPLE_RATE, rate);
+        std::vector<short int> scalar_output, simd_output;
+        audio.set_simd(false);
+        double scalar_seconds = time_conversion(audio, with_sound.samples, repeats, scalar_output);
+        audio.set_simd(simd);
+        double simd_seconds = time_conversion(audio, with_sound.samples, repeats, simd_output);
+
+        int difference = scalar_output.size() == simd_output.size() ? 0 : 65536;
+        for (unsigned int i = 0; i < scalar_output.size() and i < simd_output.size(); i++) {
+            int d = std::abs(scalar_output[i] - simd_output[i]);
+            if (d > difference) difference = d;
+        }
+        close = close and difference <= 1;
+        double conversions = (double) frames * repeats;
+        std::cout << rate << " Hz: " << simd_output.size() << " samples, scalar " << scalar_seconds / conversions * 1e6
+                  << " us/frame, simd " << simd_seconds / conversions * 1e6 << " us/frame, speedup "
+                  << scalar_seconds / simd_seconds << "x, max difference " << difference << std::endl;
+    }
+    return same_frames and close ? 0 : 1;
+}
+
+// Plays through an audio stream in real time, with and without rate control, while the
+// audio thread's clock runs faster than the emulator's, and reports the buffer's fill and
+// underruns.
+int bench_audio_stream(int argc, char **argv) {
+    double seconds = argc >= 1 ? std::atof(argv[0]) : 10;
+    double skew = argc >= 2 ? std::atof(argv[1]) / 100 : 0.003;
+    const char *rom = argc >= 3 ? argv[2] : nullptr;
+
+    bool steady = true;
+    for (bool rate_control : {false, true}) {
+        StreamRun run = run_stream(rom, seconds, skew, rate_control);
+        std::cout << "rate control " << (rate_control ? "on: " : "off:") << " fill " << run.mean_fill << " mean, "
+                  << run.min_fill << "-" << run.max_fill << " (target " << run.stats.target << " of "
+                  << run.stats.capacity << "), " << run.stats.underruns << " underruns, " << run.stats.missing_samples
+                  << " samples missing, " << run.stats.dropped_samples << " dropped, speed " << run.stats.speed << std::endl;
+        if (rate_control) steady = run.stats.underruns == 0;
+    }
+    return steady ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../batch/batch_runner.h"
+
+namespace {
+
+unsigned long long int state_hash(Emulator &emulator) {
+    unsigned long long int hash = hash_bytes(emulator.get_ppu().get_frame_buffer(), 256 * 240 * 2);
+    CPU &cpu = emulator.get_cpu();
+    unsigned char registers[6] = {cpu.get_A(), cpu.get_X(), cpu.get_Y(), cpu.get_SP(), cpu.get_STATUS(), (unsigned char) cpu.get_PC()};
+    hash = hash_bytes(registers, sizeof(registers), hash);
+    unsigned long long int cycles = cpu.get_cycles();
+    return hash_bytes(&cycles, sizeof(cycles), hash);
+}
+
+}
+
+// Runs a batch of instances on 1, 2, 4... threads up to the hardware's count and reports
+// aggregate frames per second and how close each step comes to linear scaling. The last
+// frame is rendered, and every instance must end up as a single emulator run alone does.
+int bench_batch(int argc, char **argv) {
+    int instances = argc >= 1 ? std::atoi(argv[0]) : 16;
+    int frames = argc >= 2 ? std::atoi(argv[1]) : 300;
+    int max_threads = argc >= 3 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+    Mapper *cartridge = bench_rom(argc >= 4 ? argv[3] : nullptr);
+    if (instances < 1) instances = 1;
+    if (frames < 1) frames = 1;
+    if (max_threads < 1) max_threads = 1;
+
+    Mapper *single_cartridge = cartridge->copy();
+    Emulator *single = new Emulator(single_cartridge);
+    single->get_apu().set_sound(false);
+    single->reset();
+    for (int i = 0; i < frames - 1; i++) single->run_frame(false);
+    single->run_frame(true);
+    unsigned long long int expected = state_hash(*single);
+    delete single;
+    delete single_cartridge;
+
+    std::cout << instances << " instances, " << frames << " frames each" << std::endl;
+    double base_fps = 0;
+    bool identical = true;
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+    for (int threads : thread_counts) {
+        BatchRunner batch(cartridge, instances, threads);
+        batch.run_frames(frames - 1);
+        batch.run_frames(1, true);
+        BatchStats stats = batch.get_stats();
+        for (int n = 0; n < instances; n++) {
+            if (state_hash(batch.get_instance(n)) != expected) identical = false;
+        }
+        if (threads == 1) base_fps = stats.fps;
+        std::cout << "threads " << threads << ": " << stats.fps << " frames/s, " << stats.fps / base_fps << "x, "
+                  << 100 * stats.fps / (base_fps * threads) << "% efficiency, " << stats.steals << " steals" << std::endl;
+    }
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (hash " << std::hex << expected << std::dec << ")"
+              << std::endl;
+    delete cartridge;
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../emulator/emulator_pool.h"
+
+// Clones a running emulator from a pool and from scratch (a new cartridge and emulator
+// loading a state) and reports the cost of each. Then runs a small beam search, where
+// every node of a level branches into width clones that run a frame each, and reports the
+// branches made per second. A clone must run on exactly as its source does.
+int bench_clone(int argc, char **argv) {
+    int clones = argc >= 1 ? std::atoi(argv[0]) : 10000;
+    int width = argc >= 2 ? std::atoi(argv[1]) : 8;
+    const char *rom = argc >= 3 ? argv[2] : nullptr;
+    if (clones < 1) clones = 1;
+    if (width < 1) width = 1;
+
+    Mapper *cartridge = bench_rom(rom);
+    Emulator *source = new Emulator(cartridge);
+    source->get_apu().set_sound(false);
+    source->reset();
+    for (int i = 0; i < 60; i++) source->run_frame(false);
+    EmulatorPool pool(cartridge, width * width);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < clones; i++) pool.release(source->clone(pool));
+    double pool_seconds = seconds_since(start);
+
+    int fresh_clones = clones / 10 + 1;
+    std::vector<unsigned char> state(source->get_state_size());
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < fresh_clones; i++) {
+        Mapper *copy = cartridge->copy();
+        Emulator *fresh = new Emulator(copy);
+        source->save_state(state.data(), state.size());
+        fresh->load_state(state.data(), state.size());
+        delete fresh;
+        delete copy;
+    }
+    double fresh_seconds = seconds_since(start);
+
+    // Beam search: the first node of each level is the one kept
+    Emulator *clone = source->clone(pool);
+    std::vector<unsigned char> expected = state_after(*source, 30);
+    bool identical = state_after(*clone, 30) == expected;
+    pool.release(clone);
+    std::vector<Emulator *> level;
+    level.push_back(source->clone(pool));
+    unsigned long long int branches = 0;
+    start = std::chrono::steady_clock::now();
+    while (seconds_since(start) < 1.0) {
+        std::vector<Emulator *> next;
+        for (Emulator *node : level) {
+            for (int n = 0; n < width; n++) {
+                Emulator *child = node->clone(pool);
+                child->run_frame(false);
+                next.push_back(child);
+                branches++;
+            }
+        }
+        for (Emulator *node : level) pool.release(node);
+        for (unsigned int n = 1; n < next.size(); n++) pool.release(next[n]);
+        level.assign(1, next[0]);
+    }
+    double search_seconds = seconds_since(start);
+    for (Emulator *node : level) pool.release(node);
+    PoolStats stats = pool.get_stats();
+
+    std::cout << "pool clone:  " << pool_seconds / clones * 1e6 << " us" << std::endl;
+    std::cout << "fresh clone: " << fresh_seconds / fresh_clones * 1e6 << " us, " << fresh_seconds / fresh_clones / (pool_seconds / clones)
+              << "x the pool's" << std::endl;
+    std::cout << "beam search: " << branches / search_seconds << " branches/s of width " << width << ", each running a frame" << std::endl;
+    std::cout << "pool:        " << stats.clones << " clones from " << stats.allocations << " emulators, " << stats.in_use << " in use" << std::endl;
+    std::cout << "results:     " << (identical ? "identical" : "DIFFERENT") << std::endl;
+    delete source;
+    delete cartridge;
+    return identical ? 0 : 1;
+}
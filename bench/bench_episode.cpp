@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../batch/batch_runner.h"
+
+// Starts episodes three ways: a new emulator powered on and run through boot_frames of
+// boot, an existing one reset and run through them, and an existing one loading the state
+// captured after them. The reset keeps the RAM of the episode before, as the console's
+// reset button does, so only the first and the last start every episode alike: instances
+// started from the snapshot must be, and run on, as a new emulator does.
+int bench_episode(int argc, char **argv) {
+    int instances = argc >= 1 ? std::atoi(argv[0]) : 16;
+    int boot_frames = argc >= 2 ? std::atoi(argv[1]) : 120;
+    int episodes = argc >= 3 ? std::atoi(argv[2]) : 10000;
+    Mapper *cartridge = bench_rom(argc >= 4 ? argv[3] : nullptr);
+    if (instances < 1) instances = 1;
+    if (boot_frames < 0) boot_frames = 0;
+    if (episodes < 1) episodes = 1;
+
+    int cold_episodes = instances;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> expected;
+    std::vector<unsigned char> expected_after;
+    for (int i = 0; i < cold_episodes; i++) {
+        Mapper *copy = cartridge->copy();
+        Emulator *emulator = new Emulator(copy);
+        emulator->get_apu().set_sound(false);
+        emulator->reset();
+        std::vector<unsigned char> state = state_after(*emulator, boot_frames);
+        if (i == 0) {
+            expected = state;
+            expected_after = state_after(*emulator, 60);
+        }
+        delete emulator;
+        delete copy;
+    }
+    double construct_seconds = seconds_since(start);
+
+    BatchRunner runner(cartridge, instances, 1);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cold_episodes; i++) {
+        runner.reset_instance(i % instances);
+        for (int frame = 0; frame < boot_frames; frame++) runner.get_instance(i % instances).run_frame(false);
+    }
+    double cold_seconds = seconds_since(start);
+
+    runner.capture_start(0);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < episodes; i++) runner.reset_instance(i % instances);
+    double snapshot_seconds = seconds_since(start);
+
+    std::vector<unsigned char> state(expected.size());
+    bool identical = true;
+    for (int n = 0; n < instances; n++) {
+        runner.get_instance(n).save_state(state.data(), state.size());
+        if (state != expected) identical = false;
+    }
+    runner.run_frames(60);
+    runner.reset();
+    runner.run_frames(60);
+    for (int n = 0; n < instances; n++) {
+        if (state_after(runner.get_instance(n), 0) != expected_after) identical = false;
+    }
+
+    double construct = construct_seconds / cold_episodes;
+    double cold = cold_seconds / cold_episodes;
+    double snapshot = snapshot_seconds / episodes;
+    std::cout << instances << " instances, " << boot_frames << " boot frames" << std::endl;
+    std::cout << "new emulator + boot: " << construct * 1e3 << " ms per episode" << std::endl;
+    std::cout << "reset + boot:        " << cold * 1e3 << " ms per episode" << std::endl;
+    std::cout << "start snapshot:      " << snapshot * 1e6 << " us per episode, " << cold / snapshot << "x faster than reset + boot"
+              << std::endl;
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << std::endl;
+    delete cartridge;
+    return identical ? 0 : 1;
+}
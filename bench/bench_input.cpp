@@ -0,0 +1,163 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../emulator/emulator.h"
+
+namespace {
+
+// An NTSC frame
+const std::chrono::duration<double> FRAME_TIME(1.0 / 60.0988);
+
+struct InputRun {
+    unsigned long long int frame_hash;
+    std::vector<unsigned char> end_state;
+    InputStats stats;
+};
+
+// Scripted buttons for controller 1 from about the 7th frame on, every 50000 cycles or
+// further apart, so that they all fit in the queue at once.
+std::vector<InputEvent> script(int frames, unsigned int capacity) {
+    std::vector<InputEvent> events;
+    unsigned long long int end = frames * 29780ULL;
+    unsigned long long int spacing = end / capacity > 50000 ? end / capacity + 1 : 50000;
+    for (unsigned long long int cycle = 200000; cycle < end; cycle += spacing) {
+        events.push_back({cycle, 0, 0, (unsigned char) (events.size() * 37)});
+    }
+    return events;
+}
+
+void finish_run(Emulator *emulator, InputRun &run) {
+    run.frame_hash = hash_bytes(emulator->get_frame_buffer(), 256 * 240 * 2);
+    run.end_state.resize(emulator->get_state_size());
+    emulator->save_state(run.end_state.data(), run.end_state.size());
+    run.stats = emulator->get_controllers().get_stats();
+}
+
+// Sets the buttons itself before each instruction, and at the end of each frame, once their
+// cycle comes, as a reference that leaves the queue out.
+InputRun run_direct(const char *rom, int frames, const std::vector<InputEvent> &events) {
+    Mapper *mapper = bench_rom(rom, true);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->get_apu().set_sound(false);
+    emulator->reset();
+    unsigned int next = 0;
+    for (int i = 0; i < frames; i++) {
+        emulator->begin_frame(true);
+        unsigned long long int frame = emulator->get_ppu().get_frame();
+        while (true) {
+            while (next < events.size() and emulator->get_cpu().get_cycles() >= events[next].cycle) {
+                emulator->get_controllers().set_buttons(events[next].port, events[next].buttons);
+                next++;
+            }
+            if (emulator->get_ppu().get_frame() != frame) break;
+            emulator->step();
+        }
+        emulator->end_frame(true);
+    }
+    InputRun run;
+    finish_run(emulator, run);
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+// Feeds the events through the queue, from another thread while the frames run when
+// threaded is set.
+InputRun run_queued(const char *rom, int frames, const std::vector<InputEvent> &events, bool threaded) {
+    Mapper *mapper = bench_rom(rom, true);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->get_apu().set_sound(false);
+    emulator->reset();
+    ControllerPorts &controllers = emulator->get_controllers();
+    std::thread producer;
+    if (threaded) {
+        producer = std::thread([&controllers, &events]() {
+            for (const InputEvent &event : events) {
+                while (!controllers.push_event(event)) std::this_thread::yield();
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        });
+    }
+    else {
+        for (const InputEvent &event : events) controllers.push_event(event);
+    }
+    for (int i = 0; i < frames; i++) emulator->run_frame(true);
+    if (threaded) producer.join();
+    InputRun run;
+    finish_run(emulator, run);
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Scripted input first: the same events set directly before each instruction, queued up
+// front, and queued by another thread while the frames run must all come out the same.
+// Then interactive input: frames paced at 60 Hz while another thread presses buttons
+// every few milliseconds, reporting the delay from each press to the game's first read of
+// the controller after it.
+int bench_input(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    double seconds = argc >= 2 ? std::atof(argv[1]) : 2;
+    const char *rom = argc >= 3 ? argv[2] : nullptr;
+    if (frames < 1) frames = 1;
+    if (seconds < 0.1) seconds = 0.1;
+
+    std::vector<InputEvent> events = script(frames, 1024);
+    InputRun direct = run_direct(rom, frames, events);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    InputRun queued = run_queued(rom, frames, events, false);
+    double queued_seconds = seconds_since(start);
+    InputRun threaded = run_queued(rom, frames, events, true);
+    bool identical = true;
+    for (const InputRun *run : {&queued, &threaded}) {
+        if (run->frame_hash != direct.frame_hash or run->end_state != direct.end_state) identical = false;
+    }
+
+    Mapper *mapper = bench_rom(rom, true);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->get_apu().set_sound(false);
+    emulator->reset();
+    // Past the boot, where the game does not read the controller yet
+    for (int i = 0; i < 30; i++) emulator->run_frame(false);
+    ControllerPorts &controllers = emulator->get_controllers();
+    controllers.reset_stats();
+    std::atomic<bool> running(true);
+    std::thread producer([&controllers, &running]() {
+        unsigned char buttons = 0;
+        while (running.load()) {
+            buttons ^= BUTTON_A | BUTTON_RIGHT;
+            controllers.push_event({0, ControllerPorts::host_time(), 0, buttons});
+            std::this_thread::sleep_for(std::chrono::microseconds(3300));
+        }
+    });
+    int paced_frames = (int) (seconds / FRAME_TIME.count());
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < paced_frames; i++) {
+        emulator->run_frame(true);
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(FRAME_TIME * (i + 1)));
+    }
+    running.store(false);
+    producer.join();
+    InputStats stats = controllers.get_stats();
+    delete emulator;
+    delete mapper;
+
+    std::cout << "scripted: " << events.size() << " events over " << frames << " frames, " << queued_seconds / frames * 1e3
+              << " ms per frame; late " << queued.stats.late_events << " up front, " << threaded.stats.late_events
+              << " threaded" << std::endl;
+    std::cout << "paced:    " << stats.events << " events over " << paced_frames << " frames, " << stats.dropped_events << " dropped, "
+              << stats.measured_events << " read" << std::endl;
+    if (stats.measured_events > 0) {
+        std::cout << "latency:  " << stats.total_latency_seconds / stats.measured_events * 1e3 << " ms average, "
+                  << stats.worst_latency_seconds * 1e3 << " ms worst, from the press to the game's first read" << std::endl;
+    }
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (hash " << std::hex << direct.frame_hash << std::dec << ")"
+              << std::endl;
+    return identical ? 0 : 1;
+}
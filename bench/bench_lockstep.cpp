@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <iostream>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../batch/batch_runner.h"
+#include "../batch/lockstep_runner.h"
+
+namespace {
+
+unsigned long long int state_hash(Emulator &emulator) {
+    unsigned long long int hash = hash_bytes(emulator.get_ppu().get_frame_buffer(), 256 * 240 * 2);
+    CPURegisters registers = emulator.get_cpu().get_registers();
+    unsigned char bytes[7] = {registers.A, registers.X, registers.Y, registers.SP, registers.STATUS,
+                              (unsigned char) registers.PC, (unsigned char) (registers.PC >> 8)};
+    hash = hash_bytes(bytes, sizeof(bytes), hash);
+    return hash_bytes(&registers.cycles, sizeof(registers.cycles), hash);
+}
+
+struct LockstepRun {
+    double fps;
+    bool identical;
+    LockstepStats stats;
+};
+
+LockstepRun run_lockstep(Mapper *cartridge, int instances, int frames, int threads, bool simd, unsigned long long int expected) {
+    LockstepRunner runner(cartridge, instances, threads);
+    runner.set_simd(simd);
+    runner.run_frames(frames - 1);
+    runner.run_frames(1, true);
+    LockstepRun run;
+    run.stats = runner.get_stats();
+    run.fps = run.stats.fps;
+    run.identical = true;
+    for (int n = 0; n < instances; n++) {
+        if (state_hash(runner.get_instance(n)) != expected) run.identical = false;
+    }
+    return run;
+}
+
+}
+
+// Runs the same instances with the scalar batch runner and with the lockstep runner, with
+// its operations built for the baseline instruction set and for the best one the CPU has,
+// all on the same number of threads. Every instance must end up as it does running alone.
+int bench_lockstep(int argc, char **argv) {
+    int instances = argc >= 1 ? std::atoi(argv[0]) : 16;
+    int frames = argc >= 2 ? std::atoi(argv[1]) : 300;
+    int threads = argc >= 3 ? std::atoi(argv[2]) : 1;
+    Mapper *cartridge = bench_rom(argc >= 4 ? argv[3] : nullptr);
+    if (instances < 1) instances = 1;
+    if (frames < 1) frames = 1;
+    if (threads < 1) threads = 1;
+
+    BatchRunner batch(cartridge, instances, threads);
+    batch.run_frames(frames - 1);
+    batch.run_frames(1, true);
+    BatchStats batch_stats = batch.get_stats();
+    unsigned long long int expected = state_hash(batch.get_instance(0));
+    bool identical = true;
+    for (int n = 1; n < instances; n++) {
+        if (state_hash(batch.get_instance(n)) != expected) identical = false;
+    }
+
+    LockstepRun baseline = run_lockstep(cartridge, instances, frames, threads, false, expected);
+    LockstepRunner probe(cartridge, 1, 1);
+    LockstepRun vector = run_lockstep(cartridge, instances, frames, threads, true, expected);
+    identical = identical and baseline.identical and vector.identical;
+
+    LockstepStats &stats = vector.stats;
+    unsigned long long int lane_instructions = stats.lockstep_lane_instructions + stats.scalar_instructions;
+    std::cout << instances << " instances, " << frames << " frames each, " << threads << " threads" << std::endl;
+    std::cout << "scalar batch:       " << batch_stats.fps << " instance-frames/s" << std::endl;
+    std::cout << "lockstep baseline:  " << baseline.fps << " instance-frames/s, " << baseline.fps / batch_stats.fps << "x" << std::endl;
+    std::cout << "lockstep " << probe.get_simd_name() << ": " << vector.fps << " instance-frames/s, "
+              << vector.fps / batch_stats.fps << "x" << std::endl;
+    std::cout << "lockstep share:     " << 100.0 * stats.lockstep_lane_instructions / lane_instructions << "% of "
+              << lane_instructions << " lane instructions, " << (double) stats.lockstep_lane_instructions / stats.lockstep_instructions
+              << " lanes per lockstep instruction" << std::endl;
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (hash " << std::hex << expected << std::dec << ")"
+              << std::endl;
+    delete cartridge;
+    return identical ? 0 : 1;
+}
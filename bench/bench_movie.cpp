@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../movie/movie.h"
+
+namespace {
+
+struct Playback {
+    MovieStats stats;
+    double seconds;
+    std::vector<unsigned char> end_state;
+};
+
+Playback play(const char *path, Mapper *cartridge) {
+    Mapper *copy = cartridge->copy();
+    Emulator *emulator = new Emulator(copy);
+    emulator->get_apu().set_sound(false);
+    Playback playback;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        MoviePlayer player(path, emulator);
+        while (player.run_frame(false)) {}
+        playback.stats = player.get_stats();
+    }
+    playback.seconds = seconds_since(start);
+    playback.end_state.resize(emulator->get_state_size());
+    emulator->save_state(playback.end_state.data(), playback.end_state.size());
+    delete emulator;
+    delete copy;
+    return playback;
+}
+
+}
+
+// Records a movie of buttons changing every few frames, after the boot, and reports what
+// recording adds to a frame. Then plays it back runs times, streaming from the file, each
+// run checking every state hash and ending where the recording did. Last, one button of
+// the file is changed, and playback must stop on the first state hash after it.
+int bench_movie(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 3600;
+    int runs = argc >= 2 ? std::atoi(argv[1]) : 10;
+    unsigned int interval = argc >= 3 ? std::atoi(argv[2]) : 60;
+    const char *rom = argc >= 4 ? argv[3] : nullptr;
+    const char *path = "bench_movie.bnm";
+    if (frames < 1) frames = 1;
+    if (runs < 1) runs = 1;
+    if (interval < 1) interval = 1;
+
+    Mapper *cartridge = bench_rom(rom, true);
+    Emulator *emulator = new Emulator(cartridge->copy());
+    emulator->get_apu().set_sound(false);
+    emulator->reset();
+    for (int i = 0; i < 30; i++) emulator->run_frame(false);
+    std::vector<unsigned char> start_state(emulator->get_state_size());
+    emulator->save_state(start_state.data(), start_state.size());
+    ControllerPorts &controllers = emulator->get_controllers();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        if (i % 5 == 0) controllers.push_event({0, 0, (unsigned char) (i / 5 % 2), (unsigned char) (i * 13)});
+        emulator->run_frame(false);
+    }
+    double plain_seconds = seconds_since(start);
+
+    emulator->load_state(start_state.data(), start_state.size());
+    MovieStats recorded;
+    start = std::chrono::steady_clock::now();
+    {
+        MovieRecorder recorder(path, emulator, interval);
+        for (int i = 0; i < frames; i++) {
+            if (i % 5 == 0) controllers.push_event({0, 0, (unsigned char) (i / 5 % 2), (unsigned char) (i * 13)});
+            recorder.run_frame(false);
+        }
+        recorder.flush();
+        recorded = recorder.get_stats();
+    }
+    double record_seconds = seconds_since(start);
+    std::vector<unsigned char> expected(emulator->get_state_size());
+    emulator->save_state(expected.data(), expected.size());
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    unsigned long long int file_size = file.tellg();
+    file.close();
+
+    bool identical = true;
+    double play_seconds = 0;
+    Playback playback;
+    for (int i = 0; i < runs; i++) {
+        playback = play(path, cartridge);
+        play_seconds += playback.seconds;
+        if (playback.stats.desync_frame >= 0 or playback.stats.frames != (unsigned long long int) frames) identical = false;
+        if (playback.end_state != expected) identical = false;
+    }
+
+    // The buttons of port 0 in the middle of the movie
+    int changed_frame = frames / 2;
+    unsigned long long int offset = 24 + start_state.size() + changed_frame * 2 + changed_frame / interval * 8;
+    std::fstream edit(path, std::ios::binary | std::ios::in | std::ios::out);
+    edit.seekg(offset);
+    char buttons = edit.get();
+    edit.seekp(offset);
+    edit.put(buttons ^ 0xFF);
+    edit.close();
+    Playback tampered = play(path, cartridge);
+    std::remove(path);
+    long long int caught = tampered.stats.desync_frame;
+    // A movie too short to have a hash after the change cannot catch it
+    bool hashed = (changed_frame / interval + 1) * interval <= (unsigned int) frames;
+    bool detected = hashed ? caught >= changed_frame and caught < changed_frame + (int) interval : caught == -1;
+
+    std::cout << frames << " frames, a state hash every " << interval << std::endl;
+    std::cout << "record:   " << record_seconds / frames * 1e6 << " us per frame, against " << plain_seconds / frames * 1e6
+              << " us unrecorded; of it hashing " << recorded.hash_seconds / frames * 1e6 << " us, the file "
+              << recorded.file_seconds / frames * 1e6 << " us" << std::endl;
+    std::cout << "movie:    " << file_size << " bytes, " << start_state.size() << " of them the start state, "
+              << (double) (file_size - start_state.size() - 24) / frames << " per frame" << std::endl;
+    std::cout << "playback: " << runs << " runs at " << play_seconds / runs * 1e3 << " ms, " << playback.stats.hashes
+              << " hashes checked per run, " << playback.stats.file_seconds * 1e3 << " ms reading" << std::endl;
+    std::cout << "desync:   buttons changed in frame " << changed_frame << ", caught at frame " << caught << std::endl;
+    std::cout << "results:  " << (identical and detected ? "identical" : "DIFFERENT") << std::endl;
+    delete emulator;
+    delete cartridge;
+    return identical and detected ? 0 : 1;
+}
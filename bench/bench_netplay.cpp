@@ -0,0 +1,137 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../netplay/rollback_session.h"
+
+namespace {
+
+// An NTSC frame
+const std::chrono::duration<double> FRAME_TIME(1.0 / 60.0988);
+
+// What player port presses in frame frame, changing every few frames.
+unsigned char script(int port, unsigned long long int frame) {
+    return (unsigned char) (frame / (5 + 2 * port) * (37 + 64 * port));
+}
+
+struct Player {
+    Mapper *cartridge;
+    Emulator *emulator;
+    UdpSocket *socket;
+    NetplayLink *link;
+    RollbackSession *session;
+    std::vector<unsigned char> end_state;
+};
+
+// Paced at 60 Hz until frames have run, then polls until every input of both players is
+// in, so both end on the same confirmed frames.
+void play(Player &player, int port, int frames, std::chrono::steady_clock::time_point start, std::atomic<int> &confirmed) {
+    RollbackSession &session = *player.session;
+    for (int tick = 0; session.get_frame() < (unsigned long long int) frames; tick++) {
+        session.run_frame(script(port, session.get_frame()));
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(FRAME_TIME * (tick + 1)));
+    }
+    bool counted = false;
+    while (confirmed.load() < 2) {
+        session.poll();
+        if (!counted and session.get_confirmed_frame() == (unsigned long long int) frames) {
+            confirmed++;
+            counted = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Let the other player's last acknowledgements out
+    for (int i = 0; i < 50; i++) {
+        session.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    player.end_state.resize(player.emulator->get_state_size());
+    player.emulator->save_state(player.end_state.data(), player.end_state.size());
+}
+
+}
+
+// Two players, each on its own thread, emulator and UDP socket, play over loopback with
+// latency, jitter and loss added to every packet. Both must end in the state a single
+// emulator reaches with the true inputs of both players, after rolling back wherever a
+// prediction was wrong. Reports how deep the rollbacks went and what running the frames
+// again cost.
+int bench_netplay(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 300;
+    double latency = argc >= 2 ? std::atof(argv[1]) / 1000 : 0.03;
+    double jitter = argc >= 3 ? std::atof(argv[2]) / 1000 : 0.01;
+    double loss = argc >= 4 ? std::atof(argv[3]) / 100 : 0.02;
+    int delay = argc >= 5 ? std::atoi(argv[4]) : 1;
+    const char *rom = argc >= 6 ? argv[5] : nullptr;
+    if (frames < 1) frames = 1;
+
+    Mapper *cartridge = bench_rom(rom, true);
+    Emulator *reference = new Emulator(cartridge);
+    reference->get_apu().set_sound(false);
+    reference->reset();
+    for (int i = 0; i < 30; i++) reference->run_frame(false);
+    std::vector<unsigned char> start_state(reference->get_state_size());
+    reference->save_state(start_state.data(), start_state.size());
+
+    Player players[2];
+    for (int port = 0; port < 2; port++) {
+        Player &player = players[port];
+        player.cartridge = cartridge->copy();
+        player.emulator = new Emulator(player.cartridge);
+        player.emulator->get_apu().set_sound(false);
+        player.emulator->load_state(start_state.data(), start_state.size());
+        player.socket = new UdpSocket();
+        player.link = new NetplayLink(player.socket, port + 1);
+        player.link->set_conditions({latency, jitter, loss});
+    }
+    for (int port = 0; port < 2; port++) {
+        Player &player = players[port];
+        player.socket->set_peer("127.0.0.1", players[1 - port].socket->get_port());
+        player.session = new RollbackSession(player.emulator, player.link, port, delay);
+    }
+    std::atomic<int> confirmed(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread first(play, std::ref(players[0]), 0, frames, start, std::ref(confirmed));
+    std::thread second(play, std::ref(players[1]), 1, frames, start, std::ref(confirmed));
+    first.join();
+    second.join();
+
+    for (int i = 0; i < frames; i++) {
+        for (int port = 0; port < 2; port++) reference->get_controllers().set_buttons(port, i >= delay ? script(port, i - delay) : 0);
+        reference->run_frame(false);
+    }
+    std::vector<unsigned char> expected(reference->get_state_size());
+    reference->save_state(expected.data(), expected.size());
+
+    std::cout << frames << " frames, " << latency * 1e3 << " ms latency, " << jitter * 1e3 << " ms jitter, " << loss * 100
+              << "% loss, " << delay << " frame input delay" << std::endl;
+    bool identical = true;
+    for (int port = 0; port < 2; port++) {
+        Player &player = players[port];
+        RollbackStats stats = player.session->get_stats();
+        identical = identical and player.end_state == expected and stats.desync_frame < 0;
+        double rollbacks = stats.rollbacks > 0 ? stats.rollbacks : 1;
+        std::cout << "player " << port + 1 << ": " << stats.rollbacks << " rollbacks, " << stats.rolled_back_frames / rollbacks
+                  << " frames deep on average, " << stats.worst_depth << " at worst; " << stats.stalls << " stalls" << std::endl;
+        std::cout << "          resimulation " << stats.resimulation_seconds / rollbacks * 1e3 << " ms per rollback, "
+                  << stats.worst_resimulation_seconds * 1e3 << " ms at worst, " << stats.resimulation_seconds / stats.frames * 1e3
+                  << " ms per frame; saving " << stats.save_seconds / stats.frames * 1e6 << " us per frame" << std::endl;
+        std::cout << "          " << stats.packets_sent << " packets sent, " << stats.packets_received << " received, "
+                  << stats.hashes_checked << " state hashes checked" << (stats.desync_frame >= 0 ? ", DESYNC" : "") << std::endl;
+    }
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << std::endl;
+
+    for (Player &player : players) {
+        delete player.session;
+        delete player.link;
+        delete player.socket;
+        delete player.emulator;
+        delete player.cartridge;
+    }
+    delete reference;
+    delete cartridge;
+    return identical ? 0 : 1;
+}
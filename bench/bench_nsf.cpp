@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../nsf/nsf.h"
+
+namespace {
+
+// Renders seconds of a track and returns the hash of the samples.
+unsigned long long int render(const std::vector<unsigned char> &image, int track, double seconds) {
+    const int sample_rate = 48000;
+    NSFPlayer player(image, sample_rate);
+    player.start_track(track);
+    std::vector<short int> samples(sample_rate / 10);
+    unsigned long long int hash = hash_bytes(nullptr, 0);
+    long long int remaining = (long long int) (seconds * sample_rate);
+    while (remaining > 0) {
+        int count = remaining < (long long int) samples.size() ? remaining : samples.size();
+        player.render(samples.data(), count);
+        hash = hash_bytes(samples.data(), count * sizeof(short int), hash);
+        remaining -= count;
+    }
+    return hash;
+}
+
+}
+
+// Renders the tracks of an NSF file, one after the other and then one per thread, and
+// checks that each track comes out the same both ways.
+int bench_nsf(int argc, char **argv) {
+    double seconds = argc >= 1 ? std::atof(argv[0]) : 60;
+    int threads = argc >= 2 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    std::vector<unsigned char> image = argc >= 3 ? nsf_read(argv[2]) : synthetic_nsf();
+    if (threads < 1) threads = 1;
+    int tracks = nsf_parse(image).songs;
+
+    std::vector<unsigned long long int> serial_hashes(tracks);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int track = 0; track < tracks; track++) serial_hashes[track] = render(image, track, seconds);
+    double serial_seconds = seconds_since(start);
+
+    std::vector<unsigned long long int> parallel_hashes(tracks);
+    start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            for (int track = t; track < tracks; track += threads) parallel_hashes[track] = render(image, track, seconds);
+        }));
+    }
+    for (std::thread &worker : workers) worker.join();
+    double parallel_seconds = seconds_since(start);
+
+    bool identical = serial_hashes == parallel_hashes;
+    double audio = tracks * seconds;
+    std::cout << "tracks:   " << tracks << " of " << seconds << " s" << std::endl;
+    std::cout << "serial:   " << serial_seconds << " s, " << audio / serial_seconds << "x real time" << std::endl;
+    std::cout << "parallel: " << parallel_seconds << " s on " << threads << " threads, " << audio / parallel_seconds
+              << "x real time" << std::endl;
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (hash " << std::hex
+              << hash_bytes(serial_hashes.data(), tracks * sizeof(unsigned long long int)) << std::dec << ")" << std::endl;
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../emulator/emulator.h"
+
+namespace {
+
+struct SyncRun {
+    double seconds;
+    unsigned long long int hash;
+    unsigned long long int catch_ups;
+    unsigned long long int fast_lines;
+    unsigned long long int slow_lines;
+    // $2002 reads of the lockstep run whose predicted flags were not the drawn ones
+    unsigned long long int flag_mismatches;
+};
+
+SyncRun run_sync_mode(SyncMode mode, int frames, const char *rom) {
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->set_sync_mode(mode);
+    emulator->reset();
+
+    SyncRun run;
+    run.hash = hash_bytes(nullptr, 0);
+    run.fast_lines = 0;
+    run.slow_lines = 0;
+    short int samples[4096];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        emulator->run_frame();
+        run.hash = hash_bytes(emulator->get_ppu().get_frame_buffer(), 256 * 240 * 2, run.hash);
+        int count = emulator->get_apu().read_samples(samples, 4096);
+        run.hash = hash_bytes(samples, count * sizeof(short int), run.hash);
+        LineStats lines = emulator->get_ppu().get_line_stats();
+        run.fast_lines += lines.fast_lines;
+        run.slow_lines += lines.slow_lines;
+    }
+    run.seconds = seconds_since(start);
+    CPU &cpu = emulator->get_cpu();
+    unsigned char registers[6] = {cpu.get_A(), cpu.get_X(), cpu.get_Y(), cpu.get_SP(), cpu.get_STATUS(), (unsigned char) cpu.get_PC()};
+    run.hash = hash_bytes(registers, sizeof(registers), run.hash);
+    unsigned long long int cycles = cpu.get_cycles();
+    run.hash = hash_bytes(&cycles, sizeof(cycles), run.hash);
+    run.catch_ups = emulator->get_ppu().get_catch_ups();
+    run.flag_mismatches = emulator->get_ppu().get_flag_mismatches();
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Runs the same frames with the PPU and APU in lockstep and in lazy catch-up mode and
+// checks that every frame buffer, every audio sample and the final CPU state are identical.
+// Lockstep takes sprite 0 hit and overflow from the pixels drawn, and counts every $2002
+// read where the lazy mode's prediction of them would have answered differently.
+int bench_ppu_sync(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    const char *rom = argc >= 2 ? argv[1] : nullptr;
+
+    SyncRun lockstep = run_sync_mode(SYNC_LOCKSTEP, frames, rom);
+    SyncRun lazy = run_sync_mode(SYNC_LAZY, frames, rom);
+
+    std::cout << "lockstep: " << frames / lockstep.seconds << " fps" << std::endl;
+    std::cout << "lazy:     " << frames / lazy.seconds << " fps, " << lazy.catch_ups << " catch-ups ("
+              << (double) lazy.catch_ups / frames << " per frame)" << std::endl;
+    std::cout << "lines:    " << (double) lazy.fast_lines / frames << " fast, " << (double) lazy.slow_lines / frames
+              << " dot-accurate per frame" << std::endl;
+    std::cout << "speedup:  " << lockstep.seconds / lazy.seconds << "x" << std::endl;
+    std::cout << "flags:    " << lockstep.flag_mismatches << " mispredicted $2002 reads" << std::endl;
+    bool identical = lockstep.hash == lazy.hash and lockstep.flag_mismatches == 0;
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (hash " << std::hex << lazy.hash << std::dec << ")"
+              << std::endl;
+    return identical ? 0 : 1;
+}
+
+namespace {
+
+struct RenderRun {
+    double seconds;
+    // CPU registers, cycles and RAM after every frame
+    unsigned long long int state_hash;
+    // Frame buffers of the frames that were rendered by every run
+    unsigned long long int frame_hash;
+};
+
+// Renders one frame in every render_every, or none when render_every is 0.
+RenderRun run_render_mode(int render_every, int frames, const char *rom) {
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+
+    RenderRun run;
+    run.state_hash = hash_bytes(nullptr, 0);
+    run.frame_hash = hash_bytes(nullptr, 0);
+    unsigned char ram[0x800];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        bool render = render_every != 0 and i % render_every == 0;
+        emulator->run_frame(render);
+        CPU &cpu = emulator->get_cpu();
+        unsigned char registers[6] = {cpu.get_A(), cpu.get_X(), cpu.get_Y(), cpu.get_SP(), cpu.get_STATUS(), (unsigned char) cpu.get_PC()};
+        unsigned long long int cycles = cpu.get_cycles();
+        for (int address = 0; address < 0x800; address++) ram[address] = mapper->cpu_mem(address);
+        run.state_hash = hash_bytes(registers, sizeof(registers), run.state_hash);
+        run.state_hash = hash_bytes(&cycles, sizeof(cycles), run.state_hash);
+        run.state_hash = hash_bytes(ram, sizeof(ram), run.state_hash);
+        // Frames 0, 12, 24... are rendered by both the full and the frame-skip run
+        if (i % 12 == 0 and render) {
+            run.frame_hash = hash_bytes(emulator->get_ppu().get_frame_buffer(), 256 * 240 * 2, run.frame_hash);
+        }
+    }
+    run.seconds = seconds_since(start);
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Runs the same frames fully rendered, rendering one frame in 4 and fully headless, and
+// checks the CPU side of the emulation never notices the difference.
+int bench_headless(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    const char *rom = argc >= 2 ? argv[1] : nullptr;
+
+    RenderRun full = run_render_mode(1, frames, rom);
+    RenderRun skip = run_render_mode(4, frames, rom);
+    RenderRun headless = run_render_mode(0, frames, rom);
+
+    bool same_state = full.state_hash == skip.state_hash and full.state_hash == headless.state_hash;
+    bool same_frames = full.frame_hash == skip.frame_hash;
+    std::cout << "rendered:   " << frames / full.seconds << " fps" << std::endl;
+    std::cout << "frame-skip: " << frames / skip.seconds << " fps (1 frame in 4 rendered), speedup "
+              << full.seconds / skip.seconds << "x" << std::endl;
+    std::cout << "headless:   " << frames / headless.seconds << " fps, speedup " << full.seconds / headless.seconds << "x" << std::endl;
+    std::cout << "state:      " << (same_state ? "identical" : "DIFFERENT") << std::endl;
+    std::cout << "frames:     " << (same_frames ? "identical" : "DIFFERENT") << std::endl;
+    return same_state and same_frames ? 0 : 1;
+}
+
+namespace {
+
+struct DeferredRun {
+    double seconds;
+    unsigned long long int hash;
+};
+
+DeferredRun run_deferred_mode(bool deferred, int frames, const char *rom) {
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    emulator->set_deferred_rendering(deferred);
+
+    DeferredRun run;
+    run.hash = hash_bytes(nullptr, 0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        emulator->run_frame();
+        // Deferred frames come out one run_frame() late
+        if (!deferred or i > 0) run.hash = hash_bytes(emulator->get_frame_buffer(), 256 * 240 * 2, run.hash);
+    }
+    if (deferred) {
+        emulator->finish_rendering();
+        run.hash = hash_bytes(emulator->get_frame_buffer(), 256 * 240 * 2, run.hash);
+    }
+    run.seconds = seconds_since(start);
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Runs the same frames drawn in line and drawn on a worker thread from the access log,
+// and checks every frame comes out the same.
+int bench_deferred(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    const char *rom = argc >= 2 ? argv[1] : nullptr;
+
+    DeferredRun synchronous = run_deferred_mode(false, frames, rom);
+    DeferredRun deferred = run_deferred_mode(true, frames, rom);
+
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "synchronous: " << frames / synchronous.seconds << " fps" << std::endl;
+    std::cout << "deferred:    " << frames / deferred.seconds << " fps, speedup " << synchronous.seconds / deferred.seconds
+              << "x" << std::endl;
+    std::cout << "frames:      " << (synchronous.hash == deferred.hash ? "identical" : "DIFFERENT") << std::endl;
+    return synchronous.hash == deferred.hash ? 0 : 1;
+}
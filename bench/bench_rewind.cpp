@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../rewind/rewind_buffer.h"
+
+// Pushes every frame into a rewind buffer, reporting what that costs the emulation thread
+// and the worker and how far the memory cap reaches back, then rewinds as far as it can.
+// Every 60 frames the state on the way back must equal the one saved on the way forward,
+// and running forward again from the oldest frame must end in the same state.
+int bench_rewind(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 1200;
+    int cap_mb = argc >= 2 ? std::atoi(argv[1]) : 16;
+    Mapper *mapper = bench_rom(argc >= 3 ? argv[2] : nullptr);
+    if (frames < 1) frames = 1;
+    if (cap_mb < 1) cap_mb = 1;
+
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    RewindBuffer rewind(emulator, cap_mb << 20);
+    unsigned int size = emulator->get_state_size();
+    std::vector<std::vector<unsigned char>> references((frames + 59) / 60);
+    std::vector<unsigned char> state(size);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        emulator->run_frame(false);
+        rewind.push();
+        if (i % 60 == 0) {
+            references[i / 60].resize(size);
+            emulator->save_state(references[i / 60].data(), size);
+        }
+    }
+    rewind.finish();
+    double forward_seconds = seconds_since(start);
+    std::vector<unsigned char> final_state(size);
+    emulator->save_state(final_state.data(), size);
+    RewindStats stats = rewind.get_stats();
+
+    int frame = frames - 1;
+    bool identical = true;
+    int checked = 0;
+    start = std::chrono::steady_clock::now();
+    while (rewind.step_back()) {
+        frame--;
+        if (frame % 60 == 0) {
+            emulator->save_state(state.data(), size);
+            if (state != references[frame / 60]) identical = false;
+            checked++;
+        }
+    }
+    double back_seconds = seconds_since(start);
+    int stepped = frames - 1 - frame;
+    for (int i = frame; i < frames - 1; i++) emulator->run_frame(false);
+    emulator->save_state(state.data(), size);
+    if (state != final_state) identical = false;
+
+    std::cout << frames << " frames, " << cap_mb << " MB cap, " << size << " byte states" << std::endl;
+    std::cout << "held:     " << stats.frames << " frames in " << stats.compressed_bytes << " bytes, "
+              << (double) stats.raw_bytes / stats.compressed_bytes << "x smaller than full states, "
+              << (double) stats.compressed_bytes / stats.frames << " bytes per frame" << std::endl;
+    std::cout << "push:     " << stats.push_seconds / frames * 1e6 << " us per frame on the emulation thread, "
+              << stats.stalls << " stalls" << std::endl;
+    std::cout << "compress: " << stats.compress_seconds / frames * 1e6 << " us per frame on the worker" << std::endl;
+    std::cout << "rewind:   " << stepped << " frames back at " << back_seconds / stepped * 1e6 << " us per frame, "
+              << stepped / back_seconds / (frames / forward_seconds) << "x the speed frames ran forward" << std::endl;
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (" << checked << " states checked on the way back)"
+              << std::endl;
+    delete emulator;
+    delete mapper;
+    return identical ? 0 : 1;
+}
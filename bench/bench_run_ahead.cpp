@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../runahead/run_ahead.h"
+
+namespace {
+
+// An NTSC frame
+const double FRAME_BUDGET = 1.0 / 60.0988;
+
+struct AheadRun {
+    RunAheadStats stats;
+    unsigned long long int frame_hash;
+    unsigned long long int audio_hash;
+    std::vector<unsigned char> end_state;
+};
+
+AheadRun run_ahead(const char *rom, int frames, int ahead) {
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    RunAhead runner(emulator, ahead);
+    AheadRun run;
+    run.audio_hash = hash_bytes(nullptr, 0);
+    short int samples[4096];
+    for (int i = 0; i < frames; i++) {
+        runner.run_frame();
+        int count = emulator->get_apu().read_samples(samples, 4096);
+        run.audio_hash = hash_bytes(samples, count * sizeof(short int), run.audio_hash);
+    }
+    run.stats = runner.get_stats();
+    run.frame_hash = hash_bytes(runner.get_frame_buffer(), 256 * 240 * 2);
+    run.end_state.resize(emulator->get_state_size());
+    emulator->save_state(run.end_state.data(), run.end_state.size());
+    delete emulator;
+    delete mapper;
+    return run;
+}
+
+}
+
+// Runs the same frames with 0 up to max_ahead frames of run-ahead and reports the cost of
+// a frame against the 16.6 ms of an NTSC frame. Whatever the run-ahead, the emulation and
+// its sound must come out as without, and the picture shown last must be the one a plain
+// run shows that many frames later.
+int bench_run_ahead(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    int max_ahead = argc >= 2 ? std::atoi(argv[1]) : 2;
+    const char *rom = argc >= 3 ? argv[2] : nullptr;
+    if (frames < 1) frames = 1;
+    if (max_ahead < 0) max_ahead = 0;
+
+    AheadRun plain = run_ahead(rom, frames, 0);
+    std::vector<unsigned long long int> later_frames;
+    for (int ahead = 0; ahead <= max_ahead; ahead++) later_frames.push_back(run_ahead(rom, frames + ahead, 0).frame_hash);
+
+    std::cout << frames << " frames" << std::endl;
+    bool identical = true;
+    for (int ahead = 0; ahead <= max_ahead; ahead++) {
+        AheadRun run = ahead == 0 ? plain : run_ahead(rom, frames, ahead);
+        bool same = run.end_state == plain.end_state and run.audio_hash == plain.audio_hash and run.frame_hash == later_frames[ahead];
+        identical = identical and same;
+        RunAheadStats &stats = run.stats;
+        double average = (stats.real_seconds + stats.ahead_seconds + stats.state_seconds) / stats.frames;
+        std::cout << "ahead " << ahead << ": " << average * 1e3 << " ms per frame (" << 100 * average / FRAME_BUDGET
+                  << "% of a frame), worst " << stats.worst_frame_seconds * 1e3 << " ms; real " << stats.real_seconds / stats.frames * 1e3
+                  << " ms, ahead " << stats.ahead_seconds / stats.frames * 1e3 << " ms, state " << stats.state_seconds / stats.frames * 1e6
+                  << " us" << (same ? "" : "  DIFFERENT") << std::endl;
+    }
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << " (hash " << std::hex << plain.audio_hash << std::dec << ")"
+              << std::endl;
+    return identical ? 0 : 1;
+}
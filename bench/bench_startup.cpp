@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../emulator/emulator.h"
+
+// Reports how many CPUs, and how many whole emulators with their own cartridge copy, can
+// be created and destroyed per second. A CPU shares its opcode table with every other one
+// and allocates nothing. Two emulators created one after the other must run alike.
+int bench_startup(int argc, char **argv) {
+    int instances = argc >= 1 ? std::atoi(argv[0]) : 2000;
+    Mapper *cartridge = bench_rom(argc >= 2 ? argv[1] : nullptr);
+    if (instances < 1) instances = 1;
+
+    int cpus = instances * 100;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cpus; i++) {
+        CPU *cpu = new CPU(cartridge);
+        cpu->reset();
+        delete cpu;
+    }
+    double cpu_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < instances; i++) {
+        Mapper *copy = cartridge->copy();
+        Emulator *emulator = new Emulator(copy);
+        emulator->reset();
+        delete emulator;
+        delete copy;
+    }
+    double emulator_seconds = seconds_since(start);
+
+    std::vector<unsigned char> expected;
+    bool identical = true;
+    for (int i = 0; i < 2; i++) {
+        Mapper *copy = cartridge->copy();
+        Emulator *emulator = new Emulator(copy);
+        emulator->reset();
+        std::vector<unsigned char> state = state_after(*emulator, 60);
+        if (i == 0) expected = state;
+        else if (state != expected) identical = false;
+        delete emulator;
+        delete copy;
+    }
+
+    std::cout << "cpu:      " << cpus / cpu_seconds << " instances/s, " << cpu_seconds / cpus * 1e9 << " ns each" << std::endl;
+    std::cout << "emulator: " << instances / emulator_seconds << " instances/s, " << emulator_seconds / instances * 1e6
+              << " us each" << std::endl;
+    std::cout << "results:  " << (identical ? "identical" : "DIFFERENT") << std::endl;
+    delete cartridge;
+    return identical ? 0 : 1;
+}
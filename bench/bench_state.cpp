@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../emulator/emulator.h"
+#include "../state/state.h"
+
+namespace {
+
+unsigned long long int cpu_hash(Emulator &emulator, unsigned long long int hash) {
+    CPURegisters registers = emulator.get_cpu().get_registers();
+    unsigned char bytes[7] = {registers.A, registers.X, registers.Y, registers.SP, registers.STATUS,
+                              (unsigned char) registers.PC, (unsigned char) (registers.PC >> 8)};
+    hash = hash_bytes(bytes, sizeof(bytes), hash);
+    return hash_bytes(&registers.cycles, sizeof(registers.cycles), hash);
+}
+
+// Runs frames rendered frames and returns the hash of every one along with the state at
+// the end. The frame buffer is not part of a state, so the first frame, which may have
+// started before the state was saved, only counts with the CPU.
+unsigned long long int run_from(Emulator &emulator, int frames, std::vector<unsigned char> &end_state) {
+    unsigned long long int hash = hash_bytes(nullptr, 0);
+    for (int i = 0; i < frames; i++) {
+        emulator.run_frame(true);
+        if (i > 0) hash = hash_bytes(emulator.get_ppu().get_frame_buffer(), 256 * 240 * 2, hash);
+        hash = cpu_hash(emulator, hash);
+    }
+    emulator.save_state(end_state.data(), end_state.size());
+    return hash;
+}
+
+}
+
+// Saves a state after every frame and loads it back the way rewind and run-ahead would,
+// reporting the size and the cost of each. Then checks that a loaded state, also one that
+// went through a file, runs on exactly as the emulator it was saved from did: same frames,
+// same CPU and the same state at the end.
+int bench_state(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 600;
+    Mapper *mapper = bench_rom(argc >= 2 ? argv[1] : nullptr);
+    const char *path = argc >= 3 ? argv[2] : "bench_state.bnst";
+    if (frames < 2) frames = 2;
+
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    unsigned int size = emulator->get_state_size();
+    std::vector<unsigned char> state(size);
+    std::vector<unsigned char> other(size);
+
+    double save_seconds = 0;
+    double load_seconds = 0;
+    for (int i = 0; i < frames; i++) {
+        emulator->run_frame(false);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        emulator->save_state(state.data(), size);
+        save_seconds += seconds_since(start);
+        start = std::chrono::steady_clock::now();
+        emulator->load_state(state.data(), size);
+        load_seconds += seconds_since(start);
+    }
+
+    // The middle of a frame, with the PPU and the APU behind the CPU, is saved as well
+    emulator->run_cycles(10000);
+    emulator->save_state(state.data(), size);
+    int check_frames = frames / 2;
+    std::vector<unsigned char> expected_end(size);
+    std::vector<unsigned char> end(size);
+    unsigned long long int expected = run_from(*emulator, check_frames, expected_end);
+    emulator->load_state(state.data(), size);
+    unsigned long long int reloaded = run_from(*emulator, check_frames, end);
+    bool identical = reloaded == expected and end == expected_end;
+
+    write_state_file(path, state.data(), size);
+    std::vector<unsigned char> from_file = read_state_file(path);
+    std::remove(path);
+    Mapper *fresh_mapper = bench_rom(argc >= 2 ? argv[1] : nullptr);
+    Emulator *fresh = new Emulator(fresh_mapper);
+    fresh->reset();
+    fresh->load_state(from_file.data(), from_file.size());
+    fresh->save_state(other.data(), size);
+    bool file_identical = other == state;
+    unsigned long long int from_disk = run_from(*fresh, check_frames, end);
+    file_identical = file_identical and from_disk == expected and end == expected_end;
+
+    std::cout << "state size: " << size << " bytes" << std::endl;
+    std::cout << "save:       " << save_seconds / frames * 1e6 << " us" << std::endl;
+    std::cout << "load:       " << load_seconds / frames * 1e6 << " us" << std::endl;
+    std::cout << "results:    " << (identical ? "identical" : "DIFFERENT") << " after a load, "
+              << (file_identical ? "identical" : "DIFFERENT") << " through a file (hash " << std::hex << expected << std::dec << ")"
+              << std::endl;
+    delete fresh;
+    delete fresh_mapper;
+    delete emulator;
+    delete mapper;
+    return identical and file_identical ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "bench.h"
+#include "synthetic_rom.h"
+#include "../emulator/emulator.h"
+#include "../video/video.h"
+
+namespace {
+
+struct FormatName {
+    PixelFormat format;
+    const char *name;
+};
+
+const FormatName formats[] = {
+    {PIXEL_RGBA8888, "rgba8888"},
+    {PIXEL_BGRA8888, "bgra8888"},
+    {PIXEL_RGB565, "rgb565"},
+    {PIXEL_GRAY8, "gray8"}
+};
+
+// Converts every frame repeats times and returns the seconds taken, leaving the last
+// frame in output.
+double time_conversion(VideoOutput &video, const std::vector<unsigned short int> &frames, int repeats,
+                       std::vector<unsigned char> &output, int stride) {
+    int count = frames.size() / (256 * 240);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        for (int f = 0; f < count; f++) video.convert(&frames[f * 256 * 240], output.data(), stride);
+    }
+    return seconds_since(start);
+}
+
+}
+
+// Converts frames of the benchmark ROM to every pixel format with the scalar loop and the
+// AVX2 kernels, into a buffer with padded lines, and checks both give the same bytes.
+int bench_video(int argc, char **argv) {
+    int frames = argc >= 1 ? std::atoi(argv[0]) : 60;
+    int repeats = argc >= 2 ? std::atoi(argv[1]) : 20;
+    const char *rom = argc >= 3 ? argv[2] : nullptr;
+
+    Mapper *mapper = bench_rom(rom);
+    Emulator *emulator = new Emulator(mapper);
+    emulator->reset();
+    std::vector<unsigned short int> captured(frames * 256 * 240);
+    for (int f = 0; f < frames; f++) {
+        emulator->run_frame();
+        std::memcpy(&captured[f * 256 * 240], emulator->get_ppu().get_frame_buffer(), 256 * 240 * 2);
+    }
+    delete emulator;
+    delete mapper;
+
+    VideoOutput video;
+    if (!video.get_simd()) std::cout << "AVX2 not available, both runs use the scalar loop" << std::endl;
+    bool identical = true;
+    for (const FormatName &format : formats) {
+        video.set_format(format.format);
+        // 16 bytes of padding per line, as a texture with an aligned pitch would have
+        int stride = 256 * video.bytes_per_pixel() + 16;
+        std::vector<unsigned char> scalar_output(stride * 240, 0);
+        std::vector<unsigned char> simd_output(stride * 240, 0);
+        bool simd = video.get_simd();
+
+        video.set_simd(false);
+        double scalar_seconds = time_conversion(video, captured, repeats, scalar_output, stride);
+        video.set_simd(simd);
+        double simd_seconds = time_conversion(video, captured, repeats, simd_output, stride);
+
+        bool same = scalar_output == simd_output;
+        identical = identical and same;
+        double conversions = (double) frames * repeats;
+        std::cout << format.name << ": scalar " << scalar_seconds / conversions * 1e6 << " us/frame, simd "
+                  << simd_seconds / conversions * 1e6 << " us/frame, speedup " << scalar_seconds / simd_seconds << "x, "
+                  << (same ? "identical" : "DIFFERENT") << std::endl;
+    }
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+#include <vector>
+#include "synthetic_rom.h"
+#include "../loader/rom_loader.h"
+
+namespace {
+
+// Minimal 6502 assembler: emits bytes at $C000 and patches branch targets.
+class Assembler {
+    public:
+        std::vector<unsigned char> code;
+        unsigned short int here() {
+            return 0xC000 + code.size();
+        }
+        void op(unsigned char opcode) {
+            code.push_back(opcode);
+        }
+        void op8(unsigned char opcode, unsigned char operand) {
+            code.push_back(opcode);
+            code.push_back(operand);
+        }
+        void op16(unsigned char opcode, unsigned short int operand) {
+            code.push_back(opcode);
+            code.push_back(operand & 0xFF);
+            code.push_back(operand >> 8);
+        }
+        void branch(unsigned char opcode, unsigned short int target) {
+            code.push_back(opcode);
+            code.push_back((unsigned char) (target - (here() + 1)));
+        }
+};
+
+const unsigned char LDA_I = 0xA9, LDA_ZP = 0xA5, LDX_I = 0xA2, LDY_I = 0xA0;
+const unsigned char STA_A = 0x8D, STA_AX = 0x9D, INC_ZP = 0xE6, INC_A = 0xEE, INX = 0xE8, DEX = 0xCA, DEY = 0x88;
+const unsigned char TXA = 0x8A, TXS = 0x9A, BNE = 0xD0, BPL = 0x10, BVS = 0x70, BIT_A = 0x2C;
+const unsigned char JMP_A = 0x4C, PHA = 0x48, PLA = 0x68, RTI = 0x40, SEI = 0x78, CLD = 0xD8, CPX_I = 0xE0;
+const unsigned char CMP_ZP = 0xC5, BEQ = 0xF0, INC_AX = 0xFE;
+const unsigned char STA_ZP = 0x85, ADC_ZP = 0x65, CLC = 0x18, RTS = 0x60;
+const unsigned char LDA_A = 0xAD, LSR = 0x4A, ROL_ZP = 0x26, BCC = 0x90;
+
+}
+
+Mapper *synthetic_rom(bool controller) {
+    Assembler a;
+
+    // Reset: wait for the PPU, then upload palette and nametables
+    unsigned short int reset = a.here();
+    a.op(SEI);
+    a.op(CLD);
+    a.op8(LDX_I, 0xFF);
+    a.op(TXS);
+    a.op8(LDA_I, 0x00);
+    a.op16(STA_A, 0x2000);
+    a.op16(STA_A, 0x2001);
+    for (int i = 0; i < 2; i++) {
+        unsigned short int wait = a.here();
+        a.op16(BIT_A, 0x2002);
+        a.branch(BPL, wait);
+    }
+    a.op8(LDA_I, 0x3F);
+    a.op16(STA_A, 0x2006);
+    a.op8(LDA_I, 0x00);
+    a.op16(STA_A, 0x2006);
+    a.op8(LDX_I, 0x00);
+    unsigned short int palette_loop = a.here();
+    a.op(TXA);
+    a.op16(STA_A, 0x2007);
+    a.op(INX);
+    a.op8(CPX_I, 0x20);
+    a.branch(BNE, palette_loop);
+    a.op8(LDA_I, 0x20);
+    a.op16(STA_A, 0x2006);
+    a.op8(LDA_I, 0x00);
+    a.op16(STA_A, 0x2006);
+    a.op8(LDY_I, 0x08);
+    unsigned short int nametable_loop = a.here();
+    a.op(TXA);
+    a.op16(STA_A, 0x2007);
+    a.op(INX);
+    a.branch(BNE, nametable_loop);
+    a.op(DEY);
+    a.branch(BNE, nametable_loop);
+    // Sprites: a diagonal of 64 sprites in the DMA page, sprite 0 over the top rows
+    unsigned short int sprite_loop = a.here();
+    a.op(TXA);
+    a.op16(STA_AX, 0x0200);
+    a.op(INX);
+    a.branch(BNE, sprite_loop);
+    // Sound: all channels on, with a looping DMC sample played from the code itself
+    const unsigned short int sound_setup[][2] = {
+        {0x4017, 0x40}, {0x4000, 0xBF}, {0x4004, 0x74}, {0x4008, 0xFF}, {0x400C, 0x34},
+        {0x4010, 0x4F}, {0x4012, 0x00}, {0x4013, 0x10}, {0x4015, 0x1F}
+    };
+    for (const unsigned short int *write : sound_setup) {
+        a.op8(LDA_I, write[1]);
+        a.op16(STA_A, write[0]);
+    }
+    a.op8(LDA_I, 0x90);
+    a.op16(STA_A, 0x2000);
+    a.op8(LDA_I, 0x1E);
+    a.op16(STA_A, 0x2001);
+
+    // Main loop: wait for NMI, run some game logic, then split the screen at sprite 0
+    // (with a bounded poll, so a missed hit cannot hang the benchmark)
+    a.op8(LDA_I, 0x64);
+    a.op16(STA_A, 0x0200);
+    unsigned short int main_loop = a.here();
+    a.op8(LDA_ZP, 0x10);
+    unsigned short int wait_nmi = a.here();
+    a.op8(CMP_ZP, 0x10);
+    a.branch(BEQ, wait_nmi);
+    a.op8(LDX_I, 0x00);
+    unsigned short int logic = a.here();
+    a.op16(INC_AX, 0x0300);
+    a.op(INX);
+    a.branch(BNE, logic);
+    a.op8(LDY_I, 0x08);
+    unsigned short int poll = a.here();
+    a.op16(BIT_A, 0x2002);
+    unsigned short int poll_exit = a.here();
+    a.branch(BVS, 0);
+    a.op(DEX);
+    a.branch(BNE, poll);
+    a.op(DEY);
+    a.branch(BNE, poll);
+    a.code[poll_exit - 0xC000 + 1] = (unsigned char) (a.here() - (poll_exit + 2));
+    a.op8(LDA_ZP, 0x10);
+    a.op16(STA_A, 0x2005);
+    a.op16(STA_A, 0x2005);
+    a.op16(JMP_A, main_loop);
+
+    // NMI: sprite DMA, scroll and a few nametable writes
+    unsigned short int nmi = a.here();
+    a.op(PHA);
+    a.op8(LDA_I, 0x02);
+    a.op16(STA_A, 0x4014);
+    a.op8(INC_ZP, 0x10);
+    a.op16(INC_A, 0x0203);
+    if (controller) {
+        // Strobe, then shift the 8 buttons into $11, A ending up in bit 7. The 1 put there
+        // first comes out into the carry after the last one, leaving X to the main loop.
+        a.op8(LDA_I, 0x01);
+        a.op16(STA_A, 0x4016);
+        a.op8(STA_ZP, 0x11);
+        a.op8(LDA_I, 0x00);
+        a.op16(STA_A, 0x4016);
+        unsigned short int read_loop = a.here();
+        a.op16(LDA_A, 0x4016);
+        a.op(LSR);
+        a.op8(ROL_ZP, 0x11);
+        a.branch(BCC, read_loop);
+        // Sprite 1 moves by the buttons, so they are felt for good, as in a game
+        a.op8(LDA_ZP, 0x11);
+        a.op(CLC);
+        a.op8(ADC_ZP, 0x12);
+        a.op8(STA_ZP, 0x12);
+        a.op16(STA_A, 0x0207);
+    }
+    a.op8(LDA_I, 0x21);
+    a.op16(STA_A, 0x2006);
+    a.op8(LDA_ZP, 0x10);
+    a.op16(STA_A, 0x2006);
+    a.op16(STA_A, 0x2007);
+    a.op16(STA_A, 0x2007);
+    a.op8(LDA_ZP, 0x10);
+    a.op16(STA_A, 0x2005);
+    a.op8(LDA_I, 0x00);
+    a.op16(STA_A, 0x2005);
+    // Sound driver: notes follow the frame counter
+    a.op8(LDA_ZP, 0x10);
+    a.op16(STA_A, 0x4002);
+    a.op16(STA_A, 0x400A);
+    a.op16(STA_A, 0x400E);
+    a.op8(LDA_I, 0x09);
+    a.op16(STA_A, 0x4003);
+    a.op16(STA_A, 0x4007);
+    a.op16(STA_A, 0x400B);
+    a.op16(STA_A, 0x400F);
+    a.op16(BIT_A, 0x4015);
+    a.op(PLA);
+    a.op(RTI);
+
+    std::vector<unsigned char> prg(0x4000, 0xEA);
+    for (unsigned int i = 0; i < a.code.size(); i++) prg[i] = a.code[i];
+    prg[0x3FFA] = nmi & 0xFF;
+    prg[0x3FFB] = nmi >> 8;
+    prg[0x3FFC] = reset & 0xFF;
+    prg[0x3FFD] = reset >> 8;
+    prg[0x3FFE] = nmi & 0xFF;
+    prg[0x3FFF] = nmi >> 8;
+
+    // Pattern tables: a mix of solid, striped and checkered tiles
+    std::vector<unsigned char> chr(0x2000);
+    for (unsigned int i = 0; i < chr.size(); i++) {
+        unsigned int tile = i / 16;
+        unsigned int row = i % 8;
+        chr[i] = (unsigned char) ((tile * 37) ^ (row * 0x11) ^ ((i & 8) ? 0xFF : 0x00));
+    }
+
+    Mapper_0 *mapper = new Mapper_0();
+    mapper->set_mirroring(MIRRORING_VERTICAL);
+    mapper->load_prg(prg.data(), prg.size());
+    mapper->load_chr(chr.data(), chr.size());
+    return mapper;
+}
+
+std::vector<unsigned char> synthetic_nsf() {
+    Assembler a;
+
+    // Init: remember the track and start every channel, the DMC looping over the code
+    unsigned short int init = a.here();
+    a.op8(STA_ZP, 0x00);
+    const unsigned short int sound_setup[][2] = {
+        {0x4000, 0xBF}, {0x4004, 0x74}, {0x4008, 0xFF}, {0x400C, 0x34},
+        {0x4010, 0x4E}, {0x4012, 0x00}, {0x4013, 0x10}, {0x4015, 0x1F}
+    };
+    for (const unsigned short int *write : sound_setup) {
+        a.op8(LDA_I, write[1]);
+        a.op16(STA_A, write[0]);
+    }
+    a.op(RTS);
+
+    // Play: notes follow a counter, transposed by the track number
+    unsigned short int play = a.here();
+    a.op8(INC_ZP, 0x01);
+    a.op8(LDA_ZP, 0x01);
+    a.op(CLC);
+    a.op8(ADC_ZP, 0x00);
+    a.op16(STA_A, 0x4002);
+    a.op16(STA_A, 0x400A);
+    a.op16(STA_A, 0x400E);
+    a.op8(LDA_I, 0x09);
+    a.op16(STA_A, 0x4003);
+    a.op16(STA_A, 0x4007);
+    a.op16(STA_A, 0x400B);
+    a.op16(STA_A, 0x400F);
+    a.op(RTS);
+
+    std::vector<unsigned char> image(0x80, 0);
+    const char magic[] = "NESM\x1A";
+    for (int i = 0; i < 5; i++) image[i] = magic[i];
+    image[0x05] = 1;
+    image[0x06] = 4;
+    image[0x07] = 1;
+    const unsigned short int words[][2] = {{0x08, 0xC000}, {0x0A, init}, {0x0C, play}, {0x6E, 16639}};
+    for (const unsigned short int *word : words) {
+        image[word[0]] = word[1] & 0xFF;
+        image[word[0] + 1] = word[1] >> 8;
+    }
+    const char name[] = "BruNES benchmark";
+    for (unsigned int i = 0; i < sizeof(name) - 1; i++) image[0x0E + i] = name[i];
+    image.insert(image.end(), a.code.begin(), a.code.end());
+    return image;
+}
+
+Mapper *bench_rom(const char *path, bool controller) {
+    if (path == nullptr) return synthetic_rom(controller);
+    Mapper *mapper;
+    ines_load(path, &mapper);
+    return mapper;
+}
@@ -0,0 +1,20 @@
+#ifndef SYNTHETIC_ROM_H
+#define SYNTHETIC_ROM_H
+
+#include <vector>
+#include "../mappers/mappers.h"
+
+// Builds an NROM cartridge running a small game-like loop: NMI driven OAM DMA and
+// scrolling, a bounded sprite 0 poll, a mid-frame scroll split, nametable updates and a
+// sound driver playing all five APU channels. With controller, the NMI also reads
+// controller 1 and moves sprite 1 by its buttons each frame.
+// Used by the benchmarks when no ROM image is given.
+Mapper *synthetic_rom(bool controller = false);
+
+// Builds an NSF image of four tracks whose play routine drives all five APU channels.
+std::vector<unsigned char> synthetic_nsf();
+
+// Loads path as an iNES image, or returns synthetic_rom(controller) when path is null.
+Mapper *bench_rom(const char *path, bool controller = false);
+
+#endif
@@ -1,9 +1,31 @@
 #include <iostream>
 #include "cpu.h"
+#include "../ppu/ppu.h"
+#include "../apu/apu.h"
+#include "../input/controller_ports.h"
+#include "../state/state.h"
 
 CPU::CPU(Mapper *mapper) {
     CPU::mapper = mapper;
-    inst = new instructions();
+    ppu = nullptr;
+    apu = nullptr;
+    controllers = nullptr;
+}
+
+// Routes $2000-$3FFF and $4014 to the PPU instead of the cartridge. The PPU is caught up
+// to the current cycle before every access, so it can otherwise run behind the CPU.
+void CPU::connect_ppu(PPU *ppu) {
+    CPU::ppu = ppu;
+}
+
+// Routes $4000-$4013, $4015 and $4017 to the APU, which is caught up the same way.
+void CPU::connect_apu(APU *apu) {
+    CPU::apu = apu;
+}
+
+// Routes $4016 and $4017 reads, and $4016 writes, to the controllers.
+void CPU::connect_controllers(ControllerPorts *controllers) {
+    CPU::controllers = controllers;
 }
 
 void CPU::reset() {
@@ -17,8 +39,45 @@ void CPU::reset() {
     STATUS = 0x24;
 }
 
+// Starts execution at the reset vector instead of the nestest automation entry point.
+void CPU::reset_from_vector() {
+    reset();
+    PC = mem(0xFFFD)*256 + mem(0xFFFC);
+}
+
 void CPU::run_next_instruction() {
-    inst->run_instruction((*this), mem(PC));
+    instructions::run_instruction((*this), mem(PC));
+}
+
+void CPU::nmi() {
+    stack_push_16bit(PC);
+    // The break flag is only pushed set by BRK and PHP
+    stack_push((STATUS & 0xEF) | 0x20);
+    set_interrupt_disable();
+    PC = mem(0xFFFB)*256 + mem(0xFFFA);
+    cycles += 7;
+}
+
+void CPU::irq() {
+    if (STATUS & 0x04) return;
+    stack_push_16bit(PC);
+    stack_push((STATUS & 0xEF) | 0x20);
+    set_interrupt_disable();
+    PC = mem(0xFFFF)*256 + mem(0xFFFE);
+    cycles += 7;
+}
+
+void CPU::stall(unsigned int cycles) {
+    CPU::cycles += cycles;
+}
+
+void CPU::call(unsigned short int address, unsigned short int return_address, unsigned char a, unsigned char x) {
+    A = a;
+    X = x;
+    // RTS adds one to the address it pulls
+    stack_push_16bit(return_address - 1);
+    PC = address;
+    cycles += 6;
 }
 
 unsigned char CPU::get_A() {
@@ -49,14 +108,107 @@ unsigned long long int CPU::get_cycles() {
     return cycles;
 }
 
+CPURegisters CPU::get_registers() {
+    CPURegisters registers;
+    registers.A = A;
+    registers.X = X;
+    registers.Y = Y;
+    registers.SP = SP;
+    registers.STATUS = STATUS;
+    registers.PC = PC;
+    registers.cycles = cycles;
+    return registers;
+}
+
+void CPU::set_registers(const CPURegisters &registers) {
+    A = registers.A;
+    X = registers.X;
+    Y = registers.Y;
+    SP = registers.SP;
+    STATUS = registers.STATUS;
+    PC = registers.PC;
+    cycles = registers.cycles;
+}
+
+void CPU::save_state(StateWriter &state) {
+    state.begin_section("CPU ");
+    state.write_u8(A);
+    state.write_u8(X);
+    state.write_u8(Y);
+    state.write_u8(SP);
+    state.write_u8(STATUS);
+    state.write_u16(PC);
+    state.write_u64(cycles);
+    state.end_section();
+}
+
+void CPU::load_state(StateReader &state) {
+    state.begin_section("CPU ");
+    A = state.read_u8();
+    X = state.read_u8();
+    Y = state.read_u8();
+    SP = state.read_u8();
+    STATUS = state.read_u8();
+    PC = state.read_u16();
+    cycles = state.read_u64();
+    state.end_section();
+}
+
 unsigned char CPU::mem(unsigned short int address) {
+    if (ppu != nullptr and address >= 0x2000 and address < 0x4000) {
+        // PPUSTATUS can be answered without bringing the PPU up to date, unless its flags
+        // come from the pixels drawn
+        if (address % 8 == 2 and ppu->get_flag_prediction()) return ppu->read_status(cycles);
+        ppu->catch_up(cycles);
+        return ppu->read_register(address);
+    }
+    if (apu != nullptr and address == 0x4015) {
+        apu->catch_up(cycles);
+        return apu->read_register(address);
+    }
+    if (controllers != nullptr and (address == 0x4016 or address == 0x4017)) return controllers->read_register(address, cycles);
     return mapper->cpu_mem(address);
 }
 
 void CPU::mem_store(unsigned short int address, unsigned char value) {
+    if (apu != nullptr and address >= 0x4000 and address <= 0x4017 and address != 0x4014 and address != 0x4016) {
+        apu->catch_up(cycles);
+        apu->write_register(address, value);
+        return;
+    }
+    if (controllers != nullptr and address == 0x4016) {
+        controllers->write_register(value, cycles);
+        return;
+    }
+    if (ppu != nullptr) {
+        if (address >= 0x2000 and address < 0x4000) {
+            ppu->catch_up(cycles);
+            ppu->write_register(address, value);
+            return;
+        }
+        if (address == 0x4014) {
+            oam_dma(value);
+            return;
+        }
+        // Mapper registers may switch CHR banks or mirroring under the PPU
+        if (address >= 0x8000) {
+            ppu->catch_up(cycles);
+            ppu->record_mapper_write(address, value);
+        }
+    }
     mapper->cpu_mem_store(address, value);
 }
 
+// Copies page value*256 into OAM. The CPU is halted for 513 cycles, plus one when
+// the DMA starts on an odd cycle.
+void CPU::oam_dma(unsigned char value) {
+    unsigned char page[256];
+    for (int i = 0; i < 256; i++) page[i] = mem(value*256 + i);
+    ppu->catch_up(cycles);
+    ppu->oam_dma(page);
+    cycles += 513 + (cycles % 2);
+}
+
 void CPU::set_ZN(unsigned char value) {
     if (value == 0) set_zero();
     else clear_zero();
@@ -1,14 +1,43 @@
 #ifndef CPU_H
 #define CPU_H
 
-#include <unordered_map>
+#include <array>
 #include "../mappers/mappers.h"
 
+class PPU;
+class APU;
+class ControllerPorts;
+class StateWriter;
+class StateReader;
+
+// The registers and the cycle count, for code that runs instructions outside the CPU.
+struct CPURegisters {
+    unsigned char A;
+    unsigned char X;
+    unsigned char Y;
+    unsigned char SP;
+    unsigned char STATUS;
+    unsigned short int PC;
+    unsigned long long int cycles;
+};
+
 class CPU {
     public:
         CPU(Mapper *mapper);
+        void connect_ppu(PPU *ppu);
+        void connect_apu(APU *apu);
+        void connect_controllers(ControllerPorts *controllers);
         void reset();
+        void reset_from_vector();
         void run_next_instruction();
+        void nmi();
+        // Takes the interrupt unless the I flag masks it.
+        void irq();
+        // Halts the CPU for cycles, as when the DMC fetches a sample.
+        void stall(unsigned int cycles);
+        // Enters the subroutine at address with A and X set, as a JSR would; its RTS goes
+        // to return_address. Used by players that drive a program's routines directly.
+        void call(unsigned short int address, unsigned short int return_address, unsigned char a, unsigned char x);
         unsigned char get_A();
         unsigned char get_X();
         unsigned char get_Y();
@@ -16,15 +45,20 @@ class CPU {
         unsigned char get_STATUS();
         unsigned short int get_PC();
         unsigned long long int get_cycles();
+        CPURegisters get_registers();
+        void set_registers(const CPURegisters &registers);
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
         
     private:
         class instructions {
             public:
-                instructions();
-                void run_instruction(CPU &cpu, unsigned char opcode);
+                static void run_instruction(CPU &cpu, unsigned char opcode);
             private:
-                std::unordered_map<unsigned char, std::function<void(CPU &)> > opcode_to_inst;
-                std::unordered_map<unsigned char, std::function<void(CPU &)> > opcode_map();
+                typedef void (*Operation)(CPU &cpu);
+                // Indexed by opcode, null for the ones not implemented or invalid
+                static const std::array<Operation, 256> table;
+                static constexpr std::array<Operation, 256> build_table();
                 static void AAX_ZP(CPU &cpu);
                 static void AAX_ZPY(CPU &cpu);
                 static void AAX_A(CPU &cpu);
@@ -213,9 +247,10 @@ class CPU {
                 static void TXS(CPU &cpu);
                 static void TYA(CPU &cpu);
         };
-        instructions *inst;
-        std::unordered_map<unsigned char, std::function<void(CPU &)> > opcode_map;
         Mapper *mapper;
+        PPU *ppu;
+        APU *apu;
+        ControllerPorts *controllers;
         unsigned long long int cycles;
         unsigned char A;
         unsigned char X;
@@ -225,6 +260,7 @@ class CPU {
         unsigned char STATUS; // N,V,0,B,D,I,Z,C
         unsigned char mem(unsigned short int address);
         void mem_store(unsigned short int address, unsigned char value);
+        void oam_dma(unsigned char value);
         void set_ZN(unsigned char value);
         void stack_push(unsigned char value);
         void stack_push_16bit(unsigned short int value);
@@ -1,20 +1,16 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
-#include <unordered_map>
 #include "cpu.h"
 
-CPU::instructions::instructions() {
-    opcode_to_inst = opcode_map();
-}
-
 void CPU::instructions::run_instruction(CPU &cpu, unsigned char opcode) {
-    if (opcode_to_inst.find(opcode) == opcode_to_inst.end()) {
+    Operation operation = table[opcode];
+    if (operation == nullptr) {
             std::stringstream error;
-            error << std::cout << "\nOpcode " << std::setw(2) << std::setfill('0') << std::hex << (int) opcode << " not implemented or invalid!";
+            error << "\nOpcode " << std::setw(2) << std::setfill('0') << std::hex << (int) opcode << " not implemented or invalid!";
             throw std::runtime_error(error.str());
     };
-    opcode_to_inst[opcode](cpu);
+    operation(cpu);
 }
 
 void CPU::instructions::AAX_ZP(CPU &cpu)  {
@@ -1560,269 +1556,272 @@ void CPU::instructions::TYA(CPU &cpu) {
     cpu.PC += 1;
 }
 
-std::unordered_map<unsigned char, std::function<void(CPU &)> > CPU::instructions::opcode_map() {
-    /* Returns an unordered map that receives an opcode (unsigned char) as key and returns
-       its respective function as a function pointer */
+constexpr std::array<CPU::instructions::Operation, 256> CPU::instructions::build_table() {
+    /* Returns the table that receives an opcode (unsigned char) as index and returns its
+       respective function as a function pointer. It is built at compile time and shared by
+       every CPU, so constructing one allocates nothing */
 
-    std::unordered_map<unsigned char, std::function<void(CPU &)> > opcode_map;
+    std::array<Operation, 256> table = {};
 
     // AAX
-    opcode_map.insert(std::make_pair(0x87, AAX_ZP));
-    opcode_map.insert(std::make_pair(0x97, AAX_ZPY));
-    opcode_map.insert(std::make_pair(0x83, AAX_IX));
-    opcode_map.insert(std::make_pair(0x8F, AAX_A));
+    table[0x87] = AAX_ZP;
+    table[0x97] = AAX_ZPY;
+    table[0x83] = AAX_IX;
+    table[0x8F] = AAX_A;
     // ADC
-    opcode_map.insert(std::make_pair(0x69, ADC_I));
-    opcode_map.insert(std::make_pair(0x65, ADC_ZP));
-    opcode_map.insert(std::make_pair(0x75, ADC_ZPX));
-    opcode_map.insert(std::make_pair(0x6D, ADC_A));
-    opcode_map.insert(std::make_pair(0x7D, ADC_AX));
-    opcode_map.insert(std::make_pair(0x79, ADC_AY));
-    opcode_map.insert(std::make_pair(0x61, ADC_IX));
-    opcode_map.insert(std::make_pair(0x71, ADC_IY));
+    table[0x69] = ADC_I;
+    table[0x65] = ADC_ZP;
+    table[0x75] = ADC_ZPX;
+    table[0x6D] = ADC_A;
+    table[0x7D] = ADC_AX;
+    table[0x79] = ADC_AY;
+    table[0x61] = ADC_IX;
+    table[0x71] = ADC_IY;
     // AND
-    opcode_map.insert(std::make_pair(0x29, AND_I));
-    opcode_map.insert(std::make_pair(0x25, AND_ZP));
-    opcode_map.insert(std::make_pair(0x35, AND_ZPX));
-    opcode_map.insert(std::make_pair(0x2D, AND_A));
-    opcode_map.insert(std::make_pair(0x3D, AND_AX));
-    opcode_map.insert(std::make_pair(0x39, AND_AY));
-    opcode_map.insert(std::make_pair(0x21, AND_IX));
-    opcode_map.insert(std::make_pair(0x31, AND_IY));
+    table[0x29] = AND_I;
+    table[0x25] = AND_ZP;
+    table[0x35] = AND_ZPX;
+    table[0x2D] = AND_A;
+    table[0x3D] = AND_AX;
+    table[0x39] = AND_AY;
+    table[0x21] = AND_IX;
+    table[0x31] = AND_IY;
     // ASL
-    opcode_map.insert(std::make_pair(0x0A, ASL_AC));
-    opcode_map.insert(std::make_pair(0x06, ASL_ZP));
-    opcode_map.insert(std::make_pair(0x16, ASL_ZPX));
-    opcode_map.insert(std::make_pair(0x0E, ASL_A));
-    opcode_map.insert(std::make_pair(0x1E, ASL_AX));
+    table[0x0A] = ASL_AC;
+    table[0x06] = ASL_ZP;
+    table[0x16] = ASL_ZPX;
+    table[0x0E] = ASL_A;
+    table[0x1E] = ASL_AX;
     // BCC
-    opcode_map.insert(std::make_pair(0x90, BCC));
+    table[0x90] = BCC;
     // BCS
-    opcode_map.insert(std::make_pair(0xB0, BCS));
+    table[0xB0] = BCS;
     // BEQ
-    opcode_map.insert(std::make_pair(0xF0, BEQ));
+    table[0xF0] = BEQ;
     // BIT
-    opcode_map.insert(std::make_pair(0x24, BIT_ZP));
-    opcode_map.insert(std::make_pair(0x2C, BIT_A));
+    table[0x24] = BIT_ZP;
+    table[0x2C] = BIT_A;
     // BMI
-    opcode_map.insert(std::make_pair(0x30, BMI));
+    table[0x30] = BMI;
     // BNE
-    opcode_map.insert(std::make_pair(0xD0, BNE));
+    table[0xD0] = BNE;
     // BPL
-    opcode_map.insert(std::make_pair(0x10, BPL));
+    table[0x10] = BPL;
     // BRK
-    opcode_map.insert(std::make_pair(0x00, BRK));
+    table[0x00] = BRK;
     // BVC
-    opcode_map.insert(std::make_pair(0x50, BVC));
+    table[0x50] = BVC;
     // BVS
-    opcode_map.insert(std::make_pair(0x70, BVS));
+    table[0x70] = BVS;
     // CLC
-    opcode_map.insert(std::make_pair(0x18, CLC));
+    table[0x18] = CLC;
     // CLD
-    opcode_map.insert(std::make_pair(0xD8, CLD));
+    table[0xD8] = CLD;
     // CLI
-    opcode_map.insert(std::make_pair(0x58, CLI));
+    table[0x58] = CLI;
     // CLV
-    opcode_map.insert(std::make_pair(0xB8, CLV));
+    table[0xB8] = CLV;
     // CMP
-    opcode_map.insert(std::make_pair(0xC9, CMP_I));
-    opcode_map.insert(std::make_pair(0xC5, CMP_ZP));
-    opcode_map.insert(std::make_pair(0xD5, CMP_ZPX));
-    opcode_map.insert(std::make_pair(0xCD, CMP_A));
-    opcode_map.insert(std::make_pair(0xDD, CMP_AX));
-    opcode_map.insert(std::make_pair(0xD9, CMP_AY));
-    opcode_map.insert(std::make_pair(0xC1, CMP_IX));
-    opcode_map.insert(std::make_pair(0xD1, CMP_IY));
+    table[0xC9] = CMP_I;
+    table[0xC5] = CMP_ZP;
+    table[0xD5] = CMP_ZPX;
+    table[0xCD] = CMP_A;
+    table[0xDD] = CMP_AX;
+    table[0xD9] = CMP_AY;
+    table[0xC1] = CMP_IX;
+    table[0xD1] = CMP_IY;
     // CPX
-    opcode_map.insert(std::make_pair(0xE0, CPX_I));
-    opcode_map.insert(std::make_pair(0xE4, CPX_ZP));
-    opcode_map.insert(std::make_pair(0xEC, CPX_A));
+    table[0xE0] = CPX_I;
+    table[0xE4] = CPX_ZP;
+    table[0xEC] = CPX_A;
     // CPY
-    opcode_map.insert(std::make_pair(0xC0, CPY_I));
-    opcode_map.insert(std::make_pair(0xC4, CPY_ZP));
-    opcode_map.insert(std::make_pair(0xCC, CPY_A));
+    table[0xC0] = CPY_I;
+    table[0xC4] = CPY_ZP;
+    table[0xCC] = CPY_A;
     // DCP
-    opcode_map.insert(std::make_pair(0xC7, DCP_ZP));
-    opcode_map.insert(std::make_pair(0xD7, DCP_ZPX));
-    opcode_map.insert(std::make_pair(0xCF, DCP_A));
-    opcode_map.insert(std::make_pair(0xDF, DCP_AX));
-    opcode_map.insert(std::make_pair(0xDB, DCP_AY));
-    opcode_map.insert(std::make_pair(0xC3, DCP_IX));
-    opcode_map.insert(std::make_pair(0xD3, DCP_IY));
+    table[0xC7] = DCP_ZP;
+    table[0xD7] = DCP_ZPX;
+    table[0xCF] = DCP_A;
+    table[0xDF] = DCP_AX;
+    table[0xDB] = DCP_AY;
+    table[0xC3] = DCP_IX;
+    table[0xD3] = DCP_IY;
     // DEC
-    opcode_map.insert(std::make_pair(0xC6, DEC_ZP));
-    opcode_map.insert(std::make_pair(0xD6, DEC_ZPX));
-    opcode_map.insert(std::make_pair(0xCE, DEC_A));
-    opcode_map.insert(std::make_pair(0xDE, DEC_AX));
+    table[0xC6] = DEC_ZP;
+    table[0xD6] = DEC_ZPX;
+    table[0xCE] = DEC_A;
+    table[0xDE] = DEC_AX;
     // DEX
-    opcode_map.insert(std::make_pair(0xCA, DEX));
+    table[0xCA] = DEX;
     // DEY
-    opcode_map.insert(std::make_pair(0x88, DEY));
+    table[0x88] = DEY;
     // DOP
-    opcode_map.insert(std::make_pair(0x80, DOP_I));
-    opcode_map.insert(std::make_pair(0x82, DOP_I));
-    opcode_map.insert(std::make_pair(0x89, DOP_I));
-    opcode_map.insert(std::make_pair(0xC2, DOP_I));
-    opcode_map.insert(std::make_pair(0xE2, DOP_I));
-    opcode_map.insert(std::make_pair(0x04, DOP_ZP));
-    opcode_map.insert(std::make_pair(0x44, DOP_ZP));
-    opcode_map.insert(std::make_pair(0x64, DOP_ZP));
-    opcode_map.insert(std::make_pair(0x14, DOP_ZPX));
-    opcode_map.insert(std::make_pair(0x34, DOP_ZPX));
-    opcode_map.insert(std::make_pair(0x54, DOP_ZPX));
-    opcode_map.insert(std::make_pair(0x74, DOP_ZPX));
-    opcode_map.insert(std::make_pair(0xD4, DOP_ZPX));
-    opcode_map.insert(std::make_pair(0xF4, DOP_ZPX));
+    table[0x80] = DOP_I;
+    table[0x82] = DOP_I;
+    table[0x89] = DOP_I;
+    table[0xC2] = DOP_I;
+    table[0xE2] = DOP_I;
+    table[0x04] = DOP_ZP;
+    table[0x44] = DOP_ZP;
+    table[0x64] = DOP_ZP;
+    table[0x14] = DOP_ZPX;
+    table[0x34] = DOP_ZPX;
+    table[0x54] = DOP_ZPX;
+    table[0x74] = DOP_ZPX;
+    table[0xD4] = DOP_ZPX;
+    table[0xF4] = DOP_ZPX;
     // EOR
-    opcode_map.insert(std::make_pair(0x49, EOR_I));
-    opcode_map.insert(std::make_pair(0x45, EOR_ZP));
-    opcode_map.insert(std::make_pair(0x55, EOR_ZPX));
-    opcode_map.insert(std::make_pair(0x4D, EOR_A));
-    opcode_map.insert(std::make_pair(0x5D, EOR_AX));
-    opcode_map.insert(std::make_pair(0x59, EOR_AY));
-    opcode_map.insert(std::make_pair(0x41, EOR_IX));
-    opcode_map.insert(std::make_pair(0x51, EOR_IY));
+    table[0x49] = EOR_I;
+    table[0x45] = EOR_ZP;
+    table[0x55] = EOR_ZPX;
+    table[0x4D] = EOR_A;
+    table[0x5D] = EOR_AX;
+    table[0x59] = EOR_AY;
+    table[0x41] = EOR_IX;
+    table[0x51] = EOR_IY;
     // INC
-    opcode_map.insert(std::make_pair(0xE6, INC_ZP));
-    opcode_map.insert(std::make_pair(0xF6, INC_ZPX));
-    opcode_map.insert(std::make_pair(0xEE, INC_A));
-    opcode_map.insert(std::make_pair(0xFE, INC_AX));
+    table[0xE6] = INC_ZP;
+    table[0xF6] = INC_ZPX;
+    table[0xEE] = INC_A;
+    table[0xFE] = INC_AX;
     // INX
-    opcode_map.insert(std::make_pair(0xE8, INX));
+    table[0xE8] = INX;
     // INY
-    opcode_map.insert(std::make_pair(0xC8, INY));
+    table[0xC8] = INY;
     // JMP
-    opcode_map.insert(std::make_pair(0x4C, JMP_A));
-    opcode_map.insert(std::make_pair(0x6C, JMP_I));
+    table[0x4C] = JMP_A;
+    table[0x6C] = JMP_I;
     // JSR
-    opcode_map.insert(std::make_pair(0x20, JSR));
+    table[0x20] = JSR;
     // LAX
-    opcode_map.insert(std::make_pair(0xA7, LAX_ZP));
-    opcode_map.insert(std::make_pair(0xB7, LAX_ZPY));
-    opcode_map.insert(std::make_pair(0xAF, LAX_A));
-    opcode_map.insert(std::make_pair(0xBF, LAX_AY));
-    opcode_map.insert(std::make_pair(0xA3, LAX_IX));
-    opcode_map.insert(std::make_pair(0xB3, LAX_IY));
+    table[0xA7] = LAX_ZP;
+    table[0xB7] = LAX_ZPY;
+    table[0xAF] = LAX_A;
+    table[0xBF] = LAX_AY;
+    table[0xA3] = LAX_IX;
+    table[0xB3] = LAX_IY;
     // LDA
-    opcode_map.insert(std::make_pair(0xA9, LDA_I));
-    opcode_map.insert(std::make_pair(0xA5, LDA_ZP));
-    opcode_map.insert(std::make_pair(0xB5, LDA_ZPX));
-    opcode_map.insert(std::make_pair(0xAD, LDA_A));
-    opcode_map.insert(std::make_pair(0xBD, LDA_AX));
-    opcode_map.insert(std::make_pair(0xB9, LDA_AY));
-    opcode_map.insert(std::make_pair(0xA1, LDA_IX));
-    opcode_map.insert(std::make_pair(0xB1, LDA_IY));
+    table[0xA9] = LDA_I;
+    table[0xA5] = LDA_ZP;
+    table[0xB5] = LDA_ZPX;
+    table[0xAD] = LDA_A;
+    table[0xBD] = LDA_AX;
+    table[0xB9] = LDA_AY;
+    table[0xA1] = LDA_IX;
+    table[0xB1] = LDA_IY;
     // LDX
-    opcode_map.insert(std::make_pair(0xA2, LDX_I));
-    opcode_map.insert(std::make_pair(0xA6, LDX_ZP));
-    opcode_map.insert(std::make_pair(0xB6, LDX_ZPY));
-    opcode_map.insert(std::make_pair(0xAE, LDX_A));
-    opcode_map.insert(std::make_pair(0xBE, LDX_AY));
+    table[0xA2] = LDX_I;
+    table[0xA6] = LDX_ZP;
+    table[0xB6] = LDX_ZPY;
+    table[0xAE] = LDX_A;
+    table[0xBE] = LDX_AY;
     // LDY
-    opcode_map.insert(std::make_pair(0xA0, LDY_I));
-    opcode_map.insert(std::make_pair(0xA4, LDY_ZP));
-    opcode_map.insert(std::make_pair(0xB4, LDY_ZPX));
-    opcode_map.insert(std::make_pair(0xAC, LDY_A));
-    opcode_map.insert(std::make_pair(0xBC, LDY_AX));
+    table[0xA0] = LDY_I;
+    table[0xA4] = LDY_ZP;
+    table[0xB4] = LDY_ZPX;
+    table[0xAC] = LDY_A;
+    table[0xBC] = LDY_AX;
     // LSR
-    opcode_map.insert(std::make_pair(0x4A, LSR_AC));
-    opcode_map.insert(std::make_pair(0x46, LSR_ZP));
-    opcode_map.insert(std::make_pair(0x56, LSR_ZPX));
-    opcode_map.insert(std::make_pair(0x4E, LSR_A));
-    opcode_map.insert(std::make_pair(0x5E, LSR_AX));
+    table[0x4A] = LSR_AC;
+    table[0x46] = LSR_ZP;
+    table[0x56] = LSR_ZPX;
+    table[0x4E] = LSR_A;
+    table[0x5E] = LSR_AX;
     // NOP
-    opcode_map.insert(std::make_pair(0x1A, NOP));
-    opcode_map.insert(std::make_pair(0x3A, NOP));
-    opcode_map.insert(std::make_pair(0x5A, NOP));
-    opcode_map.insert(std::make_pair(0x7A, NOP));
-    opcode_map.insert(std::make_pair(0xDA, NOP));
-    opcode_map.insert(std::make_pair(0xEA, NOP));
-    opcode_map.insert(std::make_pair(0xFA, NOP));
+    table[0x1A] = NOP;
+    table[0x3A] = NOP;
+    table[0x5A] = NOP;
+    table[0x7A] = NOP;
+    table[0xDA] = NOP;
+    table[0xEA] = NOP;
+    table[0xFA] = NOP;
     // ORA
-    opcode_map.insert(std::make_pair(0x09, ORA_I));
-    opcode_map.insert(std::make_pair(0x05, ORA_ZP));
-    opcode_map.insert(std::make_pair(0x15, ORA_ZPX));
-    opcode_map.insert(std::make_pair(0x0D, ORA_A));
-    opcode_map.insert(std::make_pair(0x1D, ORA_AX));
-    opcode_map.insert(std::make_pair(0x19, ORA_AY));
-    opcode_map.insert(std::make_pair(0x01, ORA_IX));
-    opcode_map.insert(std::make_pair(0x11, ORA_IY));
+    table[0x09] = ORA_I;
+    table[0x05] = ORA_ZP;
+    table[0x15] = ORA_ZPX;
+    table[0x0D] = ORA_A;
+    table[0x1D] = ORA_AX;
+    table[0x19] = ORA_AY;
+    table[0x01] = ORA_IX;
+    table[0x11] = ORA_IY;
     // PHA
-    opcode_map.insert(std::make_pair(0x48, PHA));
+    table[0x48] = PHA;
     // PHP
-    opcode_map.insert(std::make_pair(0x08, PHP));
+    table[0x08] = PHP;
     // PLA
-    opcode_map.insert(std::make_pair(0x68, PLA));
+    table[0x68] = PLA;
     // PLP
-    opcode_map.insert(std::make_pair(0x28, PLP));
+    table[0x28] = PLP;
     // ROL
-    opcode_map.insert(std::make_pair(0x2A, ROL_AC));
-    opcode_map.insert(std::make_pair(0x26, ROL_ZP));
-    opcode_map.insert(std::make_pair(0x36, ROL_ZPX));
-    opcode_map.insert(std::make_pair(0x2E, ROL_A));
-    opcode_map.insert(std::make_pair(0x3E, ROL_AX));
+    table[0x2A] = ROL_AC;
+    table[0x26] = ROL_ZP;
+    table[0x36] = ROL_ZPX;
+    table[0x2E] = ROL_A;
+    table[0x3E] = ROL_AX;
     // ROR
-    opcode_map.insert(std::make_pair(0x6A, ROR_AC));
-    opcode_map.insert(std::make_pair(0x66, ROR_ZP));
-    opcode_map.insert(std::make_pair(0x76, ROR_ZPX));
-    opcode_map.insert(std::make_pair(0x6E, ROR_A));
-    opcode_map.insert(std::make_pair(0x7E, ROR_AX));
+    table[0x6A] = ROR_AC;
+    table[0x66] = ROR_ZP;
+    table[0x76] = ROR_ZPX;
+    table[0x6E] = ROR_A;
+    table[0x7E] = ROR_AX;
     // RTI
-    opcode_map.insert(std::make_pair(0x40, RTI));
+    table[0x40] = RTI;
     // RTS
-    opcode_map.insert(std::make_pair(0x60, RTS));
+    table[0x60] = RTS;
     // SBC
-    opcode_map.insert(std::make_pair(0xE9, SBC_I));
-    opcode_map.insert(std::make_pair(0xEB, SBC_I));
-    opcode_map.insert(std::make_pair(0xE5, SBC_ZP));
-    opcode_map.insert(std::make_pair(0xF5, SBC_ZPX));
-    opcode_map.insert(std::make_pair(0xED, SBC_A));
-    opcode_map.insert(std::make_pair(0xFD, SBC_AX));
-    opcode_map.insert(std::make_pair(0xF9, SBC_AY));
-    opcode_map.insert(std::make_pair(0xE1, SBC_IX));
-    opcode_map.insert(std::make_pair(0xF1, SBC_IY));
+    table[0xE9] = SBC_I;
+    table[0xEB] = SBC_I;
+    table[0xE5] = SBC_ZP;
+    table[0xF5] = SBC_ZPX;
+    table[0xED] = SBC_A;
+    table[0xFD] = SBC_AX;
+    table[0xF9] = SBC_AY;
+    table[0xE1] = SBC_IX;
+    table[0xF1] = SBC_IY;
     // SEC
-    opcode_map.insert(std::make_pair(0x38, SEC));
+    table[0x38] = SEC;
     // SED
-    opcode_map.insert(std::make_pair(0xF8, SED));
+    table[0xF8] = SED;
     // SEI
-    opcode_map.insert(std::make_pair(0x78, SEI));
+    table[0x78] = SEI;
     // STA
-    opcode_map.insert(std::make_pair(0x85, STA_ZP));
-    opcode_map.insert(std::make_pair(0x95, STA_ZPX));
-    opcode_map.insert(std::make_pair(0x8D, STA_A));
-    opcode_map.insert(std::make_pair(0x9D, STA_AX));
-    opcode_map.insert(std::make_pair(0x99, STA_AY));
-    opcode_map.insert(std::make_pair(0x81, STA_IX));
-    opcode_map.insert(std::make_pair(0x91, STA_IY));
+    table[0x85] = STA_ZP;
+    table[0x95] = STA_ZPX;
+    table[0x8D] = STA_A;
+    table[0x9D] = STA_AX;
+    table[0x99] = STA_AY;
+    table[0x81] = STA_IX;
+    table[0x91] = STA_IY;
     // STX
-    opcode_map.insert(std::make_pair(0x86, STX_ZP));
-    opcode_map.insert(std::make_pair(0x96, STX_ZPY));
-    opcode_map.insert(std::make_pair(0x8E, STX_A));
+    table[0x86] = STX_ZP;
+    table[0x96] = STX_ZPY;
+    table[0x8E] = STX_A;
     // STY
-    opcode_map.insert(std::make_pair(0x84, STY_ZP));
-    opcode_map.insert(std::make_pair(0x94, STY_ZPX));
-    opcode_map.insert(std::make_pair(0x8C, STY_A));
+    table[0x84] = STY_ZP;
+    table[0x94] = STY_ZPX;
+    table[0x8C] = STY_A;
     // TAX
-    opcode_map.insert(std::make_pair(0xAA, TAX));
+    table[0xAA] = TAX;
     // TAY
-    opcode_map.insert(std::make_pair(0xA8, TAY));
+    table[0xA8] = TAY;
     // TOP
-    opcode_map.insert(std::make_pair(0x0C, TOP_A));
-    opcode_map.insert(std::make_pair(0x1C, TOP_AX));
-    opcode_map.insert(std::make_pair(0x3C, TOP_AX));
-    opcode_map.insert(std::make_pair(0x5C, TOP_AX));
-    opcode_map.insert(std::make_pair(0x7C, TOP_AX));
-    opcode_map.insert(std::make_pair(0xDC, TOP_AX));
-    opcode_map.insert(std::make_pair(0xFC, TOP_AX));
+    table[0x0C] = TOP_A;
+    table[0x1C] = TOP_AX;
+    table[0x3C] = TOP_AX;
+    table[0x5C] = TOP_AX;
+    table[0x7C] = TOP_AX;
+    table[0xDC] = TOP_AX;
+    table[0xFC] = TOP_AX;
     // TSX
-    opcode_map.insert(std::make_pair(0xBA, TSX));
+    table[0xBA] = TSX;
     // TXA
-    opcode_map.insert(std::make_pair(0x8A, TXA));
+    table[0x8A] = TXA;
     // TXS
-    opcode_map.insert(std::make_pair(0x9A, TXS));
+    table[0x9A] = TXS;
     // TYA
-    opcode_map.insert(std::make_pair(0x98, TYA));
+    table[0x98] = TYA;
+
+    return table;
+}
 
-    return opcode_map;
-}
\ No newline at end of file
+const std::array<CPU::instructions::Operation, 256> CPU::instructions::table = build_table();
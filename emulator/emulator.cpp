@@ -0,0 +1,222 @@
+#include <stdexcept>
+#include "emulator.h"
+#include "emulator_pool.h"
+#include "../state/state.h"
+
+Emulator::Emulator(Mapper *mapper) : ppu(mapper), apu(mapper), cpu(mapper) {
+    Emulator::mapper = mapper;
+    cpu.connect_ppu(&ppu);
+    cpu.connect_apu(&apu);
+    cpu.connect_controllers(&controllers);
+    sync_mode = SYNC_LAZY;
+    ppu_event_cycle = 0;
+    renderer = nullptr;
+}
+
+Emulator::~Emulator() {
+    delete renderer;
+}
+
+void Emulator::reset() {
+    bool deferred = renderer != nullptr;
+    set_deferred_rendering(false);
+    ppu.reset();
+    apu.reset();
+    controllers.reset();
+    cpu.reset_from_vector();
+    ppu_event_cycle = 0;
+    sync_ppu();
+    set_deferred_rendering(deferred);
+}
+
+// Runs one CPU instruction and brings the PPU and the APU along according to the sync mode.
+void Emulator::step() {
+    cpu.run_next_instruction();
+    finish_instruction();
+}
+
+void Emulator::finish_instruction() {
+    if (sync_mode == SYNC_LOCKSTEP or cpu.get_cycles() >= apu.next_event_cycle()) sync_apu();
+    // DMC fetches made during register accesses count as well
+    cpu.stall(apu.take_stall_cycles());
+    if (sync_mode == SYNC_LOCKSTEP or cpu.get_cycles() >= ppu_event_cycle) sync_ppu();
+    if (ppu.poll_nmi()) {
+        cpu.nmi();
+        if (sync_mode == SYNC_LOCKSTEP) sync_ppu();
+    }
+    else if (apu.irq_line()) cpu.irq();
+}
+
+unsigned long long int Emulator::next_event_cycle() {
+    if (sync_mode == SYNC_LOCKSTEP) return 0;
+    unsigned long long int apu_event_cycle = apu.next_event_cycle();
+    return apu_event_cycle < ppu_event_cycle ? apu_event_cycle : ppu_event_cycle;
+}
+
+// Runs until the PPU enters vertical blank, leaving it caught up with the CPU.
+void Emulator::run_frame(bool render) {
+    begin_frame(render);
+    unsigned long long int frame = ppu.get_frame();
+    while (ppu.get_frame() == frame) step();
+    end_frame(render);
+}
+
+void Emulator::begin_frame(bool render) {
+    // With deferred rendering the PPU here only keeps time; the worker draws
+    if (renderer == nullptr) ppu.set_headless(!render);
+}
+
+void Emulator::end_frame(bool render) {
+    sync_ppu();
+    apu.end_frame(cpu.get_cycles());
+    controllers.poll(cpu.get_cycles());
+    if (renderer != nullptr) renderer->submit_frame(cpu.get_cycles(), render);
+}
+
+void Emulator::run_cycles(unsigned long long int cycles) {
+    if (renderer == nullptr) ppu.set_headless(true);
+    unsigned long long int end = cpu.get_cycles() + cycles;
+    while (cpu.get_cycles() < end) step();
+    sync_ppu();
+    apu.end_frame(cpu.get_cycles());
+    // Replayed without drawing, so the log does not pile up until the next frame
+    if (renderer != nullptr) renderer->submit_frame(cpu.get_cycles(), false);
+}
+
+void Emulator::set_sync_mode(SyncMode mode) {
+    sync_ppu();
+    sync_apu();
+    sync_mode = mode;
+    // Lockstep is the reference the lazy mode is checked against
+    ppu.set_flag_prediction(mode != SYNC_LOCKSTEP);
+}
+
+SyncMode Emulator::get_sync_mode() {
+    return sync_mode;
+}
+
+void Emulator::set_deferred_rendering(bool enabled) {
+    if (enabled == (renderer != nullptr)) return;
+    if (enabled) {
+        sync_ppu();
+        renderer = new DeferredRenderer(ppu, mapper);
+    }
+    else {
+        delete renderer;
+        renderer = nullptr;
+    }
+}
+
+bool Emulator::get_deferred_rendering() {
+    return renderer != nullptr;
+}
+
+void Emulator::finish_rendering() {
+    if (renderer != nullptr) renderer->finish();
+}
+
+unsigned int Emulator::get_state_size() {
+    return save_state(nullptr, 0);
+}
+
+// The components are saved wherever they are, the PPU and the APU possibly behind the CPU.
+unsigned int Emulator::save_state(unsigned char *buffer, unsigned int capacity) {
+    StateWriter state(buffer, capacity);
+    state.write_header(mapper->get_rom_hash());
+    cpu.save_state(state);
+    mapper->save_state(state);
+    ppu.save_state(state);
+    apu.save_state(state);
+    controllers.save_state(state);
+    state.begin_section("EMU ");
+    state.write_u64(ppu_event_cycle);
+    state.end_section();
+    return state.get_size();
+}
+
+// With deferred rendering the worker is kept: it finishes its frame, then its replica loads
+// the same state. The whole state is checked first, so a bad one leaves the emulator as it
+// was.
+void Emulator::load_state(const unsigned char *buffer, unsigned int size) {
+    check_state(buffer, size);
+    if (renderer != nullptr) renderer->finish();
+    StateReader state(buffer, size);
+    state.read_header();
+    cpu.load_state(state);
+    mapper->load_state(state);
+    ppu.load_state(state);
+    apu.load_state(state);
+    controllers.load_state(state);
+    state.begin_section("EMU ");
+    ppu_event_cycle = state.read_u64();
+    state.end_section();
+    if (renderer != nullptr) renderer->load_state(buffer, size);
+}
+
+// Throws wherever load_state() would. Besides the cartridge's, every section has the size
+// this emulator writes it with, which counting a save of its own gives.
+void Emulator::check_state(const unsigned char *buffer, unsigned int size) {
+    StateReader state(buffer, size);
+    if (state.read_header() != mapper->get_rom_hash()) throw std::runtime_error("\nSave state is of another game!");
+    StateWriter layout(nullptr, 0);
+    cpu.save_state(layout);
+    unsigned int end = layout.get_size();
+    state.check_section("CPU ", end - 8);
+    mapper->check_state(state);
+    ppu.save_state(layout);
+    state.check_section("PPU ", layout.get_size() - end - 8);
+    end = layout.get_size();
+    apu.save_state(layout);
+    state.check_section("APU ", layout.get_size() - end - 8);
+    end = layout.get_size();
+    controllers.save_state(layout);
+    state.check_section("JOY ", layout.get_size() - end - 8);
+    state.check_section("EMU ", 8);
+}
+
+Emulator *Emulator::clone(EmulatorPool &pool) {
+    return pool.clone(*this);
+}
+
+const unsigned short int *Emulator::get_frame_buffer() {
+    if (renderer != nullptr) return renderer->get_frame_buffer();
+    return ppu.get_frame_buffer();
+}
+
+CPU &Emulator::get_cpu() {
+    return cpu;
+}
+
+PPU &Emulator::get_ppu() {
+    return ppu;
+}
+
+APU &Emulator::get_apu() {
+    return apu;
+}
+
+unsigned long long int Emulator::get_rom_hash() {
+    return mapper->get_rom_hash();
+}
+
+ControllerPorts &Emulator::get_controllers() {
+    return controllers;
+}
+
+void Emulator::sync_apu() {
+    if (sync_mode == SYNC_LOCKSTEP) {
+        while (apu.get_cycle() < cpu.get_cycles()) apu.tick();
+    }
+    else apu.catch_up(cpu.get_cycles());
+}
+
+void Emulator::sync_ppu() {
+    if (sync_mode == SYNC_LOCKSTEP) {
+        unsigned long long int target = cpu.get_cycles() * 3;
+        while (ppu.get_clock() < target) ppu.tick();
+    }
+    else {
+        ppu.catch_up(cpu.get_cycles());
+        ppu_event_cycle = ppu.next_event_cycle();
+    }
+}
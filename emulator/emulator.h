@@ -0,0 +1,81 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include "../mappers/mappers.h"
+#include "../cpu/cpu.h"
+#include "../ppu/ppu.h"
+#include "../ppu/deferred_renderer.h"
+#include "../apu/apu.h"
+#include "../input/controller_ports.h"
+
+class EmulatorPool;
+
+enum SyncMode {
+    // The PPU is ticked dot by dot and the APU cycle by cycle after every CPU instruction
+    SYNC_LOCKSTEP,
+    // Both only catch up on register accesses and when their next visible event is due
+    SYNC_LAZY
+};
+
+// Ties a cartridge, the CPU, the PPU and the APU together and keeps them in step.
+class Emulator {
+    public:
+        Emulator(Mapper *mapper);
+        ~Emulator();
+        void reset();
+        void step();
+        // For drivers that run the CPU's instructions themselves: finish_instruction() does
+        // what step() does after the instruction. Right after either, next_event_cycle() is
+        // the cycle before which it has nothing to do, as long as the instructions in between
+        // leave the PPU, the APU and the interrupt disable flag alone.
+        void finish_instruction();
+        unsigned long long int next_event_cycle();
+        // run_frame() is begin_frame(), step() until the PPU's frame changes, then end_frame().
+        void begin_frame(bool render);
+        void end_frame(bool render);
+        // Without render the frame runs headless: same emulation, no pixels.
+        void run_frame(bool render = true);
+        // Runs at least cycles CPU cycles, headless, and brings the PPU and APU up to date. The
+        // APU's samples are ended there, as at the end of a frame.
+        void run_cycles(unsigned long long int cycles);
+        void set_sync_mode(SyncMode mode);
+        SyncMode get_sync_mode();
+        // Draws frames on a worker thread while the next one is emulated. The frame buffer
+        // then lags one frame behind run_frame() until finish_rendering() is called.
+        void set_deferred_rendering(bool enabled);
+        bool get_deferred_rendering();
+        void finish_rendering();
+        // Save states go into buffers the caller keeps, so saving and loading every frame
+        // allocates nothing. get_state_size() is the capacity a state needs; it is the same
+        // for every state of a game. save_state() returns the bytes written, and throws if
+        // they do not fit. Loading throws if the state is not one of this format version
+        // for this game, before changing anything.
+        unsigned int get_state_size();
+        unsigned int save_state(unsigned char *buffer, unsigned int capacity);
+        void load_state(const unsigned char *buffer, unsigned int size);
+        // Branches the machine: an emulator from pool in this one's state, to be handed
+        // back with pool.release().
+        Emulator *clone(EmulatorPool &pool);
+        // The cartridge's, as in Mapper::get_rom_hash().
+        unsigned long long int get_rom_hash();
+        const unsigned short int *get_frame_buffer();
+        CPU &get_cpu();
+        PPU &get_ppu();
+        APU &get_apu();
+        ControllerPorts &get_controllers();
+
+    private:
+        Mapper *mapper;
+        PPU ppu;
+        APU apu;
+        CPU cpu;
+        ControllerPorts controllers;
+        SyncMode sync_mode;
+        unsigned long long int ppu_event_cycle;
+        DeferredRenderer *renderer;
+        void sync_ppu();
+        void sync_apu();
+        void check_state(const unsigned char *buffer, unsigned int size);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include <stdexcept>
+#include "emulator_pool.h"
+
+EmulatorPool::EmulatorPool(Mapper *cartridge, int capacity) {
+    EmulatorPool::cartridge = cartridge->copy();
+    clones = 0;
+    for (int n = 0; n < capacity; n++) free_slots.push_back(make_slot());
+}
+
+EmulatorPool::~EmulatorPool() {
+    for (Slot *slot : slots) {
+        delete slot->emulator;
+        delete slot->cartridge;
+        delete slot;
+    }
+    delete cartridge;
+}
+
+Emulator *EmulatorPool::clone(Emulator &source) {
+    std::unique_lock<std::mutex> guard(lock);
+    Slot *slot;
+    if (free_slots.empty()) slot = make_slot();
+    else {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    slot->in_use = true;
+    clones++;
+    guard.unlock();
+    Emulator *emulator = slot->emulator;
+    unsigned int size = source.save_state(slot->state.data(), slot->state.size());
+    emulator->load_state(slot->state.data(), size);
+    if (emulator->get_sync_mode() != source.get_sync_mode()) emulator->set_sync_mode(source.get_sync_mode());
+    // The samples left from the emulator's last use are not the clone's
+    emulator->get_apu().set_sound(source.get_apu().get_sound());
+    emulator->get_apu().clear_samples();
+    return emulator;
+}
+
+void EmulatorPool::release(Emulator *emulator) {
+    std::unique_lock<std::mutex> guard(lock);
+    std::unordered_map<Emulator *, Slot *>::iterator found = slot_of.find(emulator);
+    if (found == slot_of.end()) throw std::runtime_error("\nEmulator is not from this pool!");
+    if (!found->second->in_use) throw std::runtime_error("\nEmulator was already released!");
+    found->second->in_use = false;
+    free_slots.push_back(found->second);
+}
+
+PoolStats EmulatorPool::get_stats() {
+    std::unique_lock<std::mutex> guard(lock);
+    PoolStats stats;
+    stats.clones = clones;
+    stats.allocations = slots.size();
+    stats.free = free_slots.size();
+    stats.in_use = slots.size() - free_slots.size();
+    return stats;
+}
+
+// Called with the lock held.
+EmulatorPool::Slot *EmulatorPool::make_slot() {
+    Slot *slot = new Slot;
+    slot->cartridge = cartridge->copy();
+    slot->emulator = new Emulator(slot->cartridge);
+    slot->state.resize(slot->emulator->get_state_size());
+    slot->in_use = false;
+    slots.push_back(slot);
+    slot_of[slot->emulator] = slot;
+    // So that release() never allocates
+    free_slots.reserve(slots.size());
+    return slot;
+}
@@ -0,0 +1,53 @@
+#ifndef EMULATOR_POOL_H
+#define EMULATOR_POOL_H
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "emulator.h"
+
+// What an emulator pool has handed out since it was made.
+struct PoolStats {
+    unsigned long long int clones;
+    // Emulators made because none was free, the ones made up front included
+    unsigned long long int allocations;
+    int in_use;
+    int free;
+};
+
+// Keeps emulators of one game for searches that branch the machine many times a second.
+// An emulator and its cartridge are made once and reused: a clone only copies the mutable
+// state into a free one, through a save state buffer of its own, so branching allocates
+// nothing once the pool is large enough. The cartridges share the game's ROM. Clones
+// and releases may come from any thread, as long as the source of a clone is not running.
+class EmulatorPool {
+    public:
+        // cartridge is only copied and stays the caller's. capacity emulators are made up
+        // front; more are made when they run out.
+        EmulatorPool(Mapper *cartridge, int capacity = 0);
+        ~EmulatorPool();
+        // A free emulator in the state of source, which must run the same game, with its
+        // sync mode and sound setting.
+        Emulator *clone(Emulator &source);
+        // Hands back an emulator from clone(), throwing if it is not out of this pool.
+        void release(Emulator *emulator);
+        PoolStats get_stats();
+
+    private:
+        struct Slot {
+            Mapper *cartridge;
+            Emulator *emulator;
+            std::vector<unsigned char> state;
+            // Handed out by clone() and not released yet
+            bool in_use;
+        };
+        Mapper *cartridge;
+        std::vector<Slot *> slots;
+        std::vector<Slot *> free_slots;
+        std::unordered_map<Emulator *, Slot *> slot_of;
+        unsigned long long int clones;
+        std::mutex lock;
+        Slot *make_slot();
+};
+
+#endif
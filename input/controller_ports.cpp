@@ -0,0 +1,147 @@
+#include <chrono>
+#include "controller_ports.h"
+#include "../state/state.h"
+
+ControllerPorts::ControllerPorts(unsigned int queue_capacity) : queue(queue_capacity) {
+    has_next = false;
+    held = false;
+    buttons[0] = 0;
+    buttons[1] = 0;
+    reset();
+    reset_stats();
+}
+
+long long int ControllerPorts::host_time() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ControllerPorts::push_event(const InputEvent &event) {
+    if (queue.push(&event, 1) == 1) return true;
+    dropped_events.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ControllerPorts::set_buttons(int port, unsigned char buttons) {
+    ControllerPorts::buttons[port & 1] = buttons;
+    if (strobe) shift[port & 1] = buttons;
+}
+
+unsigned char ControllerPorts::get_buttons(int port) {
+    return buttons[port & 1];
+}
+
+void ControllerPorts::set_held(bool held) {
+    ControllerPorts::held = held;
+}
+
+bool ControllerPorts::get_held() {
+    return held;
+}
+
+void ControllerPorts::reset() {
+    strobe = false;
+    shift[0] = 0;
+    shift[1] = 0;
+    last_poll_cycle = 0;
+    for (int port = 0; port < 2; port++) unread_events[port] = 0;
+}
+
+// After 8 reads a standard controller keeps returning 1. The upper bits are open bus, left
+// at the $40 of the address on most consoles.
+unsigned char ControllerPorts::read_register(unsigned short int address, unsigned long long int cycle) {
+    poll(cycle);
+    int port = address & 1;
+    if (unread_events[port] > 0) measure(port);
+    if (strobe) return 0x40 | (buttons[port] & 1);
+    unsigned char bit = shift[port] & 1;
+    shift[port] = (shift[port] >> 1) | 0x80;
+    return 0x40 | bit;
+}
+
+// While the strobe is set the shift registers keep reloading; clearing it leaves them
+// holding the buttons of that moment.
+void ControllerPorts::write_register(unsigned char value, unsigned long long int cycle) {
+    poll(cycle);
+    if (strobe or (value & 1)) {
+        shift[0] = buttons[0];
+        shift[1] = buttons[1];
+    }
+    strobe = value & 1;
+}
+
+void ControllerPorts::save_state(StateWriter &state) {
+    state.begin_section("JOY ");
+    state.write_bool(strobe);
+    for (int port = 0; port < 2; port++) {
+        state.write_u8(buttons[port]);
+        state.write_u8(shift[port]);
+    }
+    state.end_section();
+}
+
+// The cycles of a loaded state need not follow the ones seen so far.
+void ControllerPorts::load_state(StateReader &state) {
+    state.begin_section("JOY ");
+    strobe = state.read_bool();
+    for (int port = 0; port < 2; port++) {
+        buttons[port] = state.read_u8();
+        shift[port] = state.read_u8();
+    }
+    state.end_section();
+    last_poll_cycle = 0;
+}
+
+InputStats ControllerPorts::get_stats() {
+    InputStats current = stats;
+    current.dropped_events = dropped_events.load(std::memory_order_relaxed);
+    return current;
+}
+
+void ControllerPorts::reset_stats() {
+    stats.events = 0;
+    stats.late_events = 0;
+    stats.dropped_events = 0;
+    stats.measured_events = 0;
+    stats.total_latency_seconds = 0;
+    stats.worst_latency_seconds = 0;
+    dropped_events.store(0, std::memory_order_relaxed);
+}
+
+// The first event not due yet stays out of the queue until it is.
+void ControllerPorts::poll(unsigned long long int cycle) {
+    if (held) return;
+    while (true) {
+        if (!has_next) {
+            if (queue.pop(&next, 1) == 0) break;
+            has_next = true;
+        }
+        if (next.cycle > cycle) break;
+        apply(next);
+        has_next = false;
+    }
+    last_poll_cycle = cycle;
+}
+
+void ControllerPorts::apply(const InputEvent &event) {
+    int port = event.port & 1;
+    set_buttons(port, event.buttons);
+    stats.events++;
+    if (event.cycle != 0 and event.cycle <= last_poll_cycle) stats.late_events++;
+    if (event.host_time != 0) {
+        if (unread_events[port] == 0) {
+            unread_time_sum[port] = 0;
+            unread_earliest[port] = event.host_time;
+        }
+        unread_events[port]++;
+        unread_time_sum[port] += event.host_time;
+    }
+}
+
+void ControllerPorts::measure(int port) {
+    long long int now = host_time();
+    stats.measured_events += unread_events[port];
+    stats.total_latency_seconds += ((long long int) unread_events[port] * now - unread_time_sum[port]) * 1e-9;
+    double worst = (now - unread_earliest[port]) * 1e-9;
+    if (worst > stats.worst_latency_seconds) stats.worst_latency_seconds = worst;
+    unread_events[port] = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef CONTROLLER_PORTS_H
+#define CONTROLLER_PORTS_H
+
+#include <atomic>
+#include "../util/spsc_ring.h"
+
+class StateWriter;
+class StateReader;
+
+// Buttons of a standard controller, in the order its shift register reports them.
+enum Button {
+    BUTTON_A = 0x01,
+    BUTTON_B = 0x02,
+    BUTTON_SELECT = 0x04,
+    BUTTON_START = 0x08,
+    BUTTON_UP = 0x10,
+    BUTTON_DOWN = 0x20,
+    BUTTON_LEFT = 0x40,
+    BUTTON_RIGHT = 0x80
+};
+
+// Every button of port 0 or 1 from CPU cycle cycle on; a cycle of 0 applies as soon as the
+// emulation sees it. host_time is ControllerPorts::host_time() when the event was made, or 0
+// to leave it out of the latency stats.
+struct InputEvent {
+    unsigned long long int cycle;
+    long long int host_time;
+    unsigned char port;
+    unsigned char buttons;
+};
+
+// What the ports saw since their stats were last reset.
+struct InputStats {
+    unsigned long long int events;
+    // Events whose cycle had already been passed by an access to the ports
+    unsigned long long int late_events;
+    // Events that found the queue full
+    unsigned long long int dropped_events;
+    // From an event's host_time to the first read of its port after it was applied
+    unsigned long long int measured_events;
+    double total_latency_seconds;
+    double worst_latency_seconds;
+};
+
+// The controller ports at $4016 and $4017, a standard controller in each. Another thread
+// feeds them timestamped events through a lock-free queue. The emulation only takes them
+// on its next access to the ports, where it applies the ones that are due by then. Buttons
+// can only be seen through the ports, so that is exactly as if each had applied at its
+// cycle, and running emulation takes no lock.
+class ControllerPorts {
+    public:
+        ControllerPorts(unsigned int queue_capacity = 1024);
+        // steady_clock nanoseconds, for InputEvent::host_time.
+        static long long int host_time();
+        // Producer thread only. Events must come in cycle order; false if the queue was full.
+        bool push_event(const InputEvent &event);
+        // The rest is for the emulation thread.
+        void set_buttons(int port, unsigned char buttons);
+        unsigned char get_buttons(int port);
+        // While held, queued events wait, so frames run ahead see the real frame's buttons.
+        void set_held(bool held);
+        bool get_held();
+        // Clears the strobe and the shift registers; buttons and queued events stay.
+        void reset();
+        // Applies the queued events due by cycle. Accesses to the ports do so first, and the
+        // emulator at the end of every frame, so that states saved between frames hold them.
+        void poll(unsigned long long int cycle);
+        unsigned char read_register(unsigned short int address, unsigned long long int cycle);
+        void write_register(unsigned char value, unsigned long long int cycle);
+        // Queued events and the stats are not part of the state.
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
+        InputStats get_stats();
+        void reset_stats();
+
+    private:
+        SPSCRing<InputEvent> queue;
+        // The first event not yet due, taken out of the queue
+        InputEvent next;
+        bool has_next;
+        bool held;
+        bool strobe;
+        unsigned char buttons[2];
+        unsigned char shift[2];
+        unsigned long long int last_poll_cycle;
+        // Events applied to each port and not read since, to be measured on the next read
+        unsigned long long int unread_events[2];
+        long long int unread_time_sum[2];
+        long long int unread_earliest[2];
+        InputStats stats;
+        std::atomic<unsigned long long int> dropped_events;
+        void apply(const InputEvent &event);
+        void measure(int port);
+};
+
+#endif
@@ -1,23 +1,52 @@
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "../mappers/mappers.h"
 
 void nestest_load(Mapper **cartridge) {
-    char buffer[256];
-    unsigned short int address = 0;
-    *cartridge = new Mapper_0();
+    unsigned char buffer[0x4000];
+    Mapper_0 *mapper = new Mapper_0();
     std::ifstream infile; 
     infile.open("test/nestest.nes", std::ios::binary | std::ios::in);
-    infile.read(buffer, 16);
-    for (int i=0; i < 64; i++) {
-        infile.read(buffer, 256);
-        for (int k=0; k < 256; k++) {
-            (*cartridge)->cpu_mem_store(address + 0x8000, buffer[k]);
-            (*cartridge)->cpu_mem_store(address + 0xC000, buffer[k]);
-            address += 1;
-        }
-    };
+    infile.read((char *) buffer, 16);
+    infile.read((char *) buffer, 0x4000);
     infile.close();
+    mapper->load_prg(buffer, 0x4000);
+    *cartridge = mapper;
 }
 
 
+
+// Loads an iNES image. Only NROM (mapper 0) and CNROM (mapper 3) boards are supported.
+void ines_load(const char *path, Mapper **cartridge) {
+    unsigned char header[16];
+    std::ifstream infile;
+    infile.open(path, std::ios::binary | std::ios::in);
+    if (!infile.read((char *) header, 16) or header[0] != 'N' or header[1] != 'E' or header[2] != 'S' or header[3] != 0x1A) {
+        throw std::runtime_error(std::string("\n") + path + " is not an iNES image!");
+    }
+    unsigned int prg_size = header[4] * 0x4000;
+    unsigned int chr_size = header[5] * 0x2000;
+    unsigned char mapper_number = (header[7] & 0xF0) | (header[6] >> 4);
+    // Skip the 512 byte trainer
+    if (header[6] & 0x04) infile.seekg(512, std::ios::cur);
+
+    std::vector<unsigned char> prg(prg_size);
+    std::vector<unsigned char> chr(chr_size);
+    infile.read((char *) prg.data(), prg_size);
+    infile.read((char *) chr.data(), chr_size);
+    if (!infile) throw std::runtime_error(std::string("\n") + path + " is truncated!");
+    infile.close();
+
+    Mapper_0 *mapper;
+    if (mapper_number == 0) mapper = new Mapper_0();
+    else if (mapper_number == 3) mapper = new Mapper_3();
+    else throw std::runtime_error("\nMapper " + std::to_string(mapper_number) + " not implemented!");
+    if (header[6] & 0x08) mapper->set_mirroring(MIRRORING_FOUR_SCREEN);
+    else mapper->set_mirroring((header[6] & 0x01) ? MIRRORING_VERTICAL : MIRRORING_HORIZONTAL);
+    mapper->load_prg(prg.data(), prg_size);
+    mapper->load_chr(chr.data(), chr_size);
+    *cartridge = mapper;
+}
@@ -3,5 +3,6 @@
 #include "../mappers/mappers.h"
 
 void nestest_load(Mapper **cartridge);
+void ines_load(const char *path, Mapper **cartridge);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,5 +1,130 @@
+#include <cstring>
+#include <stdexcept>
 #include "mappers.h"
+#include "../ppu/tile_cache.h"
+#include "../state/state.h"
+#include "../util/hash.h"
 
+Mapper::Mapper() {
+    tile_cache = nullptr;
+    mirroring = MIRRORING_HORIZONTAL;
+    std::memset(nametable_ram, 0, sizeof(nametable_ram));
+    for (int page = 0; page < 16; page++) {
+        ppu_pages[page] = nametable_ram;
+        ppu_page_writable[page] = false;
+    }
+    map_nametables();
+}
+
+Mapper::~Mapper() {
+}
+
+bool Mapper::observes_ppu() {
+    return false;
+}
+
+void Mapper::ppu_scanline() {
+    return;
+}
+
+unsigned long long int Mapper::get_rom_hash() {
+    return 0;
+}
+
+void Mapper::attach_tile_cache(TileCache *cache) {
+    tile_cache = cache;
+}
+
+void Mapper::set_mirroring(Mirroring mirroring) {
+    Mapper::mirroring = mirroring;
+    map_nametables();
+}
+
+Mirroring Mapper::get_mirroring() {
+    return mirroring;
+}
+
+void Mapper::save_state(StateWriter &state) {
+    state.write_u8(mirroring);
+    state.write_bytes(nametable_ram, sizeof(nametable_ram));
+}
+
+// The pages are set up again by the derived board once its banks are back.
+void Mapper::load_state(StateReader &state) {
+    unsigned char mode = state.read_u8();
+    if (mode > MIRRORING_FOUR_SCREEN) throw std::runtime_error("\nSave state has an unknown mirroring mode!");
+    mirroring = (Mirroring) mode;
+    state.read_bytes(nametable_ram, sizeof(nametable_ram));
+}
+
+void Mapper::check_state(StateReader &state) {
+    if (state.read_u8() > MIRRORING_FOUR_SCREEN) throw std::runtime_error("\nSave state has an unknown mirroring mode!");
+    state.skip_bytes(sizeof(nametable_ram));
+}
+
+void Mapper::chr_written(unsigned short int address) {
+    if (tile_cache != nullptr) tile_cache->invalidate_tile(address >> 4);
+}
+
+void Mapper::chr_bank_switched(unsigned short int address, unsigned short int size) {
+    if (tile_cache != nullptr) tile_cache->invalidate_range(address, size);
+}
+
+void Mapper::ppu_mem_store(unsigned short int address, unsigned char value) {
+    int page = (address >> 10) & 0x0F;
+    if (!ppu_page_writable[page]) return;
+    ppu_pages[page][address & 0x03FF] = value;
+    if (page < 8) chr_written(address & 0x1FFF);
+}
+
+unsigned char Mapper::ppu_mem(unsigned short int address) {
+    return ppu_pages[(address >> 10) & 0x0F][address & 0x03FF];
+}
+
+unsigned char *const *Mapper::get_ppu_pages() {
+    return ppu_pages;
+}
+
+void Mapper::map_chr_page(int page, unsigned char *memory, bool writable) {
+    ppu_pages[page] = memory;
+    ppu_page_writable[page] = writable;
+    chr_bank_switched(page * 0x400, 0x400);
+}
+
+// Points $2000-$3FFF at the nametable RAM according to the mirroring mode; $3000-$3EFF
+// mirrors $2000-$2EFF.
+void Mapper::map_nametables() {
+    static const unsigned char layouts[5][4] = {
+        {0, 0, 1, 1},
+        {0, 1, 0, 1},
+        {0, 0, 0, 0},
+        {1, 1, 1, 1},
+        {0, 1, 2, 3}
+    };
+    for (int n = 0; n < 4; n++) {
+        unsigned char *memory = &nametable_ram[layouts[mirroring][n] * 0x400];
+        ppu_pages[8 + n] = memory;
+        ppu_pages[12 + n] = memory;
+        ppu_page_writable[8 + n] = true;
+        ppu_page_writable[12 + n] = true;
+    }
+}
+
+void Mapper::map_ppu_pages() {
+    map_chr();
+    map_nametables();
+}
+
+Mapper_0::Mapper_0() {
+    chr_ram = false;
+    // Power-on RAM is not random here, so runs of the same ROM are repeatable
+    std::memset(cpu_memory, 0, sizeof(cpu_memory));
+    std::memset(chr_memory, 0, sizeof(chr_memory));
+    prg_rom = std::make_shared<std::vector<unsigned char>>(0x8000, 0);
+    prg = prg_rom->data();
+    rom_hash = 0;
+    map_chr();
+}
 
 void Mapper_0::cpu_mem_store(unsigned short int address, unsigned char value) {
     if (address < 0x2000) {
@@ -9,8 +134,9 @@ void Mapper_0::cpu_mem_store(unsigned short int address, unsigned char value) {
     else if (address < 0x4000) {
         // PPU registers mirroring
         cpu_memory[address % 8 + 0x2000] = value;
-    } 
-    else cpu_memory[address] = value;
+    }
+    // PRG-ROM cannot be written
+    else if (address < 0x8000) cpu_memory[address] = value;
 }
 
 unsigned char Mapper_0::cpu_mem(unsigned short int address) {
@@ -21,19 +147,172 @@ unsigned char Mapper_0::cpu_mem(unsigned short int address) {
     else if (address < 0x4000) {
         // PPU registers mirroring
         return cpu_memory[address % 8 + 0x2000];
-    } 
-    else return cpu_memory[address];
+    }
+    else if (address < 0x8000) return cpu_memory[address];
+    else return prg[address - 0x8000];
 }
 
-void Mapper_0::ppu_mem_store(unsigned short int address, unsigned char value) {
-    return;
+Mapper *Mapper_0::copy() {
+    Mapper_0 *cartridge = new Mapper_0(*this);
+    // The copy gets its own tile cache from its PPU, and its pages still point in here
+    cartridge->tile_cache = nullptr;
+    cartridge->map_ppu_pages();
+    return cartridge;
 }
 
-unsigned char Mapper_0::ppu_mem(unsigned short int address) {
-    return 0;
+// PRG-ROM as mapped at $8000-$FFFF, then the CHR-ROM if there is one.
+unsigned long long int Mapper_0::get_rom_hash() {
+    return rom_hash;
 }
 
+void Mapper_0::update_rom_hash() {
+    rom_hash = hash_bytes(prg, 0x8000);
+    if (chr_rom != nullptr) rom_hash = hash_bytes(chr_rom->data(), chr_rom->size(), rom_hash);
+}
 
+// Pattern tables are only writable on boards with CHR-RAM. Without CHR loaded they show
+// the empty CHR-RAM.
+void Mapper_0::map_chr() {
+    bool rom = !chr_ram and chr_rom != nullptr;
+    for (int page = 0; page < 8; page++) {
+        map_chr_page(page, rom ? &(*chr_rom)[page * 0x400] : &chr_memory[page * 0x400], chr_ram);
+    }
+}
 
+// Loading makes new ROM rather than writing the one copies share.
+void Mapper_0::load_prg(const unsigned char *data, unsigned int size) {
+    prg_rom = std::make_shared<std::vector<unsigned char>>(0x8000, 0);
+    prg = prg_rom->data();
+    // 16KB images are mirrored into both halves of $8000-$FFFF
+    std::memcpy(prg, data, size > 0x8000 ? 0x8000 : size);
+    if (size <= 0x4000) std::memcpy(prg + 0x4000, data, size);
+    update_rom_hash();
+}
 
+// The whole CHR-ROM is kept, for boards that switch banks of it.
+void Mapper_0::load_chr(const unsigned char *data, unsigned int size) {
+    if (size == 0) {
+        // No CHR-ROM on the cartridge means 8KB of CHR-RAM
+        chr_ram = true;
+        chr_rom = nullptr;
+        std::memset(chr_memory, 0, 0x2000);
+    }
+    else {
+        chr_rom = std::make_shared<std::vector<unsigned char>>(data, data + size);
+        if (chr_rom->size() < 0x2000) chr_rom->resize(0x2000, 0);
+    }
+    update_rom_hash();
+    map_chr();
+}
+
+void Mapper_0::save_state(StateWriter &state) {
+    state.begin_section("CART");
+    Mapper::save_state(state);
+    save_ram(state);
+    state.end_section();
+}
+
+void Mapper_0::load_state(StateReader &state) {
+    state.begin_section("CART");
+    Mapper::load_state(state);
+    load_ram(state);
+    state.end_section();
+    map_ppu_pages();
+}
 
+void Mapper_0::check_state(StateReader &state) {
+    state.begin_section("CART");
+    Mapper::check_state(state);
+    check_ram(state);
+    state.end_section();
+}
+
+// Internal RAM, the PPU register bytes, $4000-$7FFF, which holds the work RAM, and CHR-RAM.
+// CHR-ROM comes with the game.
+void Mapper_0::save_ram(StateWriter &state) {
+    state.write_bytes(cpu_memory, 0x800);
+    state.write_bytes(&cpu_memory[0x2000], 8);
+    state.write_bytes(&cpu_memory[0x4000], 0x4000);
+    state.write_bool(chr_ram);
+    if (chr_ram) state.write_bytes(chr_memory, sizeof(chr_memory));
+}
+
+void Mapper_0::load_ram(StateReader &state) {
+    state.read_bytes(cpu_memory, 0x800);
+    state.read_bytes(&cpu_memory[0x2000], 8);
+    state.read_bytes(&cpu_memory[0x4000], 0x4000);
+    if (state.read_bool() != chr_ram) throw std::runtime_error("\nSave state is for another cartridge!");
+    if (chr_ram) state.read_bytes(chr_memory, sizeof(chr_memory));
+}
+
+void Mapper_0::check_ram(StateReader &state) {
+    state.skip_bytes(0x800 + 8 + 0x4000);
+    if (state.read_bool() != chr_ram) throw std::runtime_error("\nSave state is for another cartridge!");
+    if (chr_ram) state.skip_bytes(sizeof(chr_memory));
+}
+
+Mapper_3::Mapper_3() {
+    chr_bank = 0;
+}
+
+void Mapper_3::cpu_mem_store(unsigned short int address, unsigned char value) {
+    if (address < 0x8000) {
+        Mapper_0::cpu_mem_store(address, value);
+        return;
+    }
+    unsigned int banks = chr_rom == nullptr ? 0 : chr_rom->size() / 0x2000;
+    if (banks == 0) return;
+    unsigned int bank = value % banks;
+    if (bank == chr_bank) return;
+    chr_bank = bank;
+    map_chr();
+}
+
+Mapper *Mapper_3::copy() {
+    Mapper_3 *cartridge = new Mapper_3(*this);
+    cartridge->tile_cache = nullptr;
+    cartridge->map_ppu_pages();
+    return cartridge;
+}
+
+// CHR-ROM is read only. Before load_chr() the pages stay on the empty CHR of Mapper_0.
+void Mapper_3::map_chr() {
+    if (chr_rom == nullptr) {
+        Mapper_0::map_chr();
+        return;
+    }
+    for (int page = 0; page < 8; page++) map_chr_page(page, &(*chr_rom)[chr_bank * 0x2000 + page * 0x400], false);
+}
+
+void Mapper_3::load_chr(const unsigned char *data, unsigned int size) {
+    chr_bank = 0;
+    Mapper_0::load_chr(data, size);
+}
+
+void Mapper_3::save_state(StateWriter &state) {
+    state.begin_section("CART");
+    Mapper::save_state(state);
+    save_ram(state);
+    state.write_u32(chr_bank);
+    state.end_section();
+}
+
+void Mapper_3::load_state(StateReader &state) {
+    state.begin_section("CART");
+    Mapper::load_state(state);
+    load_ram(state);
+    unsigned int bank = state.read_u32();
+    if (bank != 0 and (chr_rom == nullptr or bank >= chr_rom->size() / 0x2000)) throw std::runtime_error("\nSave state is for another cartridge!");
+    chr_bank = bank;
+    state.end_section();
+    map_ppu_pages();
+}
+
+void Mapper_3::check_state(StateReader &state) {
+    state.begin_section("CART");
+    Mapper::check_state(state);
+    check_ram(state);
+    unsigned int bank = state.read_u32();
+    if (bank != 0 and (chr_rom == nullptr or bank >= chr_rom->size() / 0x2000)) throw std::runtime_error("\nSave state is for another cartridge!");
+    state.end_section();
+}
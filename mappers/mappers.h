@@ -1,24 +1,118 @@
 #ifndef MAPPERS_H
 #define MAPPERS_H
 
+#include <memory>
+#include <vector>
+
+class TileCache;
+class StateWriter;
+class StateReader;
+
+enum Mirroring {
+    MIRRORING_HORIZONTAL,
+    MIRRORING_VERTICAL,
+    // Every nametable shows the first or the second 1KB of nametable RAM
+    MIRRORING_SINGLE_LOW,
+    MIRRORING_SINGLE_HIGH,
+    // Four separate nametables, with 2KB of extra RAM on the cartridge
+    MIRRORING_FOUR_SCREEN
+};
+
 class Mapper {
     public:
+        Mapper();
+        virtual ~Mapper();
         virtual void cpu_mem_store(unsigned short int address, unsigned char value) = 0;
         virtual unsigned char cpu_mem(unsigned short int address) = 0;
-        virtual void ppu_mem_store(unsigned short int address, unsigned char value) = 0;
-        virtual unsigned char ppu_mem(unsigned short int address) = 0;
+        // The PPU bus goes through the page table, without asking the mapper.
+        void ppu_mem_store(unsigned short int address, unsigned char value);
+        unsigned char ppu_mem(unsigned short int address);
+        // 16 pointers to the 1KB pages of $0000-$3FFF. The table itself never moves.
+        unsigned char *const *get_ppu_pages();
+        // A new cartridge in the same state.
+        virtual Mapper *copy() = 0;
+        // Boards that count PPU scanlines (MMC3-style A12 clocking) return true here; the PPU
+        // then calls ppu_scanline() at dot 260 of every rendered line and wakes up for it.
+        virtual bool observes_ppu();
+        virtual void ppu_scanline();
+        void attach_tile_cache(TileCache *cache);
+        void set_mirroring(Mirroring mirroring);
+        Mirroring get_mirroring();
+        // The cartridge's RAM, registers and banks, not its ROM: a state only loads into a
+        // cartridge of the same kind holding the same game.
+        virtual void save_state(StateWriter &state);
+        virtual void load_state(StateReader &state);
+        // Reads the state as load_state() would and throws where it would, changing nothing.
+        virtual void check_state(StateReader &state);
+        // Tells games apart, for files that belong to one, such as save states and input
+        // movies. 0 when the board does not know its ROM.
+        virtual unsigned long long int get_rom_hash();
+
+    protected:
+        TileCache *tile_cache;
+        Mirroring mirroring;
+        unsigned char *ppu_pages[16];
+        bool ppu_page_writable[16];
+        unsigned char nametable_ram[0x1000];
+        // Points the pattern table pages at the current CHR banks, invalidating them.
+        virtual void map_chr() = 0;
+        void map_chr_page(int page, unsigned char *memory, bool writable);
+        void map_nametables();
+        // Sets up every page again, after a copy.
+        void map_ppu_pages();
+        // Must be called whenever a byte of the visible pattern tables changes (CHR-RAM writes).
+        void chr_written(unsigned short int address);
+        // Must be called whenever a CHR bank switch remaps [address, address + size) of the pattern tables.
+        void chr_bank_switched(unsigned short int address, unsigned short int size);
 };
 
 class Mapper_0: public Mapper {
     public:
+        Mapper_0();
         void cpu_mem_store(unsigned short int address, unsigned char value);
         unsigned char cpu_mem(unsigned short int address);
-        void ppu_mem_store(unsigned short int address, unsigned char value);
-        unsigned char ppu_mem(unsigned short int address);
+        Mapper *copy();
+        void load_prg(const unsigned char *data, unsigned int size);
+        virtual void load_chr(const unsigned char *data, unsigned int size);
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
+        void check_state(StateReader &state);
+        unsigned long long int get_rom_hash();
+
+    protected:
+        // $0000-$7FFF. The ROM is never written once loaded, so copies of the cartridge
+        // share it.
+        unsigned char cpu_memory[0x8000];
+        std::shared_ptr<std::vector<unsigned char>> prg_rom;
+        unsigned char *prg;
+        std::shared_ptr<std::vector<unsigned char>> chr_rom;
+        unsigned char chr_memory[0x2000];
+        bool chr_ram;
+        // Worked out whenever ROM is loaded, as states check it on every load
+        unsigned long long int rom_hash;
+        void update_rom_hash();
+        void map_chr();
+        void save_ram(StateWriter &state);
+        void load_ram(StateReader &state);
+        void check_ram(StateReader &state);
+};
+
+// CNROM: NROM PRG layout with switchable 8KB CHR-ROM banks selected by writes to $8000-$FFFF.
+class Mapper_3: public Mapper_0 {
+    public:
+        Mapper_3();
+        void cpu_mem_store(unsigned short int address, unsigned char value);
+        Mapper *copy();
+        void load_chr(const unsigned char *data, unsigned int size);
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
+        void check_state(StateReader &state);
+
+    protected:
+        void map_chr();
 
     private:
-        unsigned char cpu_memory[65536];
-        unsigned char ppu_memory[16384];
+        unsigned int chr_bank;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,167 @@
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "movie.h"
+#include "../util/hash.h"
+
+// Bytes read or written to the file at a time
+static const unsigned int BLOCK_SIZE = 0x10000;
+
+static double seconds_between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static unsigned long long int get_le(const unsigned char *bytes, int count) {
+    unsigned long long int value = 0;
+    for (int i = count - 1; i >= 0; i--) value = (value << 8) | bytes[i];
+    return value;
+}
+
+static void reset_movie_stats(MovieStats &stats) {
+    stats.frames = 0;
+    stats.hashes = 0;
+    stats.desync_frame = -1;
+    stats.hash_seconds = 0;
+    stats.file_seconds = 0;
+}
+
+// Saves the state into the buffer given and hashes it.
+static unsigned long long int hash_state(Emulator *emulator, std::vector<unsigned char> &state) {
+    unsigned int size = emulator->save_state(state.data(), state.size());
+    return hash_bytes(state.data(), size);
+}
+
+MovieRecorder::MovieRecorder(const char *path, Emulator *emulator, unsigned int hash_interval) {
+    MovieRecorder::emulator = emulator;
+    MovieRecorder::path = path;
+    MovieRecorder::hash_interval = hash_interval;
+    reset_movie_stats(stats);
+    file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file) throw std::runtime_error(std::string("\n") + path + " cannot be opened!");
+    state.resize(emulator->get_state_size());
+    unsigned int size = emulator->save_state(state.data(), state.size());
+    buffer.reserve(BLOCK_SIZE + state.size());
+    buffer.insert(buffer.end(), {'B', 'N', 'M', 'V'});
+    put(MOVIE_VERSION, 2);
+    put(0, 2);
+    put(emulator->get_rom_hash(), 8);
+    put(hash_interval, 4);
+    put(size, 4);
+    buffer.insert(buffer.end(), state.begin(), state.begin() + size);
+    flush();
+}
+
+MovieRecorder::~MovieRecorder() {
+    // Errors were for flush() to report
+    file.write((const char *) buffer.data(), buffer.size());
+}
+
+void MovieRecorder::run_frame(bool render) {
+    ControllerPorts &controllers = emulator->get_controllers();
+    bool held = controllers.get_held();
+    controllers.set_held(false);
+    controllers.poll(emulator->get_cpu().get_cycles());
+    controllers.set_held(true);
+    buffer.push_back(controllers.get_buttons(0));
+    buffer.push_back(controllers.get_buttons(1));
+    emulator->run_frame(render);
+    controllers.set_held(held);
+    stats.frames++;
+    if (hash_interval > 0 and stats.frames % hash_interval == 0) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        put(hash_state(emulator, state), 8);
+        stats.hashes++;
+        stats.hash_seconds += seconds_between(start, std::chrono::steady_clock::now());
+    }
+    if (buffer.size() >= BLOCK_SIZE) flush();
+}
+
+void MovieRecorder::flush() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    file.write((const char *) buffer.data(), buffer.size());
+    file.flush();
+    buffer.clear();
+    stats.file_seconds += seconds_between(start, std::chrono::steady_clock::now());
+    if (!file) throw std::runtime_error("\n" + path + " cannot be written!");
+}
+
+MovieStats MovieRecorder::get_stats() {
+    return stats;
+}
+
+void MovieRecorder::put(unsigned long long int value, int bytes) {
+    for (int i = 0; i < bytes; i++) buffer.push_back((value >> (8 * i)) & 0xFF);
+}
+
+MoviePlayer::MoviePlayer(const char *path, Emulator *emulator) {
+    MoviePlayer::emulator = emulator;
+    reset_movie_stats(stats);
+    file.open(path, std::ios::binary | std::ios::in);
+    if (!file) throw std::runtime_error(std::string("\n") + path + " cannot be opened!");
+    buffer.resize(BLOCK_SIZE);
+    position = 0;
+    end = 0;
+    unsigned char header[24];
+    if (!take(header, sizeof(header)) or std::memcmp(header, "BNMV", 4) != 0) {
+        throw std::runtime_error(std::string("\n") + path + " is not a movie!");
+    }
+    if (get_le(header + 4, 2) != MOVIE_VERSION) throw std::runtime_error("\nMovie is from another version!");
+    if (get_le(header + 8, 8) != emulator->get_rom_hash()) throw std::runtime_error("\nMovie is of another game!");
+    hash_interval = get_le(header + 16, 4);
+    unsigned int size = get_le(header + 20, 4);
+    state.resize(size > emulator->get_state_size() ? size : emulator->get_state_size());
+    if (!take(state.data(), size)) throw std::runtime_error(std::string("\n") + path + " is cut short!");
+    emulator->load_state(state.data(), size);
+    ControllerPorts &controllers = emulator->get_controllers();
+    held = controllers.get_held();
+    // Queued input would only get in the way of the movie's
+    controllers.set_held(true);
+}
+
+MoviePlayer::~MoviePlayer() {
+    emulator->get_controllers().set_held(held);
+}
+
+bool MoviePlayer::run_frame(bool render) {
+    unsigned char buttons[2];
+    if (stats.desync_frame >= 0 or !take(buttons, 2)) return false;
+    ControllerPorts &controllers = emulator->get_controllers();
+    controllers.set_buttons(0, buttons[0]);
+    controllers.set_buttons(1, buttons[1]);
+    emulator->run_frame(render);
+    stats.frames++;
+    if (hash_interval > 0 and stats.frames % hash_interval == 0) {
+        unsigned char expected[8];
+        // A recording stopped before its hash still played in sync up to there
+        if (!take(expected, 8)) return true;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (hash_state(emulator, state) != get_le(expected, 8)) stats.desync_frame = stats.frames - 1;
+        stats.hashes++;
+        stats.hash_seconds += seconds_between(start, std::chrono::steady_clock::now());
+    }
+    return true;
+}
+
+MovieStats MoviePlayer::get_stats() {
+    return stats;
+}
+
+bool MoviePlayer::take(unsigned char *data, unsigned int size) {
+    while (size > 0) {
+        if (position == end) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            file.read((char *) buffer.data(), buffer.size());
+            end = file.gcount();
+            position = 0;
+            stats.file_seconds += seconds_between(start, std::chrono::steady_clock::now());
+            if (end == 0) return false;
+        }
+        unsigned int count = end - position < size ? end - position : size;
+        std::memcpy(data, &buffer[position], count);
+        data += count;
+        position += count;
+        size -= count;
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../emulator/emulator.h"
+
+// Input movies are a header followed by one record per frame:
+//   "BNMV", u16 format version, u16 flags (0), u64 ROM hash, u32 hash interval,
+//   u32 size of the start state, the start state
+//   per frame: u8 buttons of port 0, u8 buttons of port 1, and after every hash interval
+//   frames the u64 hash of the state the frame ended in
+// Little-endian, as save states are. A movie replays exactly from its start state, as the
+// buttons only change between frames.
+static const unsigned short int MOVIE_VERSION = 1;
+
+// What a movie recorded or checked so far.
+struct MovieStats {
+    unsigned long long int frames;
+    // State hashes written, or compared on playback
+    unsigned long long int hashes;
+    // The frame whose state hash first did not match the recording, -1 while in sync; the
+    // desync itself happened within the hash interval before
+    long long int desync_frame;
+    // Saving and hashing states, and reading or writing the file
+    double hash_seconds;
+    double file_seconds;
+};
+
+// Records the buttons of every frame of emulator from its current state on. Records are
+// buffered and written in large blocks, so a frame costs two bytes of a buffer besides
+// the state hash every hash interval frames.
+class MovieRecorder {
+    public:
+        // emulator stays the caller's. A hash interval of 0 writes no hashes.
+        MovieRecorder(const char *path, Emulator *emulator, unsigned int hash_interval = 60);
+        ~MovieRecorder();
+        // Applies the controller events queued so far and holds the buttons through the
+        // frame, so it replays from them alone.
+        void run_frame(bool render = true);
+        // Writes out what is buffered, throwing if the file cannot be written.
+        void flush();
+        MovieStats get_stats();
+
+    private:
+        Emulator *emulator;
+        std::ofstream file;
+        std::string path;
+        std::vector<unsigned char> buffer;
+        std::vector<unsigned char> state;
+        unsigned int hash_interval;
+        MovieStats stats;
+        void put(unsigned long long int value, int bytes);
+};
+
+// Plays a movie back into emulator, reading the file a block at a time as it goes. Every
+// state hash in it is checked, so a desync shows within a hash interval of happening.
+class MoviePlayer {
+    public:
+        // Loads the start state into emulator, throwing if the movie is not one or is of
+        // another game.
+        MoviePlayer(const char *path, Emulator *emulator);
+        ~MoviePlayer();
+        // Runs the next frame with its buttons. Returns false, without running one, at the
+        // end of the movie or once a state hash did not match.
+        bool run_frame(bool render = true);
+        MovieStats get_stats();
+
+    private:
+        Emulator *emulator;
+        std::ifstream file;
+        std::vector<unsigned char> buffer;
+        unsigned int position;
+        unsigned int end;
+        std::vector<unsigned char> state;
+        unsigned int hash_interval;
+        bool held;
+        MovieStats stats;
+        // Copies size bytes out of the file, false if it ends first.
+        bool take(unsigned char *data, unsigned int size);
+};
+
+#endif
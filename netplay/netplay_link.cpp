@@ -0,0 +1,57 @@
+#include <cstring>
+#include "netplay_link.h"
+
+NetplayLink::NetplayLink(UdpSocket *socket, unsigned int seed) : random(seed) {
+    NetplayLink::socket = socket;
+    conditions = {0, 0, 0};
+    stats = {0, 0, 0};
+}
+
+void NetplayLink::set_conditions(const LinkConditions &conditions) {
+    NetplayLink::conditions = conditions;
+}
+
+LinkConditions NetplayLink::get_conditions() {
+    return conditions;
+}
+
+void NetplayLink::send(const unsigned char *data, unsigned int size) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    stats.sent++;
+    if (uniform(random) < conditions.loss) {
+        stats.dropped++;
+        return;
+    }
+    double delay = conditions.latency_seconds + conditions.jitter_seconds * uniform(random);
+    Datagram datagram;
+    datagram.due = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(delay));
+    datagram.size = size < MAX_DATAGRAM ? size : MAX_DATAGRAM;
+    std::memcpy(datagram.data, data, datagram.size);
+    held.push_back(datagram);
+    update();
+}
+
+unsigned int NetplayLink::receive(unsigned char *data, unsigned int capacity) {
+    update();
+    unsigned int size = socket->receive(data, capacity);
+    if (size > 0) stats.received++;
+    return size;
+}
+
+// Due datagrams go out in the order they fell due.
+void NetplayLink::update() {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (true) {
+        unsigned int first = held.size();
+        for (unsigned int i = 0; i < held.size(); i++) {
+            if (held[i].due <= now and (first == held.size() or held[i].due < held[first].due)) first = i;
+        }
+        if (first == held.size()) return;
+        if (!socket->send(held[first].data, held[first].size)) stats.dropped++;
+        held.erase(held.begin() + first);
+    }
+}
+
+LinkStats NetplayLink::get_stats() {
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef NETPLAY_LINK_H
+#define NETPLAY_LINK_H
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "udp_socket.h"
+
+// Latency, jitter and loss put on what a link sends.
+struct LinkConditions {
+    double latency_seconds;
+    // Each datagram waits up to this much longer, at random, so they can arrive out of order
+    double jitter_seconds;
+    // Share of the datagrams dropped, from 0 to 1
+    double loss;
+};
+
+struct LinkStats {
+    unsigned long long int sent;
+    unsigned long long int received;
+    // Dropped by the conditions, or refused by the socket
+    unsigned long long int dropped;
+};
+
+// The socket netplay talks through. Datagrams sent are held back as the conditions say
+// before they go out, so two links over loopback behave like a distant network. Held ones
+// go out whenever the link is used, so the latency is rounded up to how often that is.
+class NetplayLink {
+    public:
+        static const unsigned int MAX_DATAGRAM = 512;
+        // socket stays the caller's. The same seed gives the same jitter and losses.
+        NetplayLink(UdpSocket *socket, unsigned int seed = 1);
+        void set_conditions(const LinkConditions &conditions);
+        LinkConditions get_conditions();
+        // Datagrams over MAX_DATAGRAM bytes are cut.
+        void send(const unsigned char *data, unsigned int size);
+        // Sends what is due, then returns the size of the next datagram, 0 if none is waiting.
+        unsigned int receive(unsigned char *data, unsigned int capacity);
+        void update();
+        LinkStats get_stats();
+
+    private:
+        struct Datagram {
+            std::chrono::steady_clock::time_point due;
+            unsigned int size;
+            unsigned char data[MAX_DATAGRAM];
+        };
+        UdpSocket *socket;
+        LinkConditions conditions;
+        std::mt19937 random;
+        std::vector<Datagram> held;
+        LinkStats stats;
+};
+
+#endif
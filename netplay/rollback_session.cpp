@@ -0,0 +1,210 @@
+#include <chrono>
+#include <cstring>
+#include "rollback_session.h"
+#include "../util/hash.h"
+
+// Packets: "BNNP", u32 the next remote frame whose input is wanted, u32 the first frame of
+// the inputs, u8 how many, u32 frame and u64 hash of the sender's latest confirmed state
+// (frame 0 for none), then one byte of buttons per frame. Little-endian.
+static const unsigned int PACKET_HEADER = 25;
+
+static double seconds_between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void put_le(unsigned char *bytes, unsigned long long int value, int count) {
+    for (int i = 0; i < count; i++) bytes[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static unsigned long long int get_le(const unsigned char *bytes, int count) {
+    unsigned long long int value = 0;
+    for (int i = count - 1; i >= 0; i--) value = (value << 8) | bytes[i];
+    return value;
+}
+
+RollbackSession::RollbackSession(Emulator *emulator, NetplayLink *link, int local_port, int input_delay, int max_rollback) {
+    RollbackSession::emulator = emulator;
+    RollbackSession::link = link;
+    RollbackSession::local_port = local_port & 1;
+    RollbackSession::input_delay = input_delay < 0 ? 0 : input_delay > 8 ? 8 : input_delay;
+    RollbackSession::max_rollback = max_rollback < 1 ? 1 : max_rollback > MAX_ROLLBACK ? MAX_ROLLBACK : max_rollback;
+    frame = 0;
+    // Nobody gives buttons for the frames before the delay
+    local_end = RollbackSession::input_delay;
+    remote_end = RollbackSession::input_delay;
+    remote_ack = RollbackSession::input_delay;
+    std::memset(local_inputs, 0, sizeof(local_inputs));
+    std::memset(remote_inputs, 0, sizeof(remote_inputs));
+    std::memset(used_inputs, 0, sizeof(used_inputs));
+    state_size = emulator->get_state_size();
+    states.resize(RollbackSession::max_rollback + 1, std::vector<unsigned char>(state_size));
+    for (unsigned int slot = 0; slot < HASH_RING; slot++) hash_frames[slot] = 0;
+    next_hash_frame = HASH_INTERVAL;
+    remote_hash_frame = 0;
+    remote_hash = 0;
+    checked_hash_frame = 0;
+    ControllerPorts &controllers = emulator->get_controllers();
+    held = controllers.get_held();
+    // The buttons are the session's; queued input would only get in the way
+    controllers.set_held(true);
+    reset_stats();
+}
+
+RollbackSession::~RollbackSession() {
+    emulator->get_controllers().set_held(held);
+}
+
+bool RollbackSession::run_frame(unsigned char buttons, bool render) {
+    unsigned long long int wrong = receive_packets();
+    if (wrong < frame) roll_back(wrong);
+    hash_confirmed();
+    // One more frame and its state would no longer be kept for a rollback to it
+    if (frame >= remote_end + max_rollback) {
+        stats.stalls++;
+        send_packet();
+        return false;
+    }
+    local_inputs[local_end % INPUT_RING] = buttons;
+    local_end++;
+    send_packet();
+    run_one(render);
+    stats.frames++;
+    return true;
+}
+
+void RollbackSession::poll() {
+    unsigned long long int wrong = receive_packets();
+    if (wrong < frame) roll_back(wrong);
+    hash_confirmed();
+    send_packet();
+}
+
+unsigned long long int RollbackSession::get_frame() {
+    return frame;
+}
+
+unsigned long long int RollbackSession::get_confirmed_frame() {
+    return remote_end < frame ? remote_end : frame;
+}
+
+RollbackStats RollbackSession::get_stats() {
+    return stats;
+}
+
+void RollbackSession::reset_stats() {
+    stats.frames = 0;
+    stats.stalls = 0;
+    stats.rollbacks = 0;
+    stats.rolled_back_frames = 0;
+    stats.worst_depth = 0;
+    stats.resimulation_seconds = 0;
+    stats.worst_resimulation_seconds = 0;
+    stats.save_seconds = 0;
+    stats.packets_sent = 0;
+    stats.packets_received = 0;
+    stats.hashes_checked = 0;
+    stats.desync_frame = -1;
+}
+
+// Resends every input the remote has not acknowledged yet.
+void RollbackSession::send_packet() {
+    unsigned char packet[NetplayLink::MAX_DATAGRAM];
+    unsigned long long int count = local_end - remote_ack;
+    if (count > 255) count = 255;
+    std::memcpy(packet, "BNNP", 4);
+    put_le(packet + 4, remote_end, 4);
+    put_le(packet + 8, remote_ack, 4);
+    packet[12] = count;
+    unsigned long long int hash_frame = next_hash_frame - HASH_INTERVAL;
+    put_le(packet + 13, hash_frame, 4);
+    put_le(packet + 17, hash_frame == 0 ? 0 : hashes[hash_frame / HASH_INTERVAL % HASH_RING], 8);
+    for (unsigned int i = 0; i < count; i++) packet[PACKET_HEADER + i] = local_inputs[(remote_ack + i) % INPUT_RING];
+    link->send(packet, PACKET_HEADER + count);
+    stats.packets_sent++;
+}
+
+// Inputs only count once every frame before them is known, so a packet arriving before an
+// earlier one adds nothing the next one will not resend.
+unsigned long long int RollbackSession::receive_packets() {
+    unsigned long long int wrong = frame;
+    unsigned char packet[NetplayLink::MAX_DATAGRAM];
+    unsigned int size;
+    while ((size = link->receive(packet, sizeof(packet))) > 0) {
+        if (size < PACKET_HEADER or std::memcmp(packet, "BNNP", 4) != 0 or size < PACKET_HEADER + packet[12]) continue;
+        stats.packets_received++;
+        unsigned long long int ack = get_le(packet + 4, 4);
+        if (ack > remote_ack and ack <= local_end) remote_ack = ack;
+        unsigned long long int hash_frame = get_le(packet + 13, 4);
+        if (hash_frame > remote_hash_frame) {
+            remote_hash_frame = hash_frame;
+            remote_hash = get_le(packet + 17, 8);
+        }
+        unsigned long long int first = get_le(packet + 8, 4);
+        for (unsigned int i = 0; i < packet[12]; i++) {
+            if (first + i != remote_end) continue;
+            unsigned char buttons = packet[PACKET_HEADER + i];
+            remote_inputs[remote_end % INPUT_RING] = buttons;
+            if (remote_end < frame and remote_end < wrong and used_inputs[remote_end % INPUT_RING] != buttons) wrong = remote_end;
+            remote_end++;
+        }
+    }
+    return wrong;
+}
+
+void RollbackSession::roll_back(unsigned long long int to) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int depth = frame - to;
+    unsigned long long int end = frame;
+    emulator->load_state(states[to % states.size()].data(), state_size);
+    frame = to;
+    APU &apu = emulator->get_apu();
+    bool sound = apu.get_sound();
+    apu.set_sound(false);
+    while (frame < end) run_one(false);
+    apu.set_sound(sound);
+    double seconds = seconds_between(start, std::chrono::steady_clock::now());
+    stats.rollbacks++;
+    stats.rolled_back_frames += depth;
+    if (depth > stats.worst_depth) stats.worst_depth = depth;
+    stats.resimulation_seconds += seconds;
+    if (seconds > stats.worst_resimulation_seconds) stats.worst_resimulation_seconds = seconds;
+}
+
+void RollbackSession::run_one(bool render) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    emulator->save_state(states[frame % states.size()].data(), state_size);
+    stats.save_seconds += seconds_between(start, std::chrono::steady_clock::now());
+    unsigned char remote = remote_input(frame);
+    used_inputs[frame % INPUT_RING] = remote;
+    ControllerPorts &controllers = emulator->get_controllers();
+    controllers.set_buttons(local_port, local_inputs[frame % INPUT_RING]);
+    controllers.set_buttons(1 - local_port, remote);
+    emulator->run_frame(render);
+    frame++;
+}
+
+unsigned char RollbackSession::remote_input(unsigned long long int frame) {
+    if (frame < remote_end) return remote_inputs[frame % INPUT_RING];
+    return remote_end > 0 ? remote_inputs[(remote_end - 1) % INPUT_RING] : 0;
+}
+
+// The state before frame n is final once the inputs of every frame before it are known.
+// It is still kept then: a frame runs at most max_rollback past the remote inputs.
+void RollbackSession::hash_confirmed() {
+    while (next_hash_frame < frame and next_hash_frame <= remote_end) {
+        unsigned int slot = next_hash_frame / HASH_INTERVAL % HASH_RING;
+        hash_frames[slot] = next_hash_frame;
+        hashes[slot] = hash_bytes(states[next_hash_frame % states.size()].data(), state_size);
+        next_hash_frame += HASH_INTERVAL;
+    }
+    check_remote_hash();
+}
+
+void RollbackSession::check_remote_hash() {
+    if (remote_hash_frame == 0 or remote_hash_frame == checked_hash_frame) return;
+    unsigned int slot = remote_hash_frame / HASH_INTERVAL % HASH_RING;
+    if (hash_frames[slot] != remote_hash_frame) return;
+    checked_hash_frame = remote_hash_frame;
+    stats.hashes_checked++;
+    if (hashes[slot] != remote_hash and stats.desync_frame < 0) stats.desync_frame = remote_hash_frame;
+}
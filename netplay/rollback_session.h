@@ -0,0 +1,101 @@
+#ifndef ROLLBACK_SESSION_H
+#define ROLLBACK_SESSION_H
+
+#include <vector>
+#include "netplay_link.h"
+#include "../emulator/emulator.h"
+
+// What a rollback session did since its stats were last reset.
+struct RollbackStats {
+    unsigned long long int frames;
+    // Host frames where the session waited for the remote player instead of running
+    unsigned long long int stalls;
+    // Remote input that came in different from its prediction sends the emulation back to
+    // the first frame it changes, then runs it forward again headless
+    unsigned long long int rollbacks;
+    unsigned long long int rolled_back_frames;
+    int worst_depth;
+    // Loading the state and running the frames again, per host frame that rolled back
+    double resimulation_seconds;
+    double worst_resimulation_seconds;
+    // Saving the state before every frame
+    double save_seconds;
+    unsigned long long int packets_sent;
+    unsigned long long int packets_received;
+    // State hashes of confirmed frames compared with the remote's
+    unsigned long long int hashes_checked;
+    // The first frame whose state differed from the remote's, -1 while in sync
+    long long int desync_frame;
+};
+
+// Two-player netplay with rollback. Each frame runs at once on the local player's buttons
+// and a prediction of the remote's: the last ones known. Inputs go both ways in every
+// packet until acknowledged, so lost and reordered packets do no harm. When the remote's
+// real buttons turn out different from the prediction, the state saved before that frame
+// is loaded and the frames since run again headless and silent within the host frame. The
+// session stalls instead of running more than max_rollback frames past the last remote
+// input it has. Both sides must use the same input delay and start from the same state.
+// Every HASH_INTERVAL frames, the hashes of the states both inputs are known for are
+// compared to catch desyncs.
+class RollbackSession {
+    public:
+        static const int MAX_ROLLBACK = 16;
+        static const unsigned int HASH_INTERVAL = 30;
+        // emulator and link stay the caller's. local_port is the local player's controller
+        // port. Their buttons take effect input_delay frames after they are given.
+        RollbackSession(Emulator *emulator, NetplayLink *link, int local_port, int input_delay = 1, int max_rollback = 8);
+        ~RollbackSession();
+        // Runs the next frame, or returns false and stalls when the remote player is too far
+        // behind. A stalled frame's buttons are dropped.
+        bool run_frame(unsigned char buttons, bool render = true);
+        // Exchanges packets and rolls back if needed, without running a frame.
+        void poll();
+        // Frames run so far, and how many of them both players' inputs are known for.
+        unsigned long long int get_frame();
+        unsigned long long int get_confirmed_frame();
+        RollbackStats get_stats();
+        void reset_stats();
+
+    private:
+        // Inputs and hashes kept, by frame modulo the size
+        static const unsigned int INPUT_RING = 128;
+        static const unsigned int HASH_RING = 8;
+        Emulator *emulator;
+        NetplayLink *link;
+        int local_port;
+        int input_delay;
+        int max_rollback;
+        unsigned long long int frame;
+        // Local inputs are known before local_end, remote ones before remote_end; the
+        // remote has acknowledged ours before remote_ack
+        unsigned long long int local_end;
+        unsigned long long int remote_end;
+        unsigned long long int remote_ack;
+        unsigned char local_inputs[INPUT_RING];
+        unsigned char remote_inputs[INPUT_RING];
+        // The remote input each frame was last run with
+        unsigned char used_inputs[INPUT_RING];
+        // The state before each of the last max_rollback + 1 frames
+        std::vector<std::vector<unsigned char>> states;
+        unsigned int state_size;
+        // Hashes of the states before every HASH_INTERVAL-th frame, and the next one due
+        unsigned long long int hash_frames[HASH_RING];
+        unsigned long long int hashes[HASH_RING];
+        unsigned long long int next_hash_frame;
+        unsigned long long int remote_hash_frame;
+        unsigned long long int remote_hash;
+        unsigned long long int checked_hash_frame;
+        bool held;
+        RollbackStats stats;
+        void send_packet();
+        // Takes in the packets waiting; returns the first frame run with a wrong prediction,
+        // or frame if none was.
+        unsigned long long int receive_packets();
+        void roll_back(unsigned long long int to);
+        void run_one(bool render);
+        unsigned char remote_input(unsigned long long int frame);
+        void hash_confirmed();
+        void check_remote_hash();
+};
+
+#endif
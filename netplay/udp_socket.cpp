@@ -0,0 +1,66 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "udp_socket.h"
+
+static sockaddr_in make_address(unsigned int address, unsigned short int port) {
+    sockaddr_in result = {};
+    result.sin_family = AF_INET;
+    result.sin_addr.s_addr = address;
+    result.sin_port = htons(port);
+    return result;
+}
+
+static unsigned int parse_address(const char *address) {
+    in_addr parsed;
+    if (inet_pton(AF_INET, address, &parsed) != 1) throw std::runtime_error(std::string("\n") + address + " is not an IPv4 address!");
+    return parsed.s_addr;
+}
+
+UdpSocket::UdpSocket(unsigned short int port, const char *address) {
+    descriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    if (descriptor < 0) throw std::runtime_error("\nUDP socket cannot be created!");
+    sockaddr_in local = make_address(parse_address(address), port);
+    if (bind(descriptor, (sockaddr *) &local, sizeof(local)) != 0 or fcntl(descriptor, F_SETFL, O_NONBLOCK) != 0) {
+        close(descriptor);
+        throw std::runtime_error("\nUDP socket cannot be bound to port " + std::to_string(port) + "!");
+    }
+    socklen_t length = sizeof(local);
+    getsockname(descriptor, (sockaddr *) &local, &length);
+    UdpSocket::port = ntohs(local.sin_port);
+    peer_address = 0;
+    peer_port = 0;
+}
+
+UdpSocket::~UdpSocket() {
+    close(descriptor);
+}
+
+unsigned short int UdpSocket::get_port() {
+    return port;
+}
+
+void UdpSocket::set_peer(const char *address, unsigned short int port) {
+    peer_address = parse_address(address);
+    peer_port = port;
+}
+
+bool UdpSocket::send(const unsigned char *data, unsigned int size) {
+    sockaddr_in peer = make_address(peer_address, peer_port);
+    return sendto(descriptor, data, size, 0, (sockaddr *) &peer, sizeof(peer)) == (long int) size;
+}
+
+// Datagrams from anyone but the peer are dropped.
+unsigned int UdpSocket::receive(unsigned char *data, unsigned int capacity) {
+    while (true) {
+        sockaddr_in sender;
+        socklen_t length = sizeof(sender);
+        long int size = recvfrom(descriptor, data, capacity, 0, (sockaddr *) &sender, &length);
+        if (size < 0) return 0;
+        if (sender.sin_addr.s_addr == peer_address and ntohs(sender.sin_port) == peer_port) return size;
+    }
+}
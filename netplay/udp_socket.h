@@ -0,0 +1,24 @@
+#ifndef UDP_SOCKET_H
+#define UDP_SOCKET_H
+
+// A non-blocking IPv4 UDP socket talking to one peer.
+class UdpSocket {
+    public:
+        // Binds to port on address, or to a free port with 0. Throws if it cannot.
+        UdpSocket(unsigned short int port = 0, const char *address = "127.0.0.1");
+        ~UdpSocket();
+        unsigned short int get_port();
+        void set_peer(const char *address, unsigned short int port);
+        // Returns false if the datagram could not go out; UDP makes no promise it arrives.
+        bool send(const unsigned char *data, unsigned int size);
+        // Returns the size of the next datagram from the peer, 0 when there is none waiting.
+        unsigned int receive(unsigned char *data, unsigned int capacity);
+
+    private:
+        int descriptor;
+        unsigned short int port;
+        unsigned int peer_address;
+        unsigned short int peer_port;
+};
+
+#endif
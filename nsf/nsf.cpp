@@ -0,0 +1,226 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "nsf.h"
+#include "../state/state.h"
+
+static const double CPU_CLOCK_RATE = 1789773.0;
+
+// NTSC frame period, for files that leave the play rate out
+static const unsigned short int DEFAULT_PLAY_PERIOD = 16639;
+
+// The idle loop: JMP $4100
+static const unsigned char idle_loop[3] = {0x4C, 0x00, 0x41};
+
+static unsigned short int read_word(const unsigned char *bytes) {
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static std::string read_text(const unsigned char *bytes) {
+    return std::string((const char *) bytes, strnlen((const char *) bytes, 32));
+}
+
+Mapper_NSF::Mapper_NSF(const NSFInfo &info, const unsigned char *data, unsigned int size) {
+    // Banked data starts at the load address's offset in its bank; the rest is laid out
+    // as it would be in the address space
+    unsigned int padding = info.banked ? info.load_address & 0x0FFF : info.load_address - 0x8000;
+    rom.assign(padding, 0);
+    rom.insert(rom.end(), data, data + size);
+    unsigned int rounded = (rom.size() + 0x0FFF) & ~0x0FFF;
+    rom.resize(rounded < 0x8000 ? 0x8000 : rounded, 0);
+    for (int n = 0; n < 8; n++) initial_banks[n] = info.banked ? info.initial_banks[n] : n;
+    reset();
+    map_chr();
+}
+
+void Mapper_NSF::reset() {
+    std::memset(ram, 0, sizeof(ram));
+    std::memset(work_ram, 0, sizeof(work_ram));
+    for (int n = 0; n < 8; n++) banks[n] = initial_banks[n] % (rom.size() / 0x1000);
+}
+
+void Mapper_NSF::cpu_mem_store(unsigned short int address, unsigned char value) {
+    if (address < 0x2000) ram[address % 0x800] = value;
+    else if (address >= 0x5FF8 and address <= 0x5FFF) banks[address - 0x5FF8] = value % (rom.size() / 0x1000);
+    else if (address >= 0x6000 and address < 0x8000) work_ram[address - 0x6000] = value;
+}
+
+unsigned char Mapper_NSF::cpu_mem(unsigned short int address) {
+    if (address < 0x2000) return ram[address % 0x800];
+    if (address >= IDLE_ADDRESS and address < IDLE_ADDRESS + 3) return idle_loop[address - IDLE_ADDRESS];
+    if (address >= 0x6000 and address < 0x8000) return work_ram[address - 0x6000];
+    if (address >= 0x8000) return rom[banks[(address - 0x8000) >> 12] * 0x1000 + (address & 0x0FFF)];
+    return 0;
+}
+
+Mapper *Mapper_NSF::copy() {
+    Mapper_NSF *cartridge = new Mapper_NSF(*this);
+    cartridge->tile_cache = nullptr;
+    cartridge->map_ppu_pages();
+    return cartridge;
+}
+
+void Mapper_NSF::save_state(StateWriter &state) {
+    state.begin_section("CART");
+    Mapper::save_state(state);
+    state.write_bytes(ram, sizeof(ram));
+    state.write_bytes(work_ram, sizeof(work_ram));
+    for (unsigned int bank : banks) state.write_u32(bank);
+    state.end_section();
+}
+
+void Mapper_NSF::load_state(StateReader &state) {
+    state.begin_section("CART");
+    Mapper::load_state(state);
+    state.read_bytes(ram, sizeof(ram));
+    state.read_bytes(work_ram, sizeof(work_ram));
+    for (unsigned int &bank : banks) {
+        bank = state.read_u32();
+        if (bank >= rom.size() / 0x1000) throw std::runtime_error("\nSave state is for another cartridge!");
+    }
+    state.end_section();
+    map_ppu_pages();
+}
+
+// There is no PPU on the bus; the pattern table pages just read zeroes.
+void Mapper_NSF::map_chr() {
+    for (int page = 0; page < 8; page++) map_chr_page(page, &nametable_ram[0], false);
+}
+
+NSFPlayer::NSFPlayer(const std::vector<unsigned char> &image, int sample_rate) : audio(APU::SAMPLE_RATE, sample_rate) {
+    info = nsf_parse(image);
+    mapper = new Mapper_NSF(info, &image[0x80], image.size() - 0x80);
+    cpu = new CPU(mapper);
+    apu = new APU(mapper);
+    cpu->connect_apu(apu);
+    play_cycles = (unsigned long long int) (info.play_period * CPU_CLOCK_RATE / 1000000.0);
+    start_track(info.starting_song);
+}
+
+NSFPlayer::~NSFPlayer() {
+    delete cpu;
+    delete apu;
+    delete mapper;
+}
+
+const NSFInfo &NSFPlayer::get_info() {
+    return info;
+}
+
+// Sets the machine up as the NSF specification asks before calling init: cleared RAM,
+// silent APU registers with all four tone channels enabled, frame IRQs off.
+void NSFPlayer::start_track(int track) {
+    mapper->reset();
+    cpu->reset();
+    apu->reset();
+    audio.clear();
+    pending.clear();
+    pending_start = 0;
+    apu->catch_up(cpu->get_cycles());
+    for (unsigned short int address = 0x4000; address <= 0x4013; address++) apu->write_register(address, 0);
+    apu->write_register(0x4015, 0x0F);
+    apu->write_register(0x4017, 0x40);
+
+    // Init is expected to return; one that runs on is left to run in place of play calls
+    call(info.init_address, track, 0);
+    unsigned long long int limit = cpu->get_cycles() + (unsigned long long int) CPU_CLOCK_RATE;
+    while (cpu->get_PC() != Mapper_NSF::IDLE_ADDRESS and cpu->get_cycles() < limit) step();
+    next_play = cpu->get_cycles();
+}
+
+void NSFPlayer::render(short int *output, int count) {
+    while (count > 0) {
+        if (pending_start == pending.size()) {
+            pending.clear();
+            pending_start = 0;
+            play_period();
+            continue;
+        }
+        int available = pending.size() - pending_start;
+        int copied = available < count ? available : count;
+        std::memcpy(output, &pending[pending_start], copied * sizeof(short int));
+        pending_start += copied;
+        output += copied;
+        count -= copied;
+    }
+}
+
+unsigned long long int NSFPlayer::get_cycles() {
+    return cpu->get_cycles();
+}
+
+void NSFPlayer::call(unsigned short int address, unsigned char a, unsigned char x) {
+    cpu->call(address, Mapper_NSF::IDLE_ADDRESS, a, x);
+}
+
+// One instruction. The APU is caught up lazily, as in the emulator.
+void NSFPlayer::step() {
+    cpu->run_next_instruction();
+    if (cpu->get_cycles() >= apu->next_event_cycle()) apu->catch_up(cpu->get_cycles());
+    cpu->stall(apu->take_stall_cycles());
+}
+
+// Runs the current routine up to cycle, or idles the CPU there once the routine returns.
+void NSFPlayer::run_until(unsigned long long int cycle) {
+    while (cpu->get_cycles() < cycle) {
+        if (cpu->get_PC() == Mapper_NSF::IDLE_ADDRESS) {
+            cpu->stall(cycle - cpu->get_cycles());
+            break;
+        }
+        step();
+    }
+}
+
+// Calls play, unless the last call is still running, and plays until the next call is
+// due. The samples of the period are resampled onto the end of pending.
+void NSFPlayer::play_period() {
+    if (cpu->get_PC() == Mapper_NSF::IDLE_ADDRESS) call(info.play_address, 0, 0);
+    next_play += play_cycles;
+    run_until(next_play);
+    apu->end_frame(cpu->get_cycles());
+
+    int count = apu->samples_available();
+    if ((int) apu_samples.size() < count) apu_samples.resize(count);
+    apu->read_samples(apu_samples.data(), count);
+    int capacity = (long long int) count * audio.get_output_rate() / audio.get_input_rate() + 16;
+    unsigned int start = pending.size();
+    pending.resize(start + capacity);
+    int written = audio.convert(apu_samples.data(), count, &pending[start], capacity);
+    pending.resize(start + written);
+}
+
+NSFInfo nsf_parse(const std::vector<unsigned char> &image) {
+    const unsigned char *header = image.data();
+    if (image.size() <= 0x80 or std::memcmp(header, "NESM\x1A", 5) != 0) {
+        throw std::runtime_error("\nNot an NSF file!");
+    }
+    NSFInfo info;
+    info.songs = header[0x06];
+    info.starting_song = header[0x07] > 0 ? header[0x07] - 1 : 0;
+    info.load_address = read_word(&header[0x08]);
+    info.init_address = read_word(&header[0x0A]);
+    info.play_address = read_word(&header[0x0C]);
+    info.name = read_text(&header[0x0E]);
+    info.artist = read_text(&header[0x2E]);
+    info.copyright = read_text(&header[0x4E]);
+    info.play_period = read_word(&header[0x6E]);
+    if (info.play_period == 0) info.play_period = DEFAULT_PLAY_PERIOD;
+    info.banked = false;
+    for (int n = 0; n < 8; n++) {
+        info.initial_banks[n] = header[0x70 + n];
+        if (info.initial_banks[n] != 0) info.banked = true;
+    }
+    info.expansion = header[0x7B];
+    if (!info.banked and info.load_address < 0x8000) {
+        throw std::runtime_error("\nNSF data below $8000 needs bank switching!");
+    }
+    return info;
+}
+
+std::vector<unsigned char> nsf_read(const char *path) {
+    std::ifstream infile;
+    infile.open(path, std::ios::binary | std::ios::in);
+    if (!infile) throw std::runtime_error(std::string("\n") + path + " cannot be opened!");
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+}
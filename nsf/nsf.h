@@ -0,0 +1,95 @@
+#ifndef NSF_H
+#define NSF_H
+
+#include <string>
+#include <vector>
+#include "../mappers/mappers.h"
+#include "../cpu/cpu.h"
+#include "../apu/apu.h"
+#include "../audio/audio.h"
+
+// The header of an NSF file, with the addresses of its routines.
+struct NSFInfo {
+    std::string name;
+    std::string artist;
+    std::string copyright;
+    int songs;
+    // 0-based, unlike in the file
+    int starting_song;
+    unsigned short int load_address;
+    unsigned short int init_address;
+    unsigned short int play_address;
+    // Microseconds between calls to the play routine on NTSC
+    unsigned short int play_period;
+    bool banked;
+    unsigned char initial_banks[8];
+    // Expansion sound chips the file asks for; their sound is not emulated
+    unsigned char expansion;
+};
+
+// The NSF board: 2KB of RAM, 8KB of work RAM at $6000-$7FFF and the music data at
+// $8000-$FFFF in eight 4KB banks, switched by writes to $5FF8-$5FFF. Files that do not
+// bank get the data in place from the load address. $4100-$4102 hold the player's idle
+// loop, which the routines return to.
+class Mapper_NSF: public Mapper {
+    public:
+        static const unsigned short int IDLE_ADDRESS = 0x4100;
+        Mapper_NSF(const NSFInfo &info, const unsigned char *data, unsigned int size);
+        void cpu_mem_store(unsigned short int address, unsigned char value);
+        unsigned char cpu_mem(unsigned short int address);
+        Mapper *copy();
+        // Clears both RAMs and puts the banks back as the header has them.
+        void reset();
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
+
+    protected:
+        void map_chr();
+
+    private:
+        std::vector<unsigned char> rom;
+        unsigned char initial_banks[8];
+        unsigned int banks[8];
+        unsigned char ram[0x800];
+        unsigned char work_ram[0x2000];
+};
+
+// Plays the tracks of an NSF file on the CPU and the APU alone. The init routine is
+// called when a track starts and the play routine at the rate the header asks for, each
+// time the previous call has returned; in between the CPU idles without running
+// instructions. Sound comes out at the chosen rate through AudioOutput.
+class NSFPlayer {
+    public:
+        NSFPlayer(const std::vector<unsigned char> &image, int sample_rate = 48000);
+        ~NSFPlayer();
+        const NSFInfo &get_info();
+        // track is 0-based.
+        void start_track(int track);
+        // Plays on until count samples are written to output.
+        void render(short int *output, int count);
+        unsigned long long int get_cycles();
+
+    private:
+        NSFInfo info;
+        Mapper_NSF *mapper;
+        CPU *cpu;
+        APU *apu;
+        AudioOutput audio;
+        unsigned long long int play_cycles;
+        unsigned long long int next_play;
+        std::vector<short int> apu_samples;
+        std::vector<short int> pending;
+        unsigned int pending_start;
+        void call(unsigned short int address, unsigned char a, unsigned char x);
+        void step();
+        void run_until(unsigned long long int cycle);
+        void play_period();
+};
+
+// Reads the header of an NSF image, throwing if it is not one.
+NSFInfo nsf_parse(const std::vector<unsigned char> &image);
+
+// Reads an NSF file, throwing if it cannot.
+std::vector<unsigned char> nsf_read(const char *path);
+
+#endif
@@ -0,0 +1,161 @@
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nsf.h"
+#include "../audio/wav_writer.h"
+
+namespace {
+
+struct Track {
+    std::string path;
+    // Shared by all the tracks of a file; players only read it
+    const std::vector<unsigned char> *image;
+    int track;
+    std::string output;
+};
+
+struct Options {
+    int threads;
+    double seconds;
+    int sample_rate;
+    std::string directory;
+};
+
+std::mutex print_lock;
+
+// The file name without its directory and extension.
+std::string stem(const std::string &path) {
+    std::string::size_type slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    std::string::size_type dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+bool render_track(const Track &track, const Options &options) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try {
+        NSFPlayer player(*track.image, options.sample_rate);
+        player.start_track(track.track);
+        WavWriter wav(track.output.c_str(), options.sample_rate);
+        std::vector<short int> samples(options.sample_rate / 10);
+        long long int remaining = (long long int) (options.seconds * options.sample_rate);
+        while (remaining > 0) {
+            int count = remaining < (long long int) samples.size() ? remaining : samples.size();
+            player.render(samples.data(), count);
+            wav.write(samples.data(), count);
+            remaining -= count;
+        }
+        wav.close();
+    }
+    catch (const std::runtime_error &error) {
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cerr << track.path << " track " << track.track + 1 << ": " << error.what() << std::endl;
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> guard(print_lock);
+    std::cout << track.output << ": " << seconds << " s, " << options.seconds / seconds << "x real time" << std::endl;
+    return true;
+}
+
+void usage(const char *program) {
+    std::cerr << "usage: " << program << " [-j threads] [-t seconds] [-r rate] [-o directory] file.nsf[:track] ..." << std::endl;
+    std::cerr << "  Renders every track of each file, or only the given 1-based track, to WAV files" << std::endl;
+    std::cerr << "  named after the file and the track, several tracks at a time." << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    options.threads = std::thread::hardware_concurrency();
+    if (options.threads < 1) options.threads = 1;
+    options.seconds = 150;
+    options.sample_rate = 48000;
+    options.directory = ".";
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' and i + 1 < argc) {
+            if (std::strcmp(argv[i], "-j") == 0) options.threads = std::atoi(argv[++i]);
+            else if (std::strcmp(argv[i], "-t") == 0) options.seconds = std::atof(argv[++i]);
+            else if (std::strcmp(argv[i], "-r") == 0) options.sample_rate = std::atoi(argv[++i]);
+            else if (std::strcmp(argv[i], "-o") == 0) options.directory = argv[++i];
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else files.push_back(argv[i]);
+    }
+    // Tracks render a tenth of a second at a time, which must be a sample at least
+    if (files.empty() or options.threads < 1 or options.seconds <= 0 or options.sample_rate < 10) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Every file is read once, up front, so a bad one is reported before any rendering
+    std::vector<std::vector<unsigned char>> images(files.size());
+    std::vector<Track> tracks;
+    for (unsigned int f = 0; f < files.size(); f++) {
+        std::string path = files[f];
+        // The 1-based track given, 0 for every track
+        int only = 0;
+        std::string::size_type colon = path.find_last_of(':');
+        if (colon != std::string::npos and colon + 1 < path.size() and std::isdigit((unsigned char) path[colon + 1])) {
+            only = std::atoi(path.c_str() + colon + 1);
+            path = path.substr(0, colon);
+            if (only < 1) {
+                std::cerr << path << ": tracks are numbered from 1" << std::endl;
+                return 1;
+            }
+        }
+        NSFInfo info;
+        try {
+            images[f] = nsf_read(path.c_str());
+            info = nsf_parse(images[f]);
+        }
+        catch (const std::runtime_error &error) {
+            std::cerr << path << ": " << error.what() << std::endl;
+            return 1;
+        }
+        if (only > info.songs) {
+            std::cerr << path << ": there is no track " << only << ", only " << info.songs << std::endl;
+            return 1;
+        }
+        std::cout << path << ": " << info.name << " - " << info.artist << ", " << info.songs << " tracks"
+                  << (info.expansion ? " (expansion sound not emulated)" : "") << std::endl;
+        for (int track = 0; track < info.songs; track++) {
+            if (only > 0 and track != only - 1) continue;
+            std::string number = std::to_string(track + 1);
+            if (number.size() < 2) number = "0" + number;
+            tracks.push_back({path, &images[f], track, options.directory + "/" + stem(path) + "-" + number + ".wav"});
+        }
+    }
+
+    // Workers take the next track until none are left
+    std::atomic<unsigned int> next(0);
+    std::atomic<unsigned int> failures(0);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    int threads = (unsigned int) options.threads < tracks.size() ? options.threads : tracks.size();
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            for (unsigned int i = next++; i < tracks.size(); i = next++) {
+                if (!render_track(tracks[i], options)) failures++;
+            }
+        }));
+    }
+    for (std::thread &worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << tracks.size() - failures << " tracks in " << seconds << " s on " << threads << " threads, "
+              << tracks.size() * options.seconds / seconds << "x real time" << std::endl;
+    return failures > 0 ? 1 : 0;
+}
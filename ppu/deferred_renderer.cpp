@@ -0,0 +1,111 @@
+#include <cstring>
+#include "deferred_renderer.h"
+#include "../state/state.h"
+
+DeferredRenderer::DeferredRenderer(PPU &ppu, Mapper *mapper) : ppu(ppu) {
+    replica_mapper = mapper->copy();
+    replica = new PPU(replica_mapper);
+    replica->copy_state(ppu);
+    replica->set_headless(false);
+    std::memcpy(frame_buffers[0], ppu.get_frame_buffer(), sizeof(frame_buffers[0]));
+    finished_buffer = 0;
+    shown_buffer = 0;
+    busy = false;
+    stopping = false;
+    ppu.set_log(&recording);
+    ppu.set_headless(true);
+    worker = std::thread(&DeferredRenderer::run, this);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+    ppu.set_log(nullptr);
+    ppu.set_headless(false);
+    delete replica;
+    delete replica_mapper;
+}
+
+void DeferredRenderer::submit_frame(unsigned long long int end_cycle, bool render) {
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait(guard, [this] { return !busy; });
+    shown_buffer = finished_buffer;
+    // The PPU keeps appending to recording, so only the contents change hands
+    std::swap(recording, pending);
+    recording.events.clear();
+    recording.oam_pages.clear();
+    pending_end_cycle = end_cycle;
+    pending_render = render;
+    busy = true;
+    guard.unlock();
+    wake.notify_all();
+}
+
+void DeferredRenderer::finish() {
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait(guard, [this] { return !busy; });
+    shown_buffer = finished_buffer;
+}
+
+const unsigned short int *DeferredRenderer::get_frame_buffer() {
+    return frame_buffers[shown_buffer];
+}
+
+void DeferredRenderer::load_state(const unsigned char *buffer, unsigned int size) {
+    StateReader state(buffer, size);
+    // The emulator already checked the game
+    state.read_header();
+    state.skip_section("CPU ");
+    replica_mapper->load_state(state);
+    replica->load_state(state);
+    // Accesses logged before the load belong to a frame that will not be submitted
+    recording.events.clear();
+    recording.oam_pages.clear();
+}
+
+void DeferredRenderer::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this] { return busy or stopping; });
+        if (stopping) return;
+        // submit_frame() does not touch pending or the buffer being drawn while busy
+        guard.unlock();
+        replica->set_headless(!pending_render);
+        replay(pending, pending_end_cycle);
+        int buffer = 1 - shown_buffer;
+        if (pending_render) std::memcpy(frame_buffers[buffer], replica->get_frame_buffer(), sizeof(frame_buffers[buffer]));
+        guard.lock();
+        if (pending_render) finished_buffer = buffer;
+        busy = false;
+        wake.notify_all();
+    }
+}
+
+// Makes the same calls on the replica, at the same cycles, as the CPU made on the PPU.
+void DeferredRenderer::replay(const PPULog &log, unsigned long long int end_cycle) {
+    unsigned int oam_page = 0;
+    for (const PPUEvent &event : log.events) {
+        replica->catch_up(event.cpu_cycle);
+        switch (event.kind) {
+            case PPU_EVENT_WRITE:
+                replica->write_register(event.address, event.value);
+                break;
+            case PPU_EVENT_READ:
+                if (event.address % 8 == 2) replica->read_status(event.cpu_cycle);
+                else replica->read_register(event.address);
+                break;
+            case PPU_EVENT_OAM_DMA:
+                replica->oam_dma(&log.oam_pages[oam_page * 256]);
+                oam_page++;
+                break;
+            case PPU_EVENT_MAPPER_WRITE:
+                replica_mapper->cpu_mem_store(event.address, event.value);
+                break;
+        }
+    }
+    replica->catch_up(end_cycle);
+}
@@ -0,0 +1,51 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "ppu.h"
+
+// Draws frames on a worker thread. The emulated PPU runs headless and logs every access
+// the CPU makes; at the end of each frame the log goes to the worker, which replays it on
+// a replica PPU with its own copy of the cartridge and draws the frame there, while the
+// CPU thread goes on with the next one.
+class DeferredRenderer {
+    public:
+        // Starts from the current state of ppu and mapper.
+        DeferredRenderer(PPU &ppu, Mapper *mapper);
+        ~DeferredRenderer();
+        // Hands the frame that ended at end_cycle to the worker, once it is done with the
+        // previous one.
+        void submit_frame(unsigned long long int end_cycle, bool render);
+        // Waits for the worker to finish the last submitted frame.
+        void finish();
+        // The last frame finished before the latest submit_frame() or finish(), valid until
+        // the next submit_frame().
+        const unsigned short int *get_frame_buffer();
+        // Puts the replica in the state the emulator just loaded, after finish(). The frame
+        // buffers keep the last frame drawn.
+        void load_state(const unsigned char *buffer, unsigned int size);
+
+    private:
+        PPU &ppu;
+        Mapper *replica_mapper;
+        PPU *replica;
+        PPULog recording;
+        PPULog pending;
+        unsigned long long int pending_end_cycle;
+        bool pending_render;
+        bool busy;
+        bool stopping;
+        // The worker draws into one buffer while the other is shown
+        unsigned short int frame_buffers[2][256 * 240];
+        int finished_buffer;
+        int shown_buffer;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::thread worker;
+        void run();
+        void replay(const PPULog &log, unsigned long long int end_cycle);
+};
+
+#endif
@@ -1,3 +1,847 @@
-struct PPU {
-    unsigned char memory[16384];
-}
\ No newline at end of file
+#include <cstring>
+#include "ppu.h"
+#include "../state/state.h"
+
+static const unsigned long long int NEVER = ~0ULL;
+
+PPU::PPU(Mapper *mapper) : tile_cache(mapper) {
+    PPU::mapper = mapper;
+    mapper_observes_ppu = mapper->observes_ppu();
+    ppu_pages = mapper->get_ppu_pages();
+    mapper->attach_tile_cache(&tile_cache);
+    sprite_limit = true;
+    headless = false;
+    flag_prediction = true;
+    log = nullptr;
+    reset();
+}
+
+void PPU::reset() {
+    ctrl = 0;
+    mask = 0;
+    status = 0;
+    oam_addr = 0;
+    read_buffer = 0;
+    open_bus = 0;
+    v = 0;
+    t = 0;
+    x = 0;
+    w = false;
+    nmi_line = false;
+    odd_frame = false;
+    scanline = 0;
+    dot = 0;
+    clock = 0;
+    frame = 0;
+    catch_ups = 0;
+    flag_mismatches = 0;
+    vblank_read_clock = 0;
+    sprite0_clock = NEVER;
+    overflow_clock = NEVER;
+    prediction_valid_until = 0;
+    prediction_generation = 0;
+    prediction_dirty = true;
+    rendered_x = 0;
+    sprites_evaluated = false;
+    fast_lines = 0;
+    slow_lines = 0;
+    line_stats.fast_lines = 0;
+    line_stats.slow_lines = 0;
+    std::memset(oam, 0xFF, sizeof(oam));
+    line_sprites_height = 0;
+    line_sprites_dirty = true;
+    std::memset(palette, 0, sizeof(palette));
+    std::memset(frame_buffer, 0, sizeof(frame_buffer));
+}
+
+// Advances the PPU by one dot. Scanlines 0-239 are visible, 241-260 are vertical blank
+// and 261 is the pre-render line. A visible line is composed when its last pixel is
+// output, at dot 256.
+void PPU::tick() {
+    if (scanline < 240) {
+        if (dot == 256) {
+            if (!flag_prediction and rendering_enabled()) render_overflow();
+            if (rendered_x == 0) fast_lines++;
+            else slow_lines++;
+            render_pixels(256);
+            rendered_x = 0;
+            sprites_evaluated = false;
+            if (rendering_enabled()) increment_y(v);
+        }
+        else if (dot == 257 and rendering_enabled()) copy_x(v);
+        else if (dot == 260 and mapper_observes_ppu and rendering_enabled()) mapper->ppu_scanline();
+    }
+    else if (scanline == 241 and dot == 1) {
+        // Unless a $2002 read at this very dot or later already cleared it
+        if (vblank_read_clock <= clock) status = status | 0x80;
+        frame++;
+        line_stats.fast_lines = fast_lines;
+        line_stats.slow_lines = slow_lines;
+        fast_lines = 0;
+        slow_lines = 0;
+        if (ctrl & 0x80) nmi_line = true;
+    }
+    else if (scanline == 261) {
+        if (dot == 1) {
+            status = status & 0x1F;
+            if (sprite0_clock < clock) sprite0_clock = NEVER;
+            if (overflow_clock < clock) overflow_clock = NEVER;
+        }
+        else if (dot == 257 and rendering_enabled()) copy_x(v);
+        else if (dot == 260 and mapper_observes_ppu and rendering_enabled()) mapper->ppu_scanline();
+        else if (dot == 304 and rendering_enabled()) copy_y(v);
+    }
+
+    clock++;
+    dot++;
+    // The last dot of the pre-render line is skipped on odd frames while rendering
+    if (scanline == 261 and dot == 340 and odd_frame and rendering_enabled()) dot = 341;
+    if (dot > 340) {
+        dot = 0;
+        scanline++;
+        if (scanline > 261) {
+            scanline = 0;
+            odd_frame = !odd_frame;
+        }
+    }
+}
+
+// Brings the PPU up to the given CPU cycle. Instead of ticking every dot it jumps straight
+// to the next dot where tick() does something, so the result is the same as lockstep.
+void PPU::catch_up(unsigned long long int cpu_cycle) {
+    unsigned long long int target = cpu_cycle * 3;
+    if (clock >= target) return;
+    catch_ups++;
+    while (clock < target) {
+        int event = next_event_dot();
+        if (clock + (event - dot) >= target) {
+            dot += target - clock;
+            clock = target;
+            return;
+        }
+        clock += event - dot;
+        dot = event;
+        tick();
+    }
+}
+
+// Earliest CPU cycle at which catching up would produce something the CPU can observe
+// without touching a PPU register: the start of vertical blank (NMI and the end of a
+// frame) and, for mappers that observe the PPU, the next scanline clock.
+unsigned long long int PPU::next_event_cycle() {
+    unsigned long long int event = next_clock_at(241, 1);
+    if (mapper_observes_ppu) {
+        // May be early on lines that are not rendered, which only costs an extra catch-up
+        unsigned long long int scanline_event = clock + (dot <= 260 ? 260 - dot : 341 - dot + 260);
+        if (scanline_event < event) event = scanline_event;
+    }
+    return (event + 1 + 2) / 3;
+}
+
+// Clock at which the PPU will next be at (line, line_dot), counting the skipped dot of an
+// odd frame. Rendering cannot be switched on or off without catching up first, so the
+// current PPUMASK decides the skip.
+unsigned long long int PPU::next_clock_at(int line, int line_dot) {
+    long long int distance = (line * 341 + line_dot) - (scanline * 341 + dot);
+    if (distance < 0) {
+        distance += 262 * 341;
+        if (odd_frame and rendering_enabled() and scanline * 341 + dot <= 261 * 341 + 339) distance--;
+    }
+    return clock + distance;
+}
+
+// $2002 read at the given CPU cycle. Only the part of the PPU that is behind the CPU is
+// looked at: vertical blank comes from the timing of the frame and the sprite 0 hit and
+// overflow flags from their predicted clocks, so nothing has to be rendered. With the
+// prediction off, the PPU must be caught up and the flags come from the pixels drawn so
+// far; the prediction is still made and counted as a mismatch if it disagrees.
+unsigned char PPU::read_status(unsigned long long int cpu_cycle) {
+    if (log != nullptr) log_event(cpu_cycle, PPU_EVENT_READ, 0x2002, 0);
+    unsigned long long int target = cpu_cycle * 3;
+    if (target < clock) target = clock;
+    if (!flag_prediction) split_line();
+
+    // An event at clock c is visible to reads at any later clock
+    bool vblank = status & 0x80;
+    unsigned long long int vblank_set = next_clock_at(241, 1);
+    unsigned long long int vblank_clear = next_clock_at(261, 1);
+    if (vblank_set < vblank_clear) {
+        if (vblank_set < target and vblank_read_clock <= vblank_set) vblank = true;
+        if (vblank_clear < target) vblank = false;
+    }
+    else {
+        if (vblank_clear < target) vblank = false;
+        if (vblank_set < target and vblank_read_clock <= vblank_set) vblank = true;
+    }
+
+    if (prediction_dirty or target > prediction_valid_until or tile_cache.get_generation() != prediction_generation) {
+        predict_flags(target);
+    }
+
+    unsigned char value = (open_bus & 0x1F);
+    if (vblank) value = value | 0x80;
+    unsigned char predicted = 0;
+    if (sprite0_clock < target) predicted = predicted | 0x40;
+    if (overflow_clock < target) predicted = predicted | 0x20;
+    if (flag_prediction) value = value | predicted;
+    else {
+        if (predicted != (status & 0x60)) flag_mismatches++;
+        value = value | (status & 0x60);
+    }
+    status = status & 0x7F;
+    vblank_read_clock = target;
+    w = false;
+    open_bus = value;
+    return value;
+}
+
+// Works out when sprite 0 hit and sprite overflow will next be set by running a copy of
+// the scroll state forward from where the PPU is now, assuming no more register writes
+// (every write marks the prediction dirty). Sprite 0 hit is set at the dot its pixel is
+// output; overflow at the end of the evaluation on the line before the sprites appear.
+// The walk stops at the first flag clear (dot 1 of the pre-render line) after target.
+void PPU::predict_flags(unsigned long long int target) {
+    prediction_dirty = false;
+    prediction_generation = tile_cache.get_generation();
+
+    unsigned short int address = v;
+    int line = scanline;
+    int line_dot = dot;
+    int first_pixel = rendered_x;
+    bool odd = odd_frame;
+    bool rendering = rendering_enabled();
+    unsigned long long int position = clock;
+    // Flags already set before the PPU's position stay set until the next clear
+    if (sprite0_clock >= clock) sprite0_clock = NEVER;
+    if (overflow_clock >= clock) overflow_clock = NEVER;
+
+    int height = (ctrl & 0x20) ? 16 : 8;
+    int sprite0_top = oam[0] + 1;
+    bool hits_possible = (mask & 0x18) == 0x18;
+
+    while (true) {
+        if (line < 240 and rendering) {
+            if (line_dot <= 256) {
+                if (sprite0_clock == NEVER and hits_possible and line >= sprite0_top and line < sprite0_top + height) {
+                    unsigned long long int hit = sprite0_hit_dot(line, address, first_pixel, line_dot);
+                    if (hit != NEVER) sprite0_clock = position + (hit - line_dot);
+                }
+                if (overflow_clock == NEVER and line < 239 and sprites_on_line(line + 1) > 8) {
+                    overflow_clock = position + (256 - line_dot);
+                }
+                increment_y(address);
+            }
+            if (line_dot <= 257) copy_x(address);
+        }
+        else if (line == 261) {
+            if (line_dot <= 1) {
+                unsigned long long int clear = position + (1 - line_dot);
+                if (clear >= target) {
+                    prediction_valid_until = clear;
+                    return;
+                }
+                sprite0_clock = NEVER;
+                overflow_clock = NEVER;
+            }
+            if (rendering and line_dot <= 257) copy_x(address);
+            if (rendering and line_dot <= 304) copy_y(address);
+        }
+
+        int length = (line == 261 and odd and rendering) ? 340 : 341;
+        position += length - line_dot;
+        line_dot = 0;
+        first_pixel = 0;
+        line++;
+        if (line > 261) {
+            line = 0;
+            odd = !odd;
+        }
+    }
+}
+
+// Dot of the first sprite 0 hit on line at or after line_dot, or NEVER. address is v at
+// that point of the line and first_pixel the pixels the line had already drawn.
+unsigned long long int PPU::sprite0_hit_dot(int line, unsigned short int address, int first_pixel, int line_dot) {
+    int height = (ctrl & 0x20) ? 16 : 8;
+    int row = line - (oam[0] + 1);
+    unsigned char tile_number = oam[1];
+    unsigned char attributes = oam[2];
+    int sprite_x = oam[3];
+    if (attributes & 0x80) row = height - 1 - row;
+    unsigned short int tile;
+    if (height == 16) tile = ((tile_number & 0x01) << 8) + (tile_number & 0xFE) + (row >= 8);
+    else tile = ((ctrl & 0x08) ? 256 : 0) + tile_number;
+    const unsigned char *pixels = tile_cache.get_row(tile, row % 8);
+    unsigned short int pattern_table = (ctrl & 0x10) ? 256 : 0;
+
+    for (int column = 0; column < 8; column++) {
+        int px = sprite_x + column;
+        // No hit on the last pixel, on pixels already output or in clipped columns
+        if (px >= 255) break;
+        if (px + 1 < line_dot or px < first_pixel) continue;
+        if (px < 8 and (!(mask & 0x02) or !(mask & 0x04))) continue;
+        if (pixels[(attributes & 0x40) ? 7 - column : column] == 0) continue;
+        unsigned char fine_column = (px & 7) + x;
+        unsigned short int tile_address = address;
+        advance_x(tile_address, px / 8 - first_pixel / 8 + fine_column / 8);
+        if (background_pixel(tile_address, fine_column % 8, pattern_table) != 0) return px + 1;
+    }
+    return NEVER;
+}
+
+// Number of sprites in range of line, without the 8 sprite limit.
+int PPU::sprites_on_line(int line) {
+    return __builtin_popcountll(sprites_in_range(line));
+}
+
+// Bit n is set when sprite n covers line. The masks of all visible lines are rebuilt in one
+// pass over OAM whenever OAM or the sprite height changes, which for most games is the
+// $4014 DMA once per frame.
+unsigned long long int PPU::sprites_in_range(int line) {
+    int height = (ctrl & 0x20) ? 16 : 8;
+    if (line_sprites_height != height) {
+        line_sprites_height = height;
+        line_sprites_dirty = true;
+    }
+    if (line_sprites_dirty) {
+        line_sprites_dirty = false;
+        std::memset(line_sprites, 0, sizeof(line_sprites));
+        for (int n = 0; n < 64; n++) {
+            // Sprites are drawn one line below their OAM Y coordinate
+            int top = oam[n * 4] + 1;
+            for (int row = top; row < top + height and row < 240; row++) line_sprites[row] |= 1ULL << n;
+        }
+    }
+    return line_sprites[line];
+}
+
+// Drawing more than 8 sprites per line removes the flicker games use to work around the
+// limit. Sprite overflow is still set as on hardware.
+void PPU::set_sprite_limit(bool enabled) {
+    sprite_limit = enabled;
+}
+
+bool PPU::get_sprite_limit() {
+    return sprite_limit;
+}
+
+// With the prediction off, sprite 0 hit and overflow are set as the lines are drawn
+// instead, as a slower reference for it. $2002 reads then need the PPU caught up.
+void PPU::set_flag_prediction(bool enabled) {
+    flag_prediction = enabled;
+}
+
+bool PPU::get_flag_prediction() {
+    return flag_prediction;
+}
+
+// $2002 reads, with the prediction off, whose predicted flags differed from the drawn ones.
+unsigned long long int PPU::get_flag_mismatches() {
+    return flag_mismatches;
+}
+
+unsigned long long int PPU::get_catch_ups() {
+    return catch_ups;
+}
+
+unsigned char PPU::read_register(unsigned short int address) {
+    if (address % 8 != 2 and log != nullptr) log_event(clock / 3, PPU_EVENT_READ, address, 0);
+    switch (address % 8) {
+        case 2:
+            return read_status(clock / 3);
+        case 4:
+            open_bus = oam[oam_addr];
+            break;
+        case 7: {
+            split_line();
+            prediction_dirty = true;
+            unsigned short int vram_address = v % 0x4000;
+            if (vram_address < 0x3F00) {
+                open_bus = read_buffer;
+                read_buffer = bus_read(vram_address);
+            }
+            else {
+                // Palette reads are not buffered, but the buffer still gets the nametable byte below
+                open_bus = (open_bus & 0xC0) | (palette[palette_index(vram_address)] & 0x3F);
+                read_buffer = bus_read(vram_address - 0x1000);
+            }
+            v = (v + ((ctrl & 0x04) ? 32 : 1)) % 0x8000;
+            break;
+        }
+    }
+    return open_bus;
+}
+
+void PPU::write_register(unsigned short int address, unsigned char value) {
+    if (log != nullptr) log_event(clock / 3, PPU_EVENT_WRITE, address, value);
+    // Everything but PPUSTATUS and the OAM registers changes how the rest of a line is drawn
+    unsigned char reg = address % 8;
+    if (reg != 2 and reg != 3 and reg != 4) split_line();
+    if (reg != 2 and reg != 3) prediction_dirty = true;
+    open_bus = value;
+    switch (address % 8) {
+        case 0:
+            // Enabling NMI during vertical blank triggers it immediately
+            if (!(ctrl & 0x80) and (value & 0x80) and (status & 0x80)) nmi_line = true;
+            ctrl = value;
+            t = (t & 0xF3FF) | ((value & 0x03) << 10);
+            break;
+        case 1:
+            mask = value;
+            break;
+        case 3:
+            oam_addr = value;
+            break;
+        case 4:
+            oam[oam_addr] = value;
+            line_sprites_dirty = true;
+            oam_addr++;
+            break;
+        case 5:
+            if (!w) {
+                t = (t & 0xFFE0) | (value >> 3);
+                x = value & 0x07;
+            }
+            else t = (t & 0x8C1F) | ((value & 0x07) << 12) | ((value & 0xF8) << 2);
+            w = !w;
+            break;
+        case 6:
+            if (!w) t = (t & 0x80FF) | ((value & 0x3F) << 8);
+            else {
+                t = (t & 0xFF00) | value;
+                v = t;
+            }
+            w = !w;
+            break;
+        case 7: {
+            unsigned short int vram_address = v % 0x4000;
+            if (vram_address < 0x3F00) bus_write(vram_address, value);
+            else palette[palette_index(vram_address)] = value & 0x3F;
+            v = (v + ((ctrl & 0x04) ? 32 : 1)) % 0x8000;
+            break;
+        }
+    }
+}
+
+// OAM DMA ($4014): copies a 256 byte CPU page into OAM starting at OAMADDR.
+void PPU::oam_dma(const unsigned char *page) {
+    if (log != nullptr) {
+        log_event(clock / 3, PPU_EVENT_OAM_DMA, 0, 0);
+        log->oam_pages.insert(log->oam_pages.end(), page, page + 256);
+    }
+    prediction_dirty = true;
+    for (int i = 0; i < 256; i++) {
+        oam[oam_addr] = page[i];
+        oam_addr++;
+    }
+    line_sprites_dirty = true;
+}
+
+bool PPU::poll_nmi() {
+    bool value = nmi_line;
+    nmi_line = false;
+    return value;
+}
+
+// Next dot of the current line at which tick() has work to do; 340 ends the line.
+int PPU::next_event_dot() {
+    if (scanline < 240) {
+        if (dot <= 256) return 256;
+        if (dot == 257) return 257;
+        if (mapper_observes_ppu and dot <= 260) return 260;
+    }
+    else if (scanline == 241) {
+        if (dot <= 1) return 1;
+    }
+    else if (scanline == 261) {
+        if (dot <= 1) return 1;
+        if (dot <= 257) return 257;
+        if (mapper_observes_ppu and dot <= 260) return 260;
+        if (dot <= 304) return 304;
+        if (dot <= 339) return 339;
+    }
+    return 340;
+}
+
+int PPU::get_scanline() {
+    return scanline;
+}
+
+int PPU::get_dot() {
+    return dot;
+}
+
+unsigned long long int PPU::get_clock() {
+    return clock;
+}
+
+unsigned long long int PPU::get_frame() {
+    return frame;
+}
+
+LineStats PPU::get_line_stats() {
+    return line_stats;
+}
+
+const unsigned short int *PPU::get_frame_buffer() {
+    return frame_buffer;
+}
+
+TileCache &PPU::get_tile_cache() {
+    return tile_cache;
+}
+
+void PPU::record_mapper_write(unsigned short int address, unsigned char value) {
+    if (log != nullptr) log_event(clock / 3, PPU_EVENT_MAPPER_WRITE, address, value);
+}
+
+void PPU::set_log(PPULog *log) {
+    PPU::log = log;
+}
+
+void PPU::log_event(unsigned long long int cpu_cycle, PPUEventKind kind, unsigned short int address, unsigned char value) {
+    PPUEvent event;
+    event.cpu_cycle = cpu_cycle;
+    event.kind = kind;
+    event.address = address;
+    event.value = value;
+    log->events.push_back(event);
+}
+
+void PPU::copy_state(const PPU &other) {
+    Mapper *own_mapper = mapper;
+    unsigned char *const *own_pages = ppu_pages;
+    PPULog *own_log = log;
+    *this = other;
+    mapper = own_mapper;
+    ppu_pages = own_pages;
+    log = own_log;
+    // The copied tile cache decoded the other mapper's tiles
+    tile_cache = TileCache(mapper);
+}
+
+void PPU::save_state(StateWriter &state) {
+    state.begin_section("PPU ");
+    state.write_bytes(oam, sizeof(oam));
+    state.write_bytes(palette, sizeof(palette));
+    state.write_u8(ctrl);
+    state.write_u8(mask);
+    state.write_u8(status);
+    state.write_u8(oam_addr);
+    state.write_u8(read_buffer);
+    state.write_u8(open_bus);
+    state.write_u16(v);
+    state.write_u16(t);
+    state.write_u8(x);
+    state.write_bool(w);
+    state.write_bool(nmi_line);
+    state.write_bool(odd_frame);
+    state.write_u16(scanline);
+    state.write_u16(dot);
+    state.write_u64(clock);
+    state.write_u64(frame);
+    state.write_u64(vblank_read_clock);
+    // The predicted flags may already have been set this frame, so they are kept rather
+    // than predicted again from where the PPU is
+    state.write_u64(sprite0_clock);
+    state.write_u64(overflow_clock);
+    state.write_u64(prediction_valid_until);
+    state.write_bool(prediction_dirty or tile_cache.get_generation() != prediction_generation);
+    // A line the CPU split halfway keeps its sprites and the pixels drawn so far. Stale
+    // sprites are written as zeroes, so equal machines give equal states
+    static const unsigned char no_sprites[256] = {};
+    state.write_u16(rendered_x);
+    state.write_bool(sprites_evaluated);
+    state.write_bytes(sprites_evaluated ? sprite_line : no_sprites, sizeof(sprite_line));
+    state.end_section();
+}
+
+void PPU::load_state(StateReader &state) {
+    state.begin_section("PPU ");
+    state.read_bytes(oam, sizeof(oam));
+    state.read_bytes(palette, sizeof(palette));
+    ctrl = state.read_u8();
+    mask = state.read_u8();
+    status = state.read_u8();
+    oam_addr = state.read_u8();
+    read_buffer = state.read_u8();
+    open_bus = state.read_u8();
+    v = state.read_u16();
+    t = state.read_u16();
+    x = state.read_u8();
+    w = state.read_bool();
+    nmi_line = state.read_bool();
+    odd_frame = state.read_bool();
+    scanline = state.read_u16();
+    dot = state.read_u16();
+    clock = state.read_u64();
+    frame = state.read_u64();
+    vblank_read_clock = state.read_u64();
+    sprite0_clock = state.read_u64();
+    overflow_clock = state.read_u64();
+    prediction_valid_until = state.read_u64();
+    prediction_dirty = state.read_bool();
+    prediction_generation = tile_cache.get_generation();
+    rendered_x = state.read_u16();
+    sprites_evaluated = state.read_bool();
+    state.read_bytes(sprite_line, sizeof(sprite_line));
+    line_sprites_dirty = true;
+    state.end_section();
+}
+
+// Headless lines keep everything the CPU and the mapper can see (vertical blank, NMI,
+// sprite 0 hit and overflow, $2007 and the scanline clock) but skip drawing, leaving the
+// frame buffer as it was. It can be switched at any time, normally between frames.
+void PPU::set_headless(bool enabled) {
+    headless = enabled;
+}
+
+bool PPU::get_headless() {
+    return headless;
+}
+
+bool PPU::rendering_enabled() {
+    return (mask & 0x18) != 0;
+}
+
+unsigned char PPU::bus_read(unsigned short int address) {
+    return ppu_pages[(address >> 10) & 0x0F][address & 0x03FF];
+}
+
+void PPU::bus_write(unsigned short int address, unsigned char value) {
+    mapper->ppu_mem_store(address, value);
+}
+
+// $3F10/$3F14/$3F18/$3F1C mirror the backdrop entries of the background palettes.
+unsigned char PPU::palette_index(unsigned short int address) {
+    unsigned char index = address % 32;
+    if ((index & 0x13) == 0x10) index = index & 0x0F;
+    return index;
+}
+
+// The scroll helpers take the VRAM address to update, so the flag prediction can run them
+// on a copy of v.
+void PPU::increment_x(unsigned short int &address) {
+    if ((address & 0x001F) == 31) {
+        address = address & ~0x001F;
+        address = address ^ 0x0400;
+    }
+    else address++;
+}
+
+// Moves coarse X forward by count tiles, wrapping into the horizontally adjacent nametable.
+void PPU::advance_x(unsigned short int &address, int count) {
+    int coarse_x = (address & 0x001F) + count;
+    if ((coarse_x / 32) % 2) address = address ^ 0x0400;
+    address = (address & ~0x001F) | (coarse_x % 32);
+}
+
+void PPU::increment_y(unsigned short int &address) {
+    if ((address & 0x7000) != 0x7000) {
+        address += 0x1000;
+        return;
+    }
+    address = address & ~0x7000;
+    unsigned short int coarse_y = (address & 0x03E0) >> 5;
+    if (coarse_y == 29) {
+        coarse_y = 0;
+        address = address ^ 0x0800;
+    }
+    else if (coarse_y == 31) coarse_y = 0;
+    else coarse_y++;
+    address = (address & ~0x03E0) | (coarse_y << 5);
+}
+
+void PPU::copy_x(unsigned short int &address) {
+    address = (address & ~0x041F) | (t & 0x041F);
+}
+
+void PPU::copy_y(unsigned short int &address) {
+    address = (address & ~0x7BE0) | (t & 0x7BE0);
+}
+
+// Composes pixels [rendered_x, end) of the current line. A line drawn in one go takes the
+// tile-at-a-time path; once a mid-line register write has split it, the rest is drawn pixel
+// by pixel so the new state applies from the right pixel on.
+void PPU::render_pixels(int end) {
+    if (end <= rendered_x) return;
+    if (!flag_prediction) render_sprite0_hit(end);
+    if (headless) {
+        // Nothing is drawn, but v moves on a tile after every 8th pixel as it would
+        if (rendering_enabled()) advance_x(v, end / 8 - rendered_x / 8);
+    }
+    else if (rendered_x == 0 and end == 256) render_scanline();
+    else render_segment(end);
+    rendered_x = end;
+}
+
+// Called before a register access that changes how the rest of the line is drawn.
+void PPU::split_line() {
+    if (scanline < 240 and dot >= 2 and dot <= 256) render_pixels(dot - 1);
+}
+
+void PPU::render_scanline() {
+    unsigned short int *output = &frame_buffer[scanline * 256];
+    unsigned short int emphasis = (mask & 0xE0) << 1;
+    unsigned char grayscale = (mask & 0x01) ? 0x30 : 0x3F;
+
+    if (!rendering_enabled()) {
+        for (int px = 0; px < 256; px++) output[px] = (palette[0] & grayscale) | emphasis;
+        return;
+    }
+
+    // 0 marks a transparent pixel
+    unsigned char background[256];
+    render_background(background);
+    if (!(mask & 0x08)) std::memset(background, 0, 256);
+    else if (!(mask & 0x02)) std::memset(background, 0, 8);
+    if (!sprites_evaluated) evaluate_sprites();
+    int first_sprite_pixel = (mask & 0x10) ? ((mask & 0x04) ? 0 : 8) : 256;
+
+    for (int px = 0; px < 256; px++) {
+        unsigned char bg = background[px];
+        unsigned char sp = px >= first_sprite_pixel ? sprite_line[px] : 0;
+        unsigned char color = bg;
+        if (sp != 0 and (bg == 0 or !(sp & 0x20))) color = 0x10 | (sp & 0x0F);
+        output[px] = (palette[color] & grayscale) | emphasis;
+    }
+}
+
+// Dot-accurate path: v advances to the next tile after every 8th pixel like the real fetch
+// pipeline, and fine X, PPUMASK and the palette are read per pixel.
+void PPU::render_segment(int end) {
+    unsigned short int *output = &frame_buffer[scanline * 256];
+    unsigned short int emphasis = (mask & 0xE0) << 1;
+    unsigned char grayscale = (mask & 0x01) ? 0x30 : 0x3F;
+
+    if (!rendering_enabled()) {
+        for (int px = rendered_x; px < end; px++) output[px] = (palette[0] & grayscale) | emphasis;
+        return;
+    }
+
+    if (!sprites_evaluated) evaluate_sprites();
+    unsigned short int pattern_table = (ctrl & 0x10) ? 256 : 0;
+    int first_background_pixel = (mask & 0x08) ? ((mask & 0x02) ? 0 : 8) : 256;
+    int first_sprite_pixel = (mask & 0x10) ? ((mask & 0x04) ? 0 : 8) : 256;
+
+    for (int px = rendered_x; px < end; px++) {
+        unsigned char column = (px & 7) + x;
+        unsigned short int address = v;
+        if (column >= 8) {
+            // Fine X reaches into the tile after the one v points at
+            if ((address & 0x001F) == 31) address = (address & ~0x001F) ^ 0x0400;
+            else address++;
+        }
+        unsigned char bg = 0;
+        if (px >= first_background_pixel) bg = background_pixel(address, column % 8, pattern_table);
+        unsigned char sp = px >= first_sprite_pixel ? sprite_line[px] : 0;
+        unsigned char color = bg;
+        if (sp != 0 and (bg == 0 or !(sp & 0x20))) color = 0x10 | (sp & 0x0F);
+        output[px] = (palette[color] & grayscale) | emphasis;
+        if ((px & 7) == 7) increment_x(v);
+    }
+}
+
+// (palette << 2) | pixel of one background pixel, 0 when transparent.
+unsigned char PPU::background_pixel(unsigned short int address, unsigned char column, unsigned short int pattern_table) {
+    unsigned char tile = bus_read(0x2000 | (address & 0x0FFF));
+    unsigned char value = tile_cache.get_row(pattern_table + tile, address >> 12)[column];
+    if (value == 0) return 0;
+    unsigned char attribute = bus_read(0x23C0 | (address & 0x0C00) | ((address >> 4) & 0x38) | ((address >> 2) & 0x07));
+    return (((attribute >> (((address >> 4) & 0x04) | (address & 0x02))) & 0x03) << 2) | value;
+}
+
+// Fills line with (palette << 2) | pixel for every background pixel, 0 when transparent.
+// v ends up advanced by the same 32 tiles as on the dot-accurate path.
+void PPU::render_background(unsigned char *line) {
+    unsigned short int pattern_table = (ctrl & 0x10) ? 256 : 0;
+    unsigned char fine_y = v >> 12;
+    int px = 0;
+    int first = x;
+    int tiles = x ? 33 : 32;
+    for (int n = 0; n < tiles; n++) {
+        unsigned char tile = bus_read(0x2000 | (v & 0x0FFF));
+        unsigned char attribute = bus_read(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+        unsigned char palette_select = ((attribute >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03) << 2;
+        const unsigned char *row = tile_cache.get_row(pattern_table + tile, fine_y);
+        for (int column = first; column < 8 and px < 256; column++, px++) {
+            line[px] = row[column] ? palette_select | row[column] : 0;
+        }
+        first = 0;
+        if (n < 32) increment_x(v);
+    }
+}
+
+// Evaluates the sprites of the current line and fills sprite_line with 0x10 | (palette << 2) | pixel
+// for the frontmost opaque sprite pixel, plus 0x20 for background priority and 0x40 for sprite 0.
+void PPU::evaluate_sprites() {
+    unsigned char *line = sprite_line;
+    int height = (ctrl & 0x20) ? 16 : 8;
+    int count = 0;
+    sprites_evaluated = true;
+    std::memset(line, 0, 256);
+    unsigned long long int in_range = sprites_in_range(scanline);
+    while (in_range) {
+        int n = __builtin_ctzll(in_range);
+        in_range &= in_range - 1;
+        int row = scanline - (oam[n * 4] + 1);
+        // Sprite overflow itself is set by the prediction in predict_flags()
+        if (count == 8 and sprite_limit) break;
+        count++;
+
+        unsigned char tile_number = oam[n * 4 + 1];
+        unsigned char attributes = oam[n * 4 + 2];
+        int sprite_x = oam[n * 4 + 3];
+        if (attributes & 0x80) row = height - 1 - row;
+        unsigned short int tile;
+        if (height == 16) tile = ((tile_number & 0x01) << 8) + (tile_number & 0xFE) + (row >= 8);
+        else tile = ((ctrl & 0x08) ? 256 : 0) + tile_number;
+        const unsigned char *pixels = tile_cache.get_row(tile, row % 8);
+
+        unsigned char flags = 0x10 | ((attributes & 0x03) << 2) | ((attributes & 0x20) ? 0x20 : 0) | (n == 0 ? 0x40 : 0);
+        for (int column = 0; column < 8 and sprite_x + column < 256; column++) {
+            unsigned char value = pixels[(attributes & 0x40) ? 7 - column : column];
+            // Lower OAM indexes are in front, whatever their priority bit says
+            if (value == 0 or line[sprite_x + column] != 0) continue;
+            line[sprite_x + column] = flags | value;
+        }
+    }
+}
+
+// Reference for the sprite 0 hit prediction: sets the flag at the first of pixels
+// [rendered_x, end) where an opaque sprite 0 pixel of sprite_line meets an opaque
+// background pixel, walking v's tiles the way render_segment() does. Runs headless too.
+void PPU::render_sprite0_hit(int end) {
+    if ((status & 0x40) or (mask & 0x18) != 0x18) return;
+    if (!sprites_evaluated) evaluate_sprites();
+    unsigned short int pattern_table = (ctrl & 0x10) ? 256 : 0;
+    int first_background_pixel = (mask & 0x02) ? 0 : 8;
+    int first_sprite_pixel = (mask & 0x04) ? 0 : 8;
+    unsigned short int address = v;
+    // Never on the last pixel of the line
+    for (int px = rendered_x; px < end and px < 255; px++) {
+        if ((sprite_line[px] & 0x40) and px >= first_background_pixel and px >= first_sprite_pixel) {
+            unsigned char column = (px & 7) + x;
+            unsigned short int tile_address = address;
+            if (column >= 8) increment_x(tile_address);
+            if (background_pixel(tile_address, column % 8, pattern_table) != 0) {
+                status = status | 0x40;
+                return;
+            }
+        }
+        if ((px & 7) == 7) increment_x(address);
+    }
+}
+
+// Reference for the overflow prediction: at the end of a visible line, counts the OAM
+// entries covering the next one.
+void PPU::render_overflow() {
+    if ((status & 0x20) or scanline >= 239) return;
+    int height = (ctrl & 0x20) ? 16 : 8;
+    int count = 0;
+    for (int n = 0; n < 64; n++) {
+        int row = scanline + 1 - (oam[n * 4] + 1);
+        if (row >= 0 and row < height) count++;
+    }
+    if (count > 8) status = status | 0x20;
+}
@@ -0,0 +1,152 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <vector>
+#include "../mappers/mappers.h"
+#include "tile_cache.h"
+
+class StateWriter;
+class StateReader;
+
+// How many visible lines of a frame were drawn in one go and how many had to switch to the
+// dot-accurate path because of a mid-line register write.
+struct LineStats {
+    unsigned int fast_lines;
+    unsigned int slow_lines;
+};
+
+enum PPUEventKind {
+    PPU_EVENT_WRITE,
+    PPU_EVENT_READ,
+    PPU_EVENT_OAM_DMA,
+    PPU_EVENT_MAPPER_WRITE
+};
+
+// A CPU access that changed PPU state, at the CPU cycle the PPU was caught up to.
+struct PPUEvent {
+    unsigned long long int cpu_cycle;
+    PPUEventKind kind;
+    unsigned short int address;
+    unsigned char value;
+};
+
+// Everything needed to replay a stretch of emulation on another PPU: the events in order
+// and the 256 byte page of every OAM DMA.
+struct PPULog {
+    std::vector<PPUEvent> events;
+    std::vector<unsigned char> oam_pages;
+};
+
+class PPU {
+    public:
+        PPU(Mapper *mapper);
+        void reset();
+        void tick();
+        void catch_up(unsigned long long int cpu_cycle);
+        unsigned long long int next_event_cycle();
+        unsigned long long int get_catch_ups();
+        unsigned char read_register(unsigned short int address);
+        unsigned char read_status(unsigned long long int cpu_cycle);
+        void write_register(unsigned short int address, unsigned char value);
+        void oam_dma(const unsigned char *page);
+        // Must follow the catch-up for a CPU write to the cartridge that may change what the PPU sees.
+        void record_mapper_write(unsigned short int address, unsigned char value);
+        // Accesses are appended to log until it is set back to null.
+        void set_log(PPULog *log);
+        // Takes over the state of other, keeping this PPU's own mapper.
+        void copy_state(const PPU &other);
+        // Settings, statistics and the frame buffer are not part of a save state. Load after
+        // the mapper, whose CHR the tile cache and the flag prediction depend on.
+        void save_state(StateWriter &state);
+        void load_state(StateReader &state);
+        bool poll_nmi();
+        int get_scanline();
+        int get_dot();
+        unsigned long long int get_clock();
+        unsigned long long int get_frame();
+        // 256x240 pixels, each a 6-bit palette index with the emphasis bits of PPUMASK in bits 6-8.
+        const unsigned short int *get_frame_buffer();
+        // Statistics of the last frame that reached vertical blank.
+        LineStats get_line_stats();
+        TileCache &get_tile_cache();
+        void set_sprite_limit(bool enabled);
+        bool get_sprite_limit();
+        void set_headless(bool enabled);
+        bool get_headless();
+        void set_flag_prediction(bool enabled);
+        bool get_flag_prediction();
+        unsigned long long int get_flag_mismatches();
+
+    private:
+        Mapper *mapper;
+        bool mapper_observes_ppu;
+        unsigned char *const *ppu_pages;
+        TileCache tile_cache;
+        unsigned short int frame_buffer[256 * 240];
+        unsigned char oam[256];
+        unsigned char palette[32];
+        unsigned char ctrl;
+        unsigned char mask;
+        unsigned char status;
+        unsigned char oam_addr;
+        unsigned char read_buffer;
+        unsigned char open_bus;
+        unsigned short int v;
+        unsigned short int t;
+        unsigned char x;
+        bool w;
+        bool nmi_line;
+        bool odd_frame;
+        int scanline;
+        int dot;
+        unsigned long long int clock;
+        unsigned long long int frame;
+        unsigned long long int catch_ups;
+        unsigned long long int vblank_read_clock;
+        unsigned long long int sprite0_clock;
+        unsigned long long int overflow_clock;
+        unsigned long long int prediction_valid_until;
+        unsigned long long int prediction_generation;
+        bool prediction_dirty;
+        int rendered_x;
+        unsigned char sprite_line[256];
+        unsigned long long int line_sprites[240];
+        int line_sprites_height;
+        bool line_sprites_dirty;
+        bool sprite_limit;
+        bool headless;
+        bool flag_prediction;
+        unsigned long long int flag_mismatches;
+        PPULog *log;
+        void log_event(unsigned long long int cpu_cycle, PPUEventKind kind, unsigned short int address, unsigned char value);
+        bool sprites_evaluated;
+        unsigned int fast_lines;
+        unsigned int slow_lines;
+        LineStats line_stats;
+        int next_event_dot();
+        unsigned long long int next_clock_at(int line, int line_dot);
+        void predict_flags(unsigned long long int target);
+        unsigned long long int sprite0_hit_dot(int line, unsigned short int address, int first_pixel, int line_dot);
+        int sprites_on_line(int line);
+        unsigned long long int sprites_in_range(int line);
+        bool rendering_enabled();
+        unsigned char bus_read(unsigned short int address);
+        void bus_write(unsigned short int address, unsigned char value);
+        unsigned char palette_index(unsigned short int address);
+        static void increment_x(unsigned short int &address);
+        static void advance_x(unsigned short int &address, int count);
+        static void increment_y(unsigned short int &address);
+        void copy_x(unsigned short int &address);
+        void copy_y(unsigned short int &address);
+        void render_pixels(int end);
+        void split_line();
+        void render_scanline();
+        void render_segment(int end);
+        unsigned char background_pixel(unsigned short int address, unsigned char column, unsigned short int pattern_table);
+        void render_background(unsigned char *line);
+        void evaluate_sprites();
+        void render_sprite0_hit(int end);
+        void render_overflow();
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "tile_cache.h"
+#include "../mappers/mappers.h"
+
+TileCache::TileCache(Mapper *mapper) {
+    TileCache::mapper = mapper;
+    generation = 0;
+    invalidate_all();
+    reset_counters();
+}
+
+// Returns the 8 pixel values (0-3) of the given row of a tile, tile being the
+// pattern table address divided by 16.
+const unsigned char *TileCache::get_row(unsigned short int tile, unsigned char row) {
+    if (valid[tile]) hits++;
+    else {
+        misses++;
+        decode(tile);
+    }
+    return &pixels[tile][row * 8];
+}
+
+void TileCache::invalidate_tile(unsigned short int tile) {
+    tile = tile % 512;
+    if (!valid[tile]) return;
+    valid[tile] = false;
+    generation++;
+    tile_invalidations++;
+}
+
+void TileCache::invalidate_range(unsigned short int address, unsigned short int size) {
+    unsigned short int first = (address % 0x2000) >> 4;
+    unsigned short int last = first + (size >> 4);
+    if (last > 512) last = 512;
+    for (unsigned short int tile = first; tile < last; tile++) valid[tile] = false;
+    bank_invalidations++;
+    generation++;
+}
+
+void TileCache::invalidate_all() {
+    for (int tile = 0; tile < 512; tile++) valid[tile] = false;
+    generation++;
+}
+
+unsigned long long int TileCache::get_hits() {
+    return hits;
+}
+
+unsigned long long int TileCache::get_misses() {
+    return misses;
+}
+
+unsigned long long int TileCache::get_tile_invalidations() {
+    return tile_invalidations;
+}
+
+unsigned long long int TileCache::get_bank_invalidations() {
+    return bank_invalidations;
+}
+
+double TileCache::get_hit_rate() {
+    if (hits + misses == 0) return 0.0;
+    return (double) hits / (hits + misses);
+}
+
+unsigned long long int TileCache::get_generation() {
+    return generation;
+}
+
+void TileCache::reset_counters() {
+    hits = 0;
+    misses = 0;
+    tile_invalidations = 0;
+    bank_invalidations = 0;
+}
+
+void TileCache::decode(unsigned short int tile) {
+    unsigned short int address = tile * 16;
+    for (int row = 0; row < 8; row++) {
+        unsigned char low = mapper->ppu_mem(address + row);
+        unsigned char high = mapper->ppu_mem(address + row + 8);
+        for (int column = 0; column < 8; column++) {
+            pixels[tile][row * 8 + column] = ((low >> (7 - column)) & 1) | (((high >> (7 - column)) & 1) << 1);
+        }
+    }
+    valid[tile] = true;
+}
@@ -0,0 +1,38 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+class Mapper;
+
+// Decoded copy of the 512 tiles currently visible in the pattern tables ($0000-$1FFF).
+// Every tile is kept as 8 rows of 8 two-bit pixel values, so the renderer can use a
+// row directly instead of merging the two bit planes on every fetch. Tiles are decoded
+// on first use and dropped when the mapper reports a CHR-RAM write or a CHR bank switch.
+class TileCache {
+    public:
+        TileCache(Mapper *mapper);
+        const unsigned char *get_row(unsigned short int tile, unsigned char row);
+        void invalidate_tile(unsigned short int tile);
+        void invalidate_range(unsigned short int address, unsigned short int size);
+        void invalidate_all();
+        unsigned long long int get_hits();
+        unsigned long long int get_misses();
+        unsigned long long int get_tile_invalidations();
+        unsigned long long int get_bank_invalidations();
+        double get_hit_rate();
+        // Changes whenever any tile is invalidated.
+        unsigned long long int get_generation();
+        void reset_counters();
+
+    private:
+        Mapper *mapper;
+        unsigned char pixels[512][64];
+        bool valid[512];
+        unsigned long long int hits;
+        unsigned long long int misses;
+        unsigned long long int tile_invalidations;
+        unsigned long long int bank_invalidations;
+        unsigned long long int generation;
+        void decode(unsigned short int tile);
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include "rewind_buffer.h"
+
+// A delta is a list of runs: u16 count of bytes left as they were, u16 count of bytes that
+// changed, then those bytes XORed with the state before. Bytes past the last run are
+// unchanged.
+static const unsigned int MAX_RUN = 0xFFFF;
+
+static double seconds_between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void put_u16(unsigned char *bytes, unsigned int value) {
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+}
+
+RewindBuffer::RewindBuffer(Emulator *emulator, unsigned int memory_cap) {
+    RewindBuffer::emulator = emulator;
+    state_size = emulator->get_state_size();
+    for (std::vector<unsigned char> &slot : slots) slot.resize(state_size);
+    latest.resize(state_size);
+    // A run header for every fifth byte at worst, since runs of fewer than 4 unchanged
+    // bytes are coded as changed ones
+    scratch.resize(state_size + 4 * (state_size / 5 + state_size / MAX_RUN + 2));
+    if (memory_cap < 2 * scratch.size()) throw std::runtime_error("\nRewind memory cap is too small for this game!");
+    arena.resize(memory_cap);
+    first_slot = 0;
+    queued = 0;
+    has_latest = false;
+    write_offset = 0;
+    compressed_bytes = 0;
+    stopping = false;
+    reset_stats();
+    worker = std::thread(&RewindBuffer::run, this);
+}
+
+RewindBuffer::~RewindBuffer() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+// Only the caller's thread pushes, so the slot stays its own until it is queued.
+void RewindBuffer::push() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> guard(lock);
+    if (queued == SLOTS) {
+        stats.stalls++;
+        wake.wait(guard, [this] { return queued < SLOTS; });
+    }
+    int slot = (first_slot + queued) % SLOTS;
+    guard.unlock();
+    emulator->save_state(slots[slot].data(), state_size);
+    guard.lock();
+    queued++;
+    stats.push_seconds += seconds_between(start, std::chrono::steady_clock::now());
+    guard.unlock();
+    wake.notify_all();
+}
+
+bool RewindBuffer::step_back() {
+    finish();
+    std::unique_lock<std::mutex> guard(lock);
+    if (deltas.empty()) return false;
+    Delta delta = deltas.back();
+    deltas.pop_back();
+    decode(&arena[delta.offset], delta.size);
+    compressed_bytes -= delta.size;
+    write_offset = delta.offset;
+    guard.unlock();
+    emulator->load_state(latest.data(), state_size);
+    return true;
+}
+
+void RewindBuffer::finish() {
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait(guard, [this] { return queued == 0; });
+}
+
+void RewindBuffer::clear() {
+    finish();
+    std::unique_lock<std::mutex> guard(lock);
+    deltas.clear();
+    write_offset = 0;
+    compressed_bytes = 0;
+    has_latest = false;
+}
+
+unsigned int RewindBuffer::get_memory_cap() {
+    return arena.size();
+}
+
+RewindStats RewindBuffer::get_stats() {
+    std::unique_lock<std::mutex> guard(lock);
+    RewindStats current = stats;
+    current.frames = deltas.size();
+    current.compressed_bytes = compressed_bytes;
+    current.raw_bytes = (unsigned long long int) deltas.size() * state_size;
+    return current;
+}
+
+void RewindBuffer::reset_stats() {
+    std::unique_lock<std::mutex> guard(lock);
+    stats.stalls = 0;
+    stats.push_seconds = 0;
+    stats.compress_seconds = 0;
+}
+
+// The worker codes the first queued state against latest outside the lock: push() only
+// writes other slots, and step_back() and clear() wait for the queue to empty first.
+void RewindBuffer::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [this] { return queued > 0 or stopping; });
+        if (stopping) return;
+        const std::vector<unsigned char> &state = slots[first_slot];
+        guard.unlock();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        unsigned int size = has_latest ? encode(state.data()) : 0;
+        std::memcpy(latest.data(), state.data(), state_size);
+        double seconds = seconds_between(start, std::chrono::steady_clock::now());
+        guard.lock();
+        if (has_latest) {
+            unsigned int offset = allocate(size);
+            std::memcpy(&arena[offset], scratch.data(), size);
+            deltas.push_back({offset, size});
+            compressed_bytes += size;
+        }
+        has_latest = true;
+        first_slot = (first_slot + 1) % SLOTS;
+        queued--;
+        stats.compress_seconds += seconds;
+        wake.notify_all();
+    }
+}
+
+// Finds room for size bytes after the newest delta, forgetting the oldest ones in the way.
+// A delta that does not fit before the end of the arena goes to its start, and the
+// deltas left after the end are forgotten too, as they are the oldest.
+unsigned int RewindBuffer::allocate(unsigned int size) {
+    if (write_offset + size > arena.size()) {
+        while (!deltas.empty() and deltas.front().offset >= write_offset) drop_oldest();
+        write_offset = 0;
+    }
+    while (!deltas.empty() and deltas.front().offset >= write_offset and deltas.front().offset < write_offset + size) {
+        drop_oldest();
+    }
+    unsigned int offset = write_offset;
+    write_offset += size;
+    return offset;
+}
+
+void RewindBuffer::drop_oldest() {
+    compressed_bytes -= deltas.front().size;
+    deltas.pop_front();
+}
+
+// Codes state against latest into scratch and returns the size. Unchanged stretches,
+// most of a frame's state, are skipped 8 bytes at a time.
+unsigned int RewindBuffer::encode(const unsigned char *state) {
+    const unsigned char *before = latest.data();
+    unsigned char *out = scratch.data();
+    unsigned int i = 0;
+    while (i < state_size) {
+        unsigned int start = i;
+        while (i + 8 <= state_size and i - start + 8 <= MAX_RUN and std::memcmp(state + i, before + i, 8) == 0) i += 8;
+        while (i < state_size and i - start < MAX_RUN and state[i] == before[i]) i++;
+        if (i == state_size) break;
+        unsigned int skip = i - start;
+        // Changed bytes run on until 4 unchanged ones in a row
+        start = i;
+        unsigned int end = i;
+        while (i < state_size and i - start < MAX_RUN) {
+            if (state[i] != before[i]) end = i + 1;
+            else if (i - end >= 3) break;
+            i++;
+        }
+        i = end;
+        put_u16(out, skip);
+        put_u16(out + 2, end - start);
+        out += 4;
+        for (unsigned int n = start; n < end; n++) *out++ = state[n] ^ before[n];
+    }
+    return out - scratch.data();
+}
+
+// XORs a delta over latest, which then holds the state before.
+void RewindBuffer::decode(const unsigned char *delta, unsigned int size) {
+    unsigned char *state = latest.data();
+    unsigned int position = 0;
+    unsigned int i = 0;
+    while (i < size) {
+        unsigned int skip = delta[i] | (delta[i + 1] << 8);
+        unsigned int count = delta[i + 2] | (delta[i + 3] << 8);
+        i += 4;
+        position += skip;
+        for (unsigned int n = 0; n < count; n++) state[position + n] ^= delta[i + n];
+        position += count;
+        i += count;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../emulator/emulator.h"
+
+// How much history a rewind buffer holds and what it took to keep it.
+struct RewindStats {
+    // Frames that can be stepped back
+    unsigned int frames;
+    // Bytes of deltas held, and what the same frames take as full states
+    unsigned long long int compressed_bytes;
+    unsigned long long int raw_bytes;
+    // Times push() had to wait for the worker to free a slot
+    unsigned long long int stalls;
+    // Time push() took on the caller's thread, and time the worker spent compressing
+    double push_seconds;
+    double compress_seconds;
+};
+
+// Keeps the last frames of an emulator so it can be stepped back one frame at a time.
+// push() saves a state into a free slot and returns; a worker thread turns it into the
+// XOR of it and the state before, run-length coded, and stores that in an arena of at
+// most memory_cap bytes, forgetting the oldest frames when it is full. Since the newest
+// full state is kept, stepping back is decoding one delta over it and loading the result,
+// a few microseconds, so rewinding can run at any speed the caller likes.
+class RewindBuffer {
+    public:
+        // emulator stays the caller's and must not change game while the buffer is used.
+        RewindBuffer(Emulator *emulator, unsigned int memory_cap = 16 << 20);
+        ~RewindBuffer();
+        // Saves the emulator's current state, normally once per frame.
+        void push();
+        // Loads the state pushed before the newest one and makes that the newest; false
+        // when nothing is left. The frame buffer is not part of a state: the next frame
+        // run shows the rewound picture.
+        bool step_back();
+        // Waits for the worker to store every pushed state.
+        void finish();
+        void clear();
+        unsigned int get_memory_cap();
+        RewindStats get_stats();
+        void reset_stats();
+
+    private:
+        static const int SLOTS = 4;
+        struct Delta {
+            unsigned int offset;
+            unsigned int size;
+        };
+        Emulator *emulator;
+        unsigned int state_size;
+        // States pushed but not stored yet, in order from first
+        std::vector<unsigned char> slots[SLOTS];
+        int first_slot;
+        int queued;
+        // The newest state stored, and space for the delta being coded
+        std::vector<unsigned char> latest;
+        bool has_latest;
+        std::vector<unsigned char> scratch;
+        // Deltas from the oldest on, laid out one after another and wrapping around
+        std::vector<unsigned char> arena;
+        std::deque<Delta> deltas;
+        unsigned int write_offset;
+        unsigned long long int compressed_bytes;
+        RewindStats stats;
+        bool stopping;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::thread worker;
+        void run();
+        void store(const std::vector<unsigned char> &state);
+        unsigned int allocate(unsigned int size);
+        void drop_oldest();
+        unsigned int encode(const unsigned char *state);
+        void decode(const unsigned char *delta, unsigned int size);
+};
+
+#endif
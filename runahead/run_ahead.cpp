@@ -0,0 +1,67 @@
+#include <chrono>
+#include "run_ahead.h"
+
+static double seconds_between(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+RunAhead::RunAhead(Emulator *emulator, int frames) {
+    RunAhead::emulator = emulator;
+    snapshot.resize(emulator->get_state_size());
+    set_frames(frames);
+    reset_stats();
+}
+
+void RunAhead::set_frames(int frames) {
+    RunAhead::frames = frames < 0 ? 0 : frames;
+}
+
+int RunAhead::get_frames() {
+    return frames;
+}
+
+void RunAhead::run_frame() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    emulator->run_frame(frames == 0);
+    std::chrono::steady_clock::time_point real_end = std::chrono::steady_clock::now();
+    stats.real_seconds += seconds_between(start, real_end);
+    if (frames > 0) {
+        emulator->save_state(snapshot.data(), snapshot.size());
+        std::chrono::steady_clock::time_point saved = std::chrono::steady_clock::now();
+        APU &apu = emulator->get_apu();
+        bool sound = apu.get_sound();
+        apu.set_sound(false);
+        // Queued input waits for the real frame, as the state loaded back would undo it
+        ControllerPorts &controllers = emulator->get_controllers();
+        bool held = controllers.get_held();
+        controllers.set_held(true);
+        for (int i = 0; i < frames; i++) emulator->run_frame(i == frames - 1);
+        controllers.set_held(held);
+        std::chrono::steady_clock::time_point ahead_end = std::chrono::steady_clock::now();
+        // The frame buffer is not part of the state, so it keeps the frame ahead
+        emulator->load_state(snapshot.data(), snapshot.size());
+        apu.set_sound(sound);
+        std::chrono::steady_clock::time_point loaded = std::chrono::steady_clock::now();
+        stats.ahead_seconds += seconds_between(saved, ahead_end);
+        stats.state_seconds += seconds_between(real_end, saved) + seconds_between(ahead_end, loaded);
+    }
+    double seconds = seconds_between(start, std::chrono::steady_clock::now());
+    if (seconds > stats.worst_frame_seconds) stats.worst_frame_seconds = seconds;
+    stats.frames++;
+}
+
+const unsigned short int *RunAhead::get_frame_buffer() {
+    return emulator->get_frame_buffer();
+}
+
+RunAheadStats RunAhead::get_stats() {
+    return stats;
+}
+
+void RunAhead::reset_stats() {
+    stats.frames = 0;
+    stats.real_seconds = 0;
+    stats.ahead_seconds = 0;
+    stats.state_seconds = 0;
+    stats.worst_frame_seconds = 0;
+}
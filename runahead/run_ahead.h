@@ -0,0 +1,43 @@
+#ifndef RUN_AHEAD_H
+#define RUN_AHEAD_H
+
+#include <vector>
+#include "../emulator/emulator.h"
+
+// What run-ahead cost since its stats were last reset.
+struct RunAheadStats {
+    unsigned long long int frames;
+    // The frame that counts, the frames run ahead of it, and saving and loading the state
+    double real_seconds;
+    double ahead_seconds;
+    double state_seconds;
+    // The slowest frame, all of it
+    double worst_frame_seconds;
+};
+
+// Hides the frames of lag a game puts between reading the controller and showing the
+// result. Each frame runs headless as usual, then the state is saved, frames more are run
+// headless, without sound and with the buttons as they are, the last of them rendered, and
+// the state is loaded back. The picture shown is from frames ahead while the emulation,
+// sound included, stays on the real frame. The snapshot is allocated once, so a frame
+// allocates nothing.
+class RunAhead {
+    public:
+        // emulator stays the caller's.
+        RunAhead(Emulator *emulator, int frames = 1);
+        // 0 runs plain frames.
+        void set_frames(int frames);
+        int get_frames();
+        void run_frame();
+        const unsigned short int *get_frame_buffer();
+        RunAheadStats get_stats();
+        void reset_stats();
+
+    private:
+        Emulator *emulator;
+        int frames;
+        std::vector<unsigned char> snapshot;
+        RunAheadStats stats;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include "state.h"
+
+static const char STATE_MAGIC[4] = {'B', 'N', 'S', 'T'};
+
+StateWriter::StateWriter(unsigned char *buffer, unsigned int capacity) {
+    StateWriter::buffer = buffer;
+    StateWriter::capacity = capacity;
+    size = 0;
+    section_start = 0;
+}
+
+// The total size is patched in by every end_section().
+void StateWriter::write_header(unsigned long long int rom_hash) {
+    write_bytes(STATE_MAGIC, 4);
+    write_u16(STATE_VERSION);
+    write_u16(0);
+    write_u32(0);
+    write_u64(rom_hash);
+}
+
+void StateWriter::begin_section(const char *tag) {
+    write_bytes(tag, 4);
+    write_u32(0);
+    section_start = size;
+}
+
+void StateWriter::end_section() {
+    patch_u32(section_start - 4, size - section_start);
+    patch_u32(8, size);
+}
+
+void StateWriter::write_bytes(const void *data, unsigned int count) {
+    if (buffer != nullptr) {
+        if (size + count > capacity) throw std::runtime_error("\nSave state buffer is too small!");
+        std::memcpy(buffer + size, data, count);
+    }
+    size += count;
+}
+
+void StateWriter::write_u8(unsigned char value) {
+    write_bytes(&value, 1);
+}
+
+void StateWriter::write_bool(bool value) {
+    write_u8(value ? 1 : 0);
+}
+
+void StateWriter::write_u16(unsigned short int value) {
+    unsigned char bytes[2] = {(unsigned char) value, (unsigned char) (value >> 8)};
+    write_bytes(bytes, 2);
+}
+
+void StateWriter::write_u32(unsigned int value) {
+    unsigned char bytes[4];
+    for (int n = 0; n < 4; n++) bytes[n] = value >> (n * 8);
+    write_bytes(bytes, 4);
+}
+
+void StateWriter::write_u64(unsigned long long int value) {
+    unsigned char bytes[8];
+    for (int n = 0; n < 8; n++) bytes[n] = value >> (n * 8);
+    write_bytes(bytes, 8);
+}
+
+unsigned int StateWriter::get_size() {
+    return size;
+}
+
+void StateWriter::patch_u32(unsigned int position, unsigned int value) {
+    if (buffer == nullptr) return;
+    for (int n = 0; n < 4; n++) buffer[position + n] = value >> (n * 8);
+}
+
+StateReader::StateReader(const unsigned char *buffer, unsigned int size) {
+    StateReader::buffer = buffer;
+    StateReader::size = size;
+    position = 0;
+    section_end = 0;
+}
+
+unsigned long long int StateReader::read_header() {
+    if (size < STATE_HEADER_SIZE or std::memcmp(buffer, STATE_MAGIC, 4) != 0) {
+        throw std::runtime_error("\nNot a save state!");
+    }
+    position = 4;
+    if (read_u16() != STATE_VERSION) throw std::runtime_error("\nSave state is from another version!");
+    read_u16();
+    if (read_u32() != size) throw std::runtime_error("\nSave state is truncated!");
+    return read_u64();
+}
+
+void StateReader::begin_section(const char *tag) {
+    const unsigned char *found = take(4);
+    if (std::memcmp(found, tag, 4) != 0) {
+        throw std::runtime_error(std::string("\nSave state has no ") + std::string(tag, 4) + " section where expected!");
+    }
+    unsigned int length = read_u32();
+    if (length > size - position) throw std::runtime_error("\nSave state is truncated!");
+    section_end = position + length;
+}
+
+void StateReader::end_section() {
+    if (position != section_end) throw std::runtime_error("\nSave state section has the wrong size!");
+}
+
+void StateReader::skip_section(const char *tag) {
+    begin_section(tag);
+    position = section_end;
+}
+
+void StateReader::check_section(const char *tag, unsigned int length) {
+    begin_section(tag);
+    if (section_end - position != length) throw std::runtime_error("\nSave state section has the wrong size!");
+    position = section_end;
+}
+
+void StateReader::skip_bytes(unsigned int count) {
+    take(count);
+}
+
+void StateReader::read_bytes(void *data, unsigned int count) {
+    std::memcpy(data, take(count), count);
+}
+
+unsigned char StateReader::read_u8() {
+    return *take(1);
+}
+
+bool StateReader::read_bool() {
+    return read_u8() != 0;
+}
+
+unsigned short int StateReader::read_u16() {
+    const unsigned char *bytes = take(2);
+    return bytes[0] | (bytes[1] << 8);
+}
+
+unsigned int StateReader::read_u32() {
+    const unsigned char *bytes = take(4);
+    unsigned int value = 0;
+    for (int n = 3; n >= 0; n--) value = (value << 8) | bytes[n];
+    return value;
+}
+
+unsigned long long int StateReader::read_u64() {
+    const unsigned char *bytes = take(8);
+    unsigned long long int value = 0;
+    for (int n = 7; n >= 0; n--) value = (value << 8) | bytes[n];
+    return value;
+}
+
+const unsigned char *StateReader::take(unsigned int count) {
+    if (count > size - position) throw std::runtime_error("\nSave state is truncated!");
+    const unsigned char *bytes = buffer + position;
+    position += count;
+    return bytes;
+}
+
+void write_state_file(const char *path, const unsigned char *state, unsigned int size) {
+    std::ofstream outfile;
+    outfile.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!outfile) throw std::runtime_error(std::string("\n") + path + " cannot be opened!");
+    outfile.write((const char *) state, size);
+    if (!outfile) throw std::runtime_error(std::string("\n") + path + " cannot be written!");
+}
+
+std::vector<unsigned char> read_state_file(const char *path) {
+    std::ifstream infile;
+    infile.open(path, std::ios::binary | std::ios::in);
+    if (!infile) throw std::runtime_error(std::string("\n") + path + " cannot be opened!");
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+}
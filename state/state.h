@@ -0,0 +1,73 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <vector>
+
+// Save states are a header followed by tagged sections, one per component:
+//   "BNST", u16 format version, u16 flags (0), u32 size of the whole state, u64 ROM hash
+//   per section: 4 byte tag, u32 size of the body, body
+// Every value is little-endian whatever the host, so states can be kept on disk and moved
+// between machines. A state only loads into an emulator of the same format version, with
+// the same game, as told by Mapper::get_rom_hash().
+static const unsigned short int STATE_VERSION = 3;
+static const unsigned int STATE_HEADER_SIZE = 20;
+
+// Writes a state into a buffer the caller owns, without allocating. With a null buffer it
+// only counts the bytes, which is how the size of a state is found out.
+class StateWriter {
+    public:
+        StateWriter(unsigned char *buffer, unsigned int capacity);
+        void write_header(unsigned long long int rom_hash);
+        void begin_section(const char *tag);
+        void end_section();
+        void write_bytes(const void *data, unsigned int size);
+        void write_u8(unsigned char value);
+        void write_bool(bool value);
+        void write_u16(unsigned short int value);
+        void write_u32(unsigned int value);
+        void write_u64(unsigned long long int value);
+        // Bytes written so far; once the header is written, it also holds the final size.
+        unsigned int get_size();
+
+    private:
+        unsigned char *buffer;
+        unsigned int capacity;
+        unsigned int size;
+        unsigned int section_start;
+        void patch_u32(unsigned int position, unsigned int value);
+};
+
+// Reads a state back, throwing if it is not one, was written by another format version
+// or does not match what the components expect.
+class StateReader {
+    public:
+        StateReader(const unsigned char *buffer, unsigned int size);
+        // Returns the ROM hash, for the caller to check.
+        unsigned long long int read_header();
+        void begin_section(const char *tag);
+        void end_section();
+        // Passes over a section that belongs to another component.
+        void skip_section(const char *tag);
+        // Passes over a section, throwing unless its body is length bytes long.
+        void check_section(const char *tag, unsigned int length);
+        void skip_bytes(unsigned int count);
+        void read_bytes(void *data, unsigned int size);
+        unsigned char read_u8();
+        bool read_bool();
+        unsigned short int read_u16();
+        unsigned int read_u32();
+        unsigned long long int read_u64();
+
+    private:
+        const unsigned char *buffer;
+        unsigned int size;
+        unsigned int position;
+        unsigned int section_end;
+        const unsigned char *take(unsigned int count);
+};
+
+// Keeps a state on disk, throwing if the file cannot be written or read.
+void write_state_file(const char *path, const unsigned char *state, unsigned int size);
+std::vector<unsigned char> read_state_file(const char *path);
+
+#endif
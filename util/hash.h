@@ -0,0 +1,13 @@
+#ifndef HASH_H
+#define HASH_H
+
+// FNV-1a, used to tell games and emulation results apart without keeping them around.
+inline unsigned long long int hash_bytes(const void *data, unsigned long long int size, unsigned long long int hash = 0xCBF29CE484222325ULL) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (unsigned long long int i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+#endif
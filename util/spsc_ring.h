@@ -0,0 +1,106 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+// Lock-free ring buffer for one producer thread and one consumer thread. Neither side ever
+// waits on the other: push() takes what fits and pop() takes what is there. The positions
+// count up forever and wrap on their own, so the ring can be completely full. T is copied
+// with memcpy and must be trivially copyable.
+template <typename T>
+class SPSCRing {
+    public:
+        // The capacity is rounded up to a power of two.
+        SPSCRing(unsigned int capacity);
+        // Producer side: copies up to count items in and returns how many fit.
+        unsigned int push(const T *items, unsigned int count);
+        // Consumer side: copies up to count items out and returns how many there were.
+        unsigned int pop(T *items, unsigned int count);
+        // Items in the ring; from either side it may be out of date by the time it returns.
+        unsigned int size();
+        unsigned int get_capacity();
+
+    private:
+        std::vector<T> buffer;
+        unsigned int mask;
+        // Each position is written by one side only, and kept on its own cache line along
+        // with that side's last view of the other position
+        alignas(64) std::atomic<unsigned int> head;
+        unsigned int cached_tail;
+        alignas(64) std::atomic<unsigned int> tail;
+        unsigned int cached_head;
+        void copy_in(unsigned int position, const T *items, unsigned int count);
+        void copy_out(unsigned int position, T *items, unsigned int count);
+};
+
+template <typename T>
+SPSCRing<T>::SPSCRing(unsigned int capacity) {
+    unsigned int size = 1;
+    while (size < capacity) size = size << 1;
+    buffer.resize(size);
+    mask = size - 1;
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    cached_tail = 0;
+    cached_head = 0;
+}
+
+template <typename T>
+unsigned int SPSCRing<T>::push(const T *items, unsigned int count) {
+    unsigned int position = head.load(std::memory_order_relaxed);
+    unsigned int room = buffer.size() - (position - cached_tail);
+    if (room < count) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        room = buffer.size() - (position - cached_tail);
+    }
+    if (count > room) count = room;
+    copy_in(position, items, count);
+    head.store(position + count, std::memory_order_release);
+    return count;
+}
+
+template <typename T>
+unsigned int SPSCRing<T>::pop(T *items, unsigned int count) {
+    unsigned int position = tail.load(std::memory_order_relaxed);
+    unsigned int available = cached_head - position;
+    if (available < count) {
+        cached_head = head.load(std::memory_order_acquire);
+        available = cached_head - position;
+    }
+    if (count > available) count = available;
+    copy_out(position, items, count);
+    tail.store(position + count, std::memory_order_release);
+    return count;
+}
+
+template <typename T>
+unsigned int SPSCRing<T>::size() {
+    unsigned int position = tail.load(std::memory_order_acquire);
+    return head.load(std::memory_order_acquire) - position;
+}
+
+template <typename T>
+unsigned int SPSCRing<T>::get_capacity() {
+    return buffer.size();
+}
+
+// At most two copies: up to the end of the buffer, then from its start.
+template <typename T>
+void SPSCRing<T>::copy_in(unsigned int position, const T *items, unsigned int count) {
+    unsigned int start = position & mask;
+    unsigned int first = buffer.size() - start < count ? buffer.size() - start : count;
+    std::memcpy(&buffer[start], items, first * sizeof(T));
+    std::memcpy(&buffer[0], items + first, (count - first) * sizeof(T));
+}
+
+template <typename T>
+void SPSCRing<T>::copy_out(unsigned int position, T *items, unsigned int count) {
+    unsigned int start = position & mask;
+    unsigned int first = buffer.size() - start < count ? buffer.size() - start : count;
+    std::memcpy(items, &buffer[start], first * sizeof(T));
+    std::memcpy(items + first, &buffer[0], (count - first) * sizeof(T));
+}
+
+#endif
@@ -0,0 +1,157 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "video.h"
+
+// RGB of the 64 colours of the 2C02
+static const unsigned char nes_palette[64][3] = {
+    { 84,  84,  84}, {  0,  30, 116}, {  8,  16, 144}, { 48,   0, 136}, { 68,   0, 100}, { 92,   0,  48}, { 84,   4,   0}, { 60,  24,   0},
+    { 32,  42,   0}, {  8,  58,   0}, {  0,  64,   0}, {  0,  60,   0}, {  0,  50,  60}, {  0,   0,   0}, {  0,   0,   0}, {  0,   0,   0},
+    {152, 150, 152}, {  8,  76, 196}, { 48,  50, 236}, { 92,  30, 228}, {136,  20, 176}, {160,  20, 100}, {152,  34,  32}, {120,  60,   0},
+    { 84,  90,   0}, { 40, 114,   0}, {  8, 124,   0}, {  0, 118,  40}, {  0, 102, 120}, {  0,   0,   0}, {  0,   0,   0}, {  0,   0,   0},
+    {236, 238, 236}, { 76, 154, 236}, {120, 124, 236}, {176,  98, 236}, {228,  84, 236}, {236,  88, 180}, {236, 106, 100}, {212, 136,  32},
+    {160, 170,   0}, {116, 196,   0}, { 76, 208,  32}, { 56, 204, 108}, { 56, 180, 204}, { 60,  60,  60}, {  0,   0,   0}, {  0,   0,   0},
+    {236, 238, 236}, {168, 204, 236}, {188, 188, 236}, {212, 178, 236}, {236, 174, 236}, {236, 174, 212}, {236, 180, 176}, {228, 196, 144},
+    {204, 210, 120}, {180, 222, 120}, {168, 226, 144}, {152, 226, 180}, {160, 214, 228}, {160, 162, 160}, {  0,   0,   0}, {  0,   0,   0}
+};
+
+VideoOutput::VideoOutput(PixelFormat format) {
+    VideoOutput::format = format;
+    emphasis = true;
+#if defined(__x86_64__) || defined(__i386__)
+    simd_supported = __builtin_cpu_supports("avx2");
+#else
+    simd_supported = false;
+#endif
+    simd = simd_supported;
+    build_table();
+}
+
+void VideoOutput::set_format(PixelFormat format) {
+    VideoOutput::format = format;
+    build_table();
+}
+
+PixelFormat VideoOutput::get_format() {
+    return format;
+}
+
+void VideoOutput::set_emphasis(bool enabled) {
+    emphasis = enabled;
+    build_table();
+}
+
+bool VideoOutput::get_emphasis() {
+    return emphasis;
+}
+
+void VideoOutput::set_simd(bool enabled) {
+    simd = enabled and simd_supported;
+}
+
+bool VideoOutput::get_simd() {
+    return simd;
+}
+
+int VideoOutput::bytes_per_pixel() {
+    if (format == PIXEL_RGB565) return 2;
+    if (format == PIXEL_GRAY8) return 1;
+    return 4;
+}
+
+void VideoOutput::build_table() {
+    for (int index = 0; index < 512; index++) {
+        unsigned int rgb[3];
+        for (int channel = 0; channel < 3; channel++) rgb[channel] = nes_palette[index & 0x3F][channel];
+        if (emphasis) {
+            // Bits 6, 7 and 8 emphasize red, green and blue by darkening the other two channels
+            for (int bit = 0; bit < 3; bit++) {
+                if (!(index & (0x40 << bit))) continue;
+                for (int channel = 0; channel < 3; channel++) {
+                    if (channel != bit) rgb[channel] = rgb[channel] * 209 / 256;
+                }
+            }
+        }
+        unsigned int r = rgb[0], g = rgb[1], b = rgb[2];
+        switch (format) {
+            case PIXEL_RGBA8888:
+                table[index] = r | (g << 8) | (b << 16) | 0xFF000000;
+                break;
+            case PIXEL_BGRA8888:
+                table[index] = b | (g << 8) | (r << 16) | 0xFF000000;
+                break;
+            case PIXEL_RGB565:
+                table[index] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+                break;
+            case PIXEL_GRAY8:
+                table[index] = (77 * r + 150 * g + 29 * b) >> 8;
+                break;
+        }
+    }
+}
+
+void VideoOutput::convert(const unsigned short int *frame, void *output, int stride) {
+    unsigned char *line = (unsigned char *) output;
+    for (int y = 0; y < 240; y++) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (simd) {
+            convert_line_avx2(&frame[y * 256], line);
+            line += stride;
+            continue;
+        }
+#endif
+        convert_line(&frame[y * 256], line);
+        line += stride;
+    }
+}
+
+// Bytes are written one by one in little endian order, whatever the host is.
+void VideoOutput::convert_line(const unsigned short int *line, unsigned char *output) {
+    int size = bytes_per_pixel();
+    for (int px = 0; px < 256; px++) {
+        unsigned int value = table[line[px] & 0x1FF];
+        if (size == 1) output[px] = value;
+        else if (size == 2) {
+            output[px * 2] = value;
+            output[px * 2 + 1] = value >> 8;
+        }
+        else {
+            output[px * 4] = value;
+            output[px * 4 + 1] = value >> 8;
+            output[px * 4 + 2] = value >> 16;
+            output[px * 4 + 3] = value >> 24;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 table lookups per gather. The narrow formats are packed down with saturating packs,
+// which interleave the two 128-bit lanes, so a permute puts the pixels back in order.
+__attribute__((target("avx2")))
+void VideoOutput::convert_line_avx2(const unsigned short int *line, unsigned char *output) {
+    const int *lookup = (const int *) table;
+    const __m256i index_mask = _mm256_set1_epi32(0x1FF);
+    for (int px = 0; px < 256; px += 32) {
+        __m256i pixels[4];
+        for (int n = 0; n < 4; n++) {
+            __m128i indexes = _mm_loadu_si128((const __m128i *) &line[px + n * 8]);
+            __m256i wide = _mm256_and_si256(_mm256_cvtepu16_epi32(indexes), index_mask);
+            pixels[n] = _mm256_i32gather_epi32(lookup, wide, 4);
+        }
+        if (format == PIXEL_RGBA8888 or format == PIXEL_BGRA8888) {
+            for (int n = 0; n < 4; n++) _mm256_storeu_si256((__m256i *) &output[(px + n * 8) * 4], pixels[n]);
+            continue;
+        }
+        __m256i low = _mm256_permute4x64_epi64(_mm256_packus_epi32(pixels[0], pixels[1]), 0xD8);
+        __m256i high = _mm256_permute4x64_epi64(_mm256_packus_epi32(pixels[2], pixels[3]), 0xD8);
+        if (format == PIXEL_RGB565) {
+            _mm256_storeu_si256((__m256i *) &output[px * 2], low);
+            _mm256_storeu_si256((__m256i *) &output[(px + 16) * 2], high);
+        }
+        else {
+            __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+            _mm256_storeu_si256((__m256i *) &output[px], bytes);
+        }
+    }
+}
+#endif
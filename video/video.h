@@ -0,0 +1,45 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+enum PixelFormat {
+    // Bytes R, G, B, A in memory
+    PIXEL_RGBA8888,
+    // Bytes B, G, R, A in memory
+    PIXEL_BGRA8888,
+    // 16-bit little endian, 5 bits of red on top
+    PIXEL_RGB565,
+    // One byte of luma per pixel
+    PIXEL_GRAY8
+};
+
+// Turns the PPU frame buffer (6-bit palette indexes with the emphasis bits in bits 6-8)
+// into pixels of the chosen format, straight into a buffer owned by the caller. Every
+// conversion goes through a 512 entry table, so emphasis costs nothing extra; the table
+// just ignores the emphasis bits when emphasis is off.
+class VideoOutput {
+    public:
+        VideoOutput(PixelFormat format = PIXEL_RGBA8888);
+        void set_format(PixelFormat format);
+        PixelFormat get_format();
+        void set_emphasis(bool enabled);
+        bool get_emphasis();
+        // The AVX2 kernels are used whenever the CPU has them; this can turn them off.
+        void set_simd(bool enabled);
+        bool get_simd();
+        int bytes_per_pixel();
+        // Writes the 256x240 frame to output, stride bytes apart from one line to the next.
+        void convert(const unsigned short int *frame, void *output, int stride);
+
+    private:
+        PixelFormat format;
+        bool emphasis;
+        bool simd;
+        bool simd_supported;
+        // Pixel values of the format in the low bits of each entry, in memory order.
+        unsigned int table[512];
+        void build_table();
+        void convert_line(const unsigned short int *line, unsigned char *output);
+        void convert_line_avx2(const unsigned short int *line, unsigned char *output);
+};
+
+#endif